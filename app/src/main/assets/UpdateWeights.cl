@@ -1,9 +1,494 @@
-kernel void fillZero(__global float* w)
+#ifndef DIRTY_TILE_SHIFT
+#define DIRTY_TILE_SHIFT 16
+#endif
+
+/* Flag the checkpoint tile holding element i as modified.
+ * One write per tile and work-group is enough. dirty is null when tracked on the host. */
+inline void markDirty(__global uchar *dirty, size_t i)
 {
-    w[get_global_id(0)] = 0;
+    if (dirty && (get_local_id(0) == 0 || (i & ((1 << DIRTY_TILE_SHIFT) - 1)) == 0))
+        dirty[i >> DIRTY_TILE_SHIFT] = 1;
 }
-kernel void UpdateWeights(__global float* w, __constant float *input, __private int t)
+
+/* Blend input into w, alpha being the share of the input in the new average:
+ * its weight over the total weight so far, 1/t for unweighted inputs. */
+kernel void UpdateWeights(__global float* w, __global const float *input, __private float alpha,
+                          __global uchar *dirty)
 {
-    int globalIndex = get_global_id(0);
-    w[globalIndex] = ( (float)(t-1)/t * w[globalIndex]) + ((float)1/t * input[globalIndex]);
-}
\ No newline at end of file
+    size_t globalIndex = get_global_id(0);
+    w[globalIndex] = ((1 - alpha) * w[globalIndex]) + (alpha * input[globalIndex]);
+    markDirty(dirty, globalIndex);
+}
+
+/* Bits of a hash of element i and a step's seed, for stochastic rounding. */
+inline uint roundingBits(size_t i, uint seed)
+{
+    uint h = ((uint) i * 0x9e3779b9u) ^ seed;
+    h ^= h >> 16;
+    h *= 0x7feb352du;
+    h ^= h >> 15;
+    h *= 0x846ca68bu;
+    return h ^ (h >> 16);
+}
+
+/* Element i of W, stored as floats or, if halfW is set, as halves. */
+inline float loadW(__global const uchar *w, size_t i, int halfW)
+{
+    return halfW ? vload_half(i, (__global const half *) w) : ((__global const float *) w)[i];
+}
+
+/* Store x as element i of W. Halves round to nearest or, if stochastic is set, up with the probability
+ * of the fraction of a half's last bit that x lies above the value below, so that rounding adds no bias
+ * to an average over many steps: random bits are added below that last bit and the sum truncated.
+ * Below the smallest normal half, 2^-14, that last bit is 2^-24 whatever the exponent of x, so the
+ * random addend is scaled to it rather than taken from the mantissa of x. */
+inline void storeW(__global uchar *w, size_t i, int halfW, float x, int stochastic, uint seed)
+{
+    if (!halfW) {
+        ((__global float *) w)[i] = x;
+    } else if (stochastic) {
+        uint bits = roundingBits(i, seed);
+        float rounded = fabs(x) < 6.103515625e-5f ? x + copysign(ldexp((float) (bits >> 8), -48), x)
+                                                  : as_float(as_uint(x) + (bits >> 19));
+        vstore_half_rtz(rounded, i, (__global half *) w);
+    } else {
+        vstore_half(x, i, (__global half *) w);
+    }
+}
+
+/* Step of UpdateWeights with W and the input stored as halves, blended in float. A share of 1 replaces W. */
+kernel void UpdateWeightsHalf(__global uchar *w, __global const half *input, float alpha,
+                              __global uchar *dirty, int stochastic, uint seed)
+{
+    size_t i = get_global_id(0);
+    float x = vload_half(i, input);
+    storeW(w, i, 1, alpha >= 1.0f ? x : ((1 - alpha) * loadW(w, i, 1)) + (alpha * x), stochastic, seed);
+    markDirty(dirty, i);
+}
+
+/* Types of a quantized input. Indices match enum QuantizedType on the host. */
+#define QUANT_UINT8 0
+#define QUANT_UINT16 1
+#define QUANT_INT16 2
+#define QUANT_FLOAT16 3
+
+/* Step of UpdateWeights with an input of integers or halves, dequantized as it is read: element i stands
+ * for scale * q + offset of channel i % channels, params holding the scale and offset of each in turn.
+ * W is stored as loadW and storeW have it. A share of 1 replaces W, which may not be initialized yet. */
+kernel void UpdateWeightsQuantized(__global uchar *w, __global const uchar *input, float alpha,
+                                   __global uchar *dirty, int type, __global const float *params,
+                                   uint channels, int halfW, int stochastic, uint seed)
+{
+    size_t i = get_global_id(0);
+
+    float q;
+    if (type == QUANT_UINT8) q = input[i];
+    else if (type == QUANT_UINT16) q = ((__global const ushort *) input)[i];
+    else if (type == QUANT_INT16) q = ((__global const short *) input)[i];
+    else q = vload_half(i, (__global const half *) input);
+    size_t c = channels == 1 ? 0 : i % channels;
+    float x = mad(params[c * 2], q, params[c * 2 + 1]);
+
+    storeW(w, i, halfW, alpha >= 1.0f ? x : ((1 - alpha) * loadW(w, i, halfW)) + (alpha * x), stochastic, seed);
+    markDirty(dirty, i);
+}
+
+/* Statistics reduced by ReduceStats, stored stat-major: partials[stat * groups + group].
+ * Indices match enum ReduceStat on the host. */
+#define STAT_SUM 0
+#define STAT_SUM_SQUARES 1
+#define STAT_MIN 2
+#define STAT_MAX 3
+#define STAT_DIFFERENCE_SQUARES 4
+#define STAT_MAX_DIFFERENCE 5
+#define STAT_COUNT 6
+
+/* Tree-reduce the statistics of every work-item in the group; lid 0 ends up with the result.
+ * scratch holds STAT_COUNT values per work-item and the group size is a power of two. */
+inline void reduceGroup(__local float *scratch, float stats[STAT_COUNT])
+{
+    size_t lid = get_local_id(0);
+    size_t lsize = get_local_size(0);
+
+    for (int s = 0; s < STAT_COUNT; ++s) scratch[s * lsize + lid] = stats[s];
+
+    for (size_t half = lsize / 2; half > 0; half /= 2) {
+        barrier(CLK_LOCAL_MEM_FENCE);
+        if (lid < half) {
+            __local float *a = scratch + lid;
+            __local float *b = scratch + lid + half;
+            a[STAT_SUM * lsize] += b[STAT_SUM * lsize];
+            a[STAT_SUM_SQUARES * lsize] += b[STAT_SUM_SQUARES * lsize];
+            a[STAT_MIN * lsize] = fmin(a[STAT_MIN * lsize], b[STAT_MIN * lsize]);
+            a[STAT_MAX * lsize] = fmax(a[STAT_MAX * lsize], b[STAT_MAX * lsize]);
+            a[STAT_DIFFERENCE_SQUARES * lsize] += b[STAT_DIFFERENCE_SQUARES * lsize];
+            a[STAT_MAX_DIFFERENCE * lsize] =
+                    fmax(a[STAT_MAX_DIFFERENCE * lsize], b[STAT_MAX_DIFFERENCE * lsize]);
+        }
+    }
+    barrier(CLK_LOCAL_MEM_FENCE);
+}
+
+/* Store the group's reduced statistics, left in scratch by reduceGroup, to its partials. */
+inline void storePartials(__global float *partials, __local float *scratch)
+{
+    if (get_local_id(0) == 0) {
+        size_t groups = get_num_groups(0);
+        for (int s = 0; s < STAT_COUNT; ++s) {
+            partials[s * groups + get_group_id(0)] = scratch[s * get_local_size(0)];
+        }
+    }
+}
+
+/* First stage: each group reduces its grid-strided share of x, and of x - ref
+ * unless ref is null, to one partial per statistic. */
+kernel void ReduceStats(__global const float *x, __global const float *ref, uint n,
+                        __global float *partials, __local float *scratch)
+{
+    float stats[STAT_COUNT] = { 0, 0, FLT_MAX, -FLT_MAX, 0, 0 };
+
+    for (uint i = get_global_id(0); i < n; i += get_global_size(0)) {
+        float v = x[i];
+        stats[STAT_SUM] += v;
+        stats[STAT_SUM_SQUARES] += v * v;
+        stats[STAT_MIN] = fmin(stats[STAT_MIN], v);
+        stats[STAT_MAX] = fmax(stats[STAT_MAX], v);
+        if (ref) {
+            float d = v - ref[i];
+            stats[STAT_DIFFERENCE_SQUARES] += d * d;
+            stats[STAT_MAX_DIFFERENCE] = fmax(stats[STAT_MAX_DIFFERENCE], fabs(d));
+        }
+    }
+
+    reduceGroup(scratch, stats);
+    storePartials(partials, scratch);
+}
+
+/* Second stage: a single group combines the partials of every group into result. */
+kernel void ReduceStatsFinal(__global const float *partials, uint groups,
+                             __global float *result, __local float *scratch)
+{
+    float stats[STAT_COUNT] = { 0, 0, FLT_MAX, -FLT_MAX, 0, 0 };
+
+    for (uint g = get_local_id(0); g < groups; g += get_local_size(0)) {
+        stats[STAT_SUM] += partials[STAT_SUM * groups + g];
+        stats[STAT_SUM_SQUARES] += partials[STAT_SUM_SQUARES * groups + g];
+        stats[STAT_MIN] = fmin(stats[STAT_MIN], partials[STAT_MIN * groups + g]);
+        stats[STAT_MAX] = fmax(stats[STAT_MAX], partials[STAT_MAX * groups + g]);
+        stats[STAT_DIFFERENCE_SQUARES] += partials[STAT_DIFFERENCE_SQUARES * groups + g];
+        stats[STAT_MAX_DIFFERENCE] =
+                fmax(stats[STAT_MAX_DIFFERENCE], partials[STAT_MAX_DIFFERENCE * groups + g]);
+    }
+
+    reduceGroup(scratch, stats);
+    if (get_local_id(0) == 0) {
+        for (int s = 0; s < STAT_COUNT; ++s) result[s] = scratch[s * get_local_size(0)];
+    }
+}
+
+/* Copy the elements of w at the given indices into a compact staging buffer. */
+kernel void GatherW(__global const float *w, __global const uint *indices, uint count,
+                    __global float *staging)
+{
+    size_t i = get_global_id(0);
+    if (i < count) staging[i] = w[indices[i]];
+}
+
+/* GatherW of W stored as halves, widened to floats. */
+kernel void GatherHalfW(__global const half *w, __global const uint *indices, uint count,
+                        __global float *staging)
+{
+    size_t i = get_global_id(0);
+    if (i < count) staging[i] = vload_half(indices[i], w);
+}
+
+/* Widen count elements of W stored as halves into floats, as snapshots keep them. */
+kernel void WidenHalfW(__global const half *w, ulong count, __global float *out)
+{
+    size_t i = get_global_id(0);
+    if (i < count) out[i] = vload_half(i, w);
+}
+
+/* Largest k TopK selects in one pass; each work-item keeps that many candidates in private memory */
+#define TOPK_MAX_K 32
+
+/* Index of an empty candidate slot, when fewer than k elements were seen */
+#define TOPK_NONE 0xffffffff
+
+/* Whether a candidate ranks before another: larger key, then lower index, as on the host. */
+inline bool ranksBefore(float aKey, uint aIndex, float bKey, uint bIndex)
+{
+    return aKey > bKey || (aKey == bKey && aIndex < bIndex);
+}
+
+/* Select the k largest values, or smallest if smallest is set, of n values. Each group writes its
+ * k best, in order, to outValues/outIndices[group * k ...]. indices gives the index of each value,
+ * or the position of the value when null, so running a single group over the output of many
+ * merges their candidates into the final k. Ties go to the lower index. */
+kernel void TopK(__global const float *values, __global const uint *indices, uint n, uint k, int smallest,
+                 __global float *outValues, __global uint *outIndices,
+                 __local float *headKeys, __local uint *headOwners, __local uint *headIndices)
+{
+    size_t lid = get_local_id(0);
+    size_t lsize = get_local_size(0);
+
+    // Private candidates sorted by decreasing key; the key is negated to select the smallest
+    float best[TOPK_MAX_K];
+    uint bestIndex[TOPK_MAX_K];
+    uint count = 0;
+    for (uint i = get_global_id(0); i < n; i += get_global_size(0)) {
+        uint index = indices ? indices[i] : i;
+        if (index == TOPK_NONE) continue;
+        float key = smallest ? -values[i] : values[i];
+        if (count == k && !ranksBefore(key, index, best[k - 1], bestIndex[k - 1])) continue;
+
+        uint j = count < k ? count++ : k - 1;
+        while (j > 0 && ranksBefore(key, index, best[j - 1], bestIndex[j - 1])) {
+            best[j] = best[j - 1];
+            bestIndex[j] = bestIndex[j - 1];
+            --j;
+        }
+        best[j] = key;
+        bestIndex[j] = index;
+    }
+
+    // k rounds in which the work-item with the best head candidate hands it out
+    uint head = 0;
+    for (uint r = 0; r < k; ++r) {
+        headKeys[lid] = head < count ? best[head] : -FLT_MAX;
+        headOwners[lid] = head < count ? lid : TOPK_NONE;
+        headIndices[lid] = head < count ? bestIndex[head] : TOPK_NONE;
+        for (size_t half = lsize / 2; half > 0; half /= 2) {
+            barrier(CLK_LOCAL_MEM_FENCE);
+            if (lid < half && headOwners[lid + half] != TOPK_NONE && (headOwners[lid] == TOPK_NONE
+                    || ranksBefore(headKeys[lid + half], headIndices[lid + half], headKeys[lid], headIndices[lid]))) {
+                headKeys[lid] = headKeys[lid + half];
+                headOwners[lid] = headOwners[lid + half];
+                headIndices[lid] = headIndices[lid + half];
+            }
+        }
+        barrier(CLK_LOCAL_MEM_FENCE);
+        uint winner = headOwners[0];
+        barrier(CLK_LOCAL_MEM_FENCE);
+
+        size_t slot = get_group_id(0) * k + r;
+        if (winner == TOPK_NONE) {
+            if (lid == 0) {
+                outValues[slot] = 0;
+                outIndices[slot] = TOPK_NONE;
+            }
+        } else if (lid == winner) {
+            outValues[slot] = smallest ? -best[head] : best[head];
+            outIndices[slot] = bestIndex[head];
+            ++head;
+        }
+    }
+}
+
+/* UpdateWeights that also reports the elements whose average moved more than epsilon away
+ * from the value last published to the subscriber. Each is appended to deltaIndices and
+ * deltaValues at a slot taken from deltaCount[0] and becomes the published value. Elements
+ * beyond capacity stay unpublished, so they are reported again by a later step, and set
+ * deltaCount[1]. The count stops at capacity, so it cannot wrap however rarely it is polled. */
+kernel void UpdateWeightsDelta(__global float *w, __global const float *input, __private float alpha,
+                               __global uchar *dirty, __global float *published, __private float epsilon,
+                               __global uint *deltaIndices, __global float *deltaValues,
+                               __global uint *deltaCount, __private uint capacity)
+{
+    size_t i = get_global_id(0);
+    float value = alpha >= 1 ? input[i] : ((1 - alpha) * w[i]) + (alpha * input[i]);
+    w[i] = value;
+    markDirty(dirty, i);
+
+    if (fabs(value - published[i]) > epsilon) {
+        uint slot = deltaCount[0];
+        while (slot < capacity) {
+            uint seen = atomic_cmpxchg(deltaCount, slot, slot + 1);
+            if (seen == slot) break;
+            slot = seen;
+        }
+        if (slot < capacity) {
+            deltaIndices[slot] = (uint) i;
+            deltaValues[slot] = value;
+            published[i] = value;
+        } else {
+            deltaCount[1] = 1;
+        }
+    }
+}
+
+/* UpdateWeights over n elements, grid-strided, that also reduces the change of every element
+ * into per-group partials for ReduceStatsFinal: max |change| in STAT_MAX_DIFFERENCE and the
+ * squared L2 norm of the change in STAT_SUM_SQUARES. The change is meaningless for alpha >= 1,
+ * when W may not have been initialized. */
+kernel void UpdateWeightsMonitored(__global float *w, __global const float *input, __private float alpha,
+                                   __global uchar *dirty, uint n, __global float *partials,
+                                   __local float *scratch)
+{
+    float stats[STAT_COUNT] = { 0, 0, FLT_MAX, -FLT_MAX, 0, 0 };
+
+    for (uint i = get_global_id(0); i < n; i += get_global_size(0)) {
+        float old = w[i];
+        float value = alpha >= 1 ? input[i] : ((1 - alpha) * old) + (alpha * input[i]);
+        w[i] = value;
+        markDirty(dirty, i);
+
+        float change = value - old;
+        stats[STAT_SUM] += change;
+        stats[STAT_SUM_SQUARES] += change * change;
+        stats[STAT_MIN] = fmin(stats[STAT_MIN], change);
+        stats[STAT_MAX] = fmax(stats[STAT_MAX], change);
+        stats[STAT_MAX_DIFFERENCE] = fmax(stats[STAT_MAX_DIFFERENCE], fabs(change));
+    }
+
+    reduceGroup(scratch, stats);
+    storePartials(partials, scratch);
+}
+
+/* Blend input into w, unless w is null, and into each of the extra horizons of an exponential
+ * moving average kept interleaved in horizons, horizons[i * extra + h], with its own share of
+ * the input in alphas. Every input element is read once for all of them. */
+kernel void UpdateWeightsEma(__global float *w, __global const float *input, __private float alpha,
+                             __global uchar *dirty, __global float *horizons, __private float8 alphas,
+                             __private uint extra)
+{
+    size_t i = get_global_id(0);
+    float x = input[i];
+    if (w) {
+        w[i] = alpha >= 1 ? x : ((1 - alpha) * w[i]) + (alpha * x);
+        markDirty(dirty, i);
+    }
+
+    float shares[8];
+    vstore8(alphas, 0, shares);
+    __global float *h = horizons + i * extra;
+    for (uint k = 0; k < extra; ++k) {
+        h[k] = shares[k] >= 1 ? x : ((1 - shares[k]) * h[k]) + (shares[k] * x);
+    }
+}
+
+/* Element types of the input ring of a sliding window. Match enum ElementType on the host. */
+#define ELEMENT_FLOAT32 0
+#define ELEMENT_FLOAT16 1
+#define ELEMENT_UINT8 2
+
+/* Input at index i of a ring of the given element type. Bytes map to low + q * step. */
+inline float loadRing(__global const uchar *ring, size_t i, int type, float low, float step)
+{
+    if (type == ELEMENT_FLOAT16) return vload_half(i, (__global const half *) ring);
+    if (type == ELEMENT_UINT8) return low + ring[i] * step;
+    return ((__global const float *) ring)[i];
+}
+
+/* Store x at index i of a ring and return the value stored, as loadRing reads it back. */
+inline float storeRing(__global uchar *ring, size_t i, int type, float low, float step, float inverseStep,
+                       float x)
+{
+    if (type == ELEMENT_FLOAT16) {
+        vstore_half(x, i, (__global half *) ring);
+        return vload_half(i, (__global const half *) ring);
+    }
+    if (type == ELEMENT_UINT8) {
+        float q = clamp(rint((x - low) * inverseStep), 0.0f, 255.0f);
+        ring[i] = (uchar) q;
+        return low + q * step;
+    }
+    ((__global float *) ring)[i] = x;
+    return x;
+}
+
+/* Average of the last inputs of a sliding window. ring keeps them slot-major, ring[slot * size + i],
+ * and sum their running sum. The input replaces slot, whose old input is taken out of the sum
+ * first once the window is full, and w becomes sum * scale, scale being one over the inputs held.
+ * The stored value goes into the sum, so it cancels exactly when the input leaves the window. */
+kernel void UpdateWindow(__global float *w, __global const float *input, __global float *sum,
+                         __global uchar *ring, __global uchar *dirty, __private uint slot, __private int full,
+                         __private float scale, __private int type, __private float low, __private float step,
+                         __private float inverseStep, __private ulong size)
+{
+    size_t i = get_global_id(0);
+    size_t k = slot * size + i;
+
+    float s = sum[i];
+    if (full) s -= loadRing(ring, k, type, low, step);
+    s += storeRing(ring, k, type, low, step, inverseStep, input[i]);
+    sum[i] = s;
+    w[i] = s * scale;
+    markDirty(dirty, i);
+}
+
+/* Recompute the running sum of a sliding window from the count inputs in its ring,
+ * dropping the rounding error the additions and subtractions of past steps left in it. */
+kernel void ResumWindow(__global float *w, __global float *sum, __global const uchar *ring,
+                        __private uint count, __private float scale, __private int type, __private float low,
+                        __private float step, __private ulong size)
+{
+    size_t i = get_global_id(0);
+
+    float s = 0;
+    for (uint k = 0; k < count; ++k) s += loadRing(ring, k * size + i, type, low, step);
+    sum[i] = s;
+    w[i] = s * scale;
+}
+
+/* Decay of an element of a lazily decayed average over the steps from last, the step it was last
+ * brought up to date at, to now. decayLog2 is log2(1 - alpha). */
+inline float lazyFactor(uint now, uint last, float decayLog2)
+{
+    return now == last ? 1.0f : exp2((float) (now - last) * decayLog2);
+}
+
+/* Step of an exponential moving average with lazy decay. Every step decays all of W by 1 - alpha,
+ * inputs absent from it counting as 0, but W holds each element as of lastStep instead. Only the
+ * count elements given an input are brought up to date and blended with it: values[j] at indices[j],
+ * or element j of a dense input when indices is null. Indices are distinct. */
+kernel void UpdateLazy(__global float *w, __global uint *lastStep, __global uchar *dirty,
+                       __global const uint *indices, __global const float *values, uint count,
+                       uint now, float alpha, float decayLog2)
+{
+    size_t j = get_global_id(0);
+    if (j >= count) return;
+    size_t i = indices ? indices[j] : j;
+
+    w[i] = lazyFactor(now, lastStep[i], decayLog2) * w[i] + alpha * values[j];
+    lastStep[i] = now;
+
+    // Scattered elements flag their own tiles
+    if (indices && dirty) dirty[i >> DIRTY_TILE_SHIFT] = 1;
+    else markDirty(dirty, i);
+}
+
+/* Bring elements [begin, begin + count) of a lazily decayed average up to date, so they can be read. */
+kernel void SettleLazy(__global float *w, __global uint *lastStep, __global uchar *dirty, ulong begin,
+                       uint count, uint now, float decayLog2)
+{
+    size_t j = get_global_id(0);
+    if (j >= count) return;
+    size_t i = begin + j;
+
+    uint last = lastStep[i];
+    if (last == now) return;
+    w[i] *= lazyFactor(now, last, decayLog2);
+    lastStep[i] = now;
+    markDirty(dirty, i);
+}
+
+/* Step of a mean kept per element over the inputs it was given: values[j] at indices[j], or element
+ * j of a dense input when indices is null. counts holds the weight each element has received so far,
+ * and an element's first input replaces whatever W held. Indices are distinct. */
+kernel void UpdateCounted(__global float *w, __global float *counts, __global uchar *dirty,
+                          __global const uint *indices, __global const float *values, uint count,
+                          float weight)
+{
+    size_t j = get_global_id(0);
+    if (j >= count) return;
+    size_t i = indices ? indices[j] : j;
+
+    float before = counts[i];
+    float total = before + weight;
+    counts[i] = total;
+    w[i] = before == 0 ? values[j] : w[i] + (weight / total) * (values[j] - w[i]);
+
+    if (indices && dirty) dirty[i >> DIRTY_TILE_SHIFT] = 1;
+    else markDirty(dirty, i);
+}
@@ -7,9 +7,28 @@ LOCAL_MODULE := native-lib
 LOCAL_CFLAGS += -DANDROID_CL
 LOCAL_CFLAGS += -O3 -ffast-math
 
-LOCAL_C_INCLUDES := $(LOCAL_PATH)/../../CL
+LOCAL_C_INCLUDES := $(LOCAL_PATH)/../../CL $(LOCAL_PATH)/../jni/include
 
-LOCAL_SRC_FILES := native-lib.cpp
+LOCAL_SRC_FILES := ../jni/native-lib.cpp \
+                   ../jni/buffer-pool.cpp \
+                   ../jni/tiled-w.cpp \
+                   ../jni/state-file.cpp \
+                   ../jni/dataset-reader.cpp \
+                   ../jni/engine.cpp \
+                   ../jni/thread-pool.cpp \
+                   ../jni/device-reduce.cpp \
+                   ../jni/host-reduce.cpp \
+                   ../jni/sampled-check.cpp \
+                   ../jni/device-read.cpp \
+                   ../jni/snapshot.cpp \
+                   ../jni/delta-stream.cpp \
+                   ../jni/convergence.cpp \
+                   ../jni/ema-horizons.cpp \
+                   ../jni/window-average.cpp \
+                   ../jni/lazy-decay.cpp \
+                   ../jni/element-counts.cpp \
+                   ../jni/quantized-input.cpp \
+                   ../jni/half-storage.cpp
 
 #LOCAL_LDFLAGS += -ljnigraphics
 LOCAL_LDLIBS := -llog -ljnigraphics
@@ -21,6 +21,7 @@ import java.io.FileOutputStream;
 import java.io.IOException;
 import java.io.InputStream;
 import java.io.OutputStream;
+import java.nio.ByteBuffer;
 import java.util.Random;
 
 import static java.lang.Math.abs;
@@ -29,8 +30,11 @@ import static java.lang.Math.sqrt;
 
 public class MainActivity extends AppCompatActivity {
 
-    /** Maximum size of W and input vectors */
-    public int mSizeW;
+    /** Size of W and input vectors */
+    public long mSizeW;
+
+    /** Size requested for W and input vectors upon initialization */
+    public long mRequestedSizeW = 1 << 22;
 
     /** Kernel filename for OpenCL to load */
     public String mKernelName = "UpdateWeights.cl";
@@ -50,6 +54,39 @@ public class MainActivity extends AppCompatActivity {
         super.onCreate(savedInstanceState);
         setContentView(R.layout.activity_main);
 
+        /**
+         * Report progress and results of work running on the engine thread
+         */
+        final TextView resultView = (TextView) findViewById(R.id.result);
+        setEngineListener(new EngineListener()
+        {
+            @Override
+            public void onProgress(long token, long done, long total)
+            {
+                final String output = "Running: " + Long.toString(done) + " of " +
+                        Long.toString(total);
+                runOnUiThread(new Runnable() {
+                    @Override
+                    public void run() {
+                        resultView.setText(output);
+                    }
+                });
+            }
+
+            @Override
+            public void onComplete(long token, int result)
+            {
+                // Still on the engine thread, so W can be read without waiting
+                final String output = getResults();
+                runOnUiThread(new Runnable() {
+                    @Override
+                    public void run() {
+                        resultView.setText(output);
+                    }
+                });
+            }
+        });
+
         /**
          * Initialize OpenCL
          */
@@ -82,7 +119,7 @@ public class MainActivity extends AppCompatActivity {
             public void onClick(View v)
             {
                 // Initialize W on GPU and set size of vector
-                mSizeW = initW();
+                mSizeW = initW(mRequestedSizeW);
 
                 // Allocate space on CPU in order to check GPU correctness
                 // once computation is complete
@@ -95,7 +132,7 @@ public class MainActivity extends AppCompatActivity {
 
                 // Report size of vectors
                 String output = "Array Initialization Complete.\n" +
-                        Integer.toString(mSizeW) + " elements";
+                        Long.toString(mSizeW) + " elements";
                 ((TextView) findViewById(R.id.result)).setText(output);
             }
         });
@@ -160,9 +197,8 @@ public class MainActivity extends AppCompatActivity {
                             result += String.format("\n\nmCpuW[%d]: %f", i, mCpuW[i]);
                             result += String.format("\nmGpuW[%d]: %f", i, mGpuW[i]);
                         }*/
-                        updateWeights(finalTime);
-                        String result = getResults();
-                        ((TextView) findViewById(R.id.result)).setText(result);
+                        // Runs on the engine thread; results are shown once it completes
+                        updateWeightsAsync(finalTime);
                     }
                 });
                 builder.setNegativeButton("Cancel", new DialogInterface.OnClickListener() {
@@ -226,6 +262,30 @@ public class MainActivity extends AppCompatActivity {
     }
 
 
+    /**
+     * Receives progress and completion of work submitted to the native engine thread.
+     * Methods are called on the engine thread; native methods called from them run
+     * immediately as part of the work being reported.
+     */
+    interface EngineListener {
+        /**
+         * Reports how far the work identified by token has got.
+         *
+         * @param token The token returned when the work was submitted
+         * @param done  Steps or vectors done so far
+         * @param total Steps or vectors in total
+         */
+        void onProgress(long token, long done, long total);
+
+        /**
+         * Reports that the work identified by token has finished.
+         *
+         * @param token  The token returned when the work was submitted
+         * @param result The number of steps run or 1 for a batch, 0 on failure
+         */
+        void onComplete(long token, int result);
+    }
+
     /**
      * A native method that creates the OpenCL context and connects to a GPU device.
      *
@@ -239,22 +299,389 @@ public class MainActivity extends AppCompatActivity {
     /**
      * A native method that initializes an array W on the GPU device.
      *
-     * @return An int indicating the size of the array W
+     * W larger than a single device allocation is kept in host memory
+     * and streamed through the GPU in tiles.
+     *
+     * @param size The number of elements in W and the input vector
+     * @return     The size of the array W, 0 on failure
+     */
+    public native long initW(long size);
+
+    /**
+     * A native method that initializes an array W kept in host memory and
+     * streamed through the GPU in tiles regardless of its size.
+     *
+     * @param size The number of elements in W and the input vector
+     * @param path State file to memory-map W from, or null for anonymous memory.
+     *             Checkpoints to the same path only have to sync the mapping.
+     * @return     The size of the array W, 0 on failure
      */
-    public native int initW();
+    public native long initTiledW(long size, String path);
+
+    /**
+     * A native method that persists W and its step count to a state file.
+     *
+     * @param path The state file to write; created if it differs from the last one used
+     * @return     1 on success, 0 on failure
+     */
+    public native int checkpoint(String path);
+
+    /**
+     * A native method that restores W and its step count from a state file
+     * written by checkpoint, so averaging continues without replaying inputs.
+     *
+     * @param path The state file to read
+     * @return     The size of the array W, 0 on failure
+     */
+    public native long restore(String path);
+
+    /**
+     * A native method that resizes W while keeping its averages.
+     * Capacity is doubled on the device when the new size does not fit.
+     *
+     * @param size The new number of elements in W and the input vector
+     * @return     The size of the array W, 0 on failure
+     */
+    public native long resizeW(long size);
+
+    /**
+     * A native method that memory-maps a dataset of input vectors to average
+     * in place of the synthesized input, one vector per step.
+     *
+     * @param path        Dataset file; a .npy array is described by its own header
+     * @param elementType Element type of a raw file: 0 float32, 1 float16, 2 uint8
+     * @param vectorSize  Elements per vector of a raw file; must match the size of W
+     * @return            The number of vectors in the dataset, 0 on failure
+     */
+    public native long openDataset(String path, int elementType, long vectorSize);
+
+    /**
+     * A native method that closes the dataset, going back to the synthesized input.
+     */
+    public native void closeDataset();
 
     /**
      * A native method that updates all input averages via cpu and gpu.
      *
      * @param time  How many iterations to generate input and update weights
+     * @return      The number of steps run, fewer than time once an open dataset runs out
      */
     public native int updateWeights(int time);
 
     /**
-     * @return The array W that was used in the GPU computation.
+     * A native method that queues time update steps on the engine thread and
+     * returns immediately.
+     *
+     * @param time How many iterations to update weights
+     * @return     A token identifying the work to the listener and batchDone
+     * @see #setEngineListener
+     */
+    public native long updateWeightsAsync(int time);
+
+    /**
+     * A native method that sets the listener notified of work on the engine thread.
+     *
+     * @param listener The listener, or null for none
+     */
+    public native void setEngineListener(EngineListener listener);
+
+    /**
+     * A native method that averages one input vector into W, reading it in
+     * place from a direct buffer without a copy.
+     *
+     * @param input Direct buffer of at least mSizeW floats in native byte order
+     * @return      1 on success, 0 on failure
+     */
+    public native int updateWeightsDirect(ByteBuffer input);
+
+    /**
+     * A native method that averages one input vector into W. The array is
+     * pinned for the duration of the update rather than copied where possible.
+     *
+     * @param input Array of at least mSizeW floats
+     * @return      1 on success, 0 on failure
+     */
+    public native int updateWeightsArray(float[] input);
+
+    /**
+     * A native method that queues a batch of input vectors on the engine thread
+     * in a single call and returns immediately. The vectors are read in place
+     * and must not be modified until the batch is done.
+     *
+     * @param vectors    Direct buffer of count vectors of mSizeW floats, back to back
+     * @param count      The number of vectors in the batch
+     * @param timestamps Timestamp of each vector, averaged in timestamp order, or null
+     * @param weights    Non-negative weight of each vector in the average, or null for 1
+     * @return           A token identifying the batch, 0 on failure
+     * @see #batchDone
+     */
+    public native long submitBatch(ByteBuffer vectors, int count, long[] timestamps, float[] weights);
+
+    /**
+     * A native method that reports whether submitted work has finished.
+     *
+     * @param token The token returned by submitBatch or updateWeightsAsync
+     * @return      True once the work has run
+     */
+    public native boolean batchDone(long token);
+
+    /**
+     * A native method that checks the GPU W against a CPU reference kept for a
+     * sample of its elements only, in place of a full CPU copy of W.
+     * getResults then reports the sampled error with 95% confidence bounds.
+     *
+     * @param samples    Elements in the sample, 0 to go back to the full CPU W
+     * @param stratified Draw one element from each of samples equal slices of W
+     *                   rather than uniformly at random
+     * @return           1 on success, 0 on failure
+     */
+    public native int setSampledVerification(long samples, boolean stratified);
+
+    /**
+     * Fills gpuW with the first elements of the array W used in the GPU computation,
+     * reading only as many as it holds.
+     *
+     * @param gpuW Array receiving the elements
      */
     public native void getGpuW(float[] gpuW);
 
+    /**
+     * A native method that reads values.length consecutive elements of W.
+     *
+     * @param begin  Index of the first element
+     * @param values Array receiving the elements
+     * @return       1 on success, 0 on failure
+     */
+    public native int readRangeW(long begin, float[] values);
+
+    /**
+     * A native method that reads blocks of width consecutive elements of W, stride
+     * elements apart, as many as fit in values, packed one after another.
+     *
+     * @param begin  Index of the first element of the first block
+     * @param width  Elements per block
+     * @param stride Elements from the start of one block to the start of the next
+     * @param values Array receiving the blocks
+     * @return       1 on success, 0 on failure
+     */
+    public native int readStridedW(long begin, int width, long stride, float[] values);
+
+    /**
+     * A native method that reads the elements of W at arbitrary indices.
+     *
+     * @param indices Indices of the elements, in any order
+     * @param values  Array receiving the element at indices[i] in values[i]
+     * @return        1 on success, 0 on failure
+     */
+    public native int readGatherW(long[] indices, float[] values);
+
+    /**
+     * A native method that finds the k elements of W with the largest, or smallest,
+     * averages without reading the rest of W back.
+     *
+     * @param k        How many elements to find
+     * @param smallest Find the smallest averages rather than the largest
+     * @param indices  Array of at least k receiving the indices of the elements, best first
+     * @param values   Array of at least k receiving their averages
+     * @return         The number of elements found, fewer than k if W is smaller, -1 on failure
+     */
+    public native int topK(int k, boolean smallest, long[] indices, float[] values);
+
+    /**
+     * A native method that starts reporting the elements of W whose average moved
+     * more than epsilon since they were last reported, from the next step on.
+     * Replaces an earlier subscription.
+     *
+     * @param epsilon  Smallest change reported
+     * @param capacity Most elements reported by one poll; the rest wait for the next
+     * @return         1 on success, 0 on failure
+     */
+    public native int subscribeDeltas(float epsilon, int capacity);
+
+    /**
+     * A native method that takes the elements reported since the previous poll. Elements
+     * that did not fit are reported by a step after this poll, or can be re-read from W.
+     *
+     * @param indices    Array of at least capacity receiving the indices of the elements
+     * @param values     Array of at least capacity receiving their new averages
+     * @param overflowed Array whose first element is set if elements did not fit, or null
+     * @return           The number of elements reported, -1 on failure
+     */
+    public native int pollDeltas(long[] indices, float[] values, boolean[] overflowed);
+
+    /**
+     * A native method that stops reporting changed elements.
+     */
+    public native void unsubscribeDeltas();
+
+    /**
+     * A native method that measures how much each step changes W, and ends batches and
+     * runs early once W has converged: no element moved by tolerance or more for
+     * patience steps in a row.
+     *
+     * @param enabled   Whether to measure the change of each step
+     * @param tolerance Largest change of an element in a quiet step, 0 to never stop early
+     * @param patience  Quiet steps in a row after which W has converged
+     * @return          1 on success, 0 on failure
+     */
+    public native int setConvergenceMonitor(boolean enabled, float tolerance, int patience);
+
+    /**
+     * A native method that stores resident W and its input vector as floats or as halves,
+     * which halves their footprint and doubles the largest W kept on the device. Steps
+     * still blend in float; stochastic rounding keeps the small change of a late step
+     * from always rounding away. Halves take the cumulative mean or a single exponential
+     * moving average, without deltas or convergence monitoring. Halves hold magnitudes
+     * up to 65504: W and float inputs beyond it are refused, as are quantized inputs
+     * whose scales and offsets can reach beyond it.
+     *
+     * @param elementType 0 for float32, 1 for float16
+     * @param rounding    0 to round to nearest, 1 to round stochastically
+     * @return            1 on success, 0 on failure
+     */
+    public native int setStorage(int elementType, int rounding);
+
+    /**
+     * A native method that reports the change made by the last measured step.
+     *
+     * @param change Array of 3 receiving the step, its largest change of an element
+     *               and the L2 norm of its change
+     * @return       Whether W has converged
+     */
+    public native boolean getConvergence(double[] change);
+
+    /**
+     * A native method that selects how W averages its inputs: the cumulative mean (0), an
+     * exponential moving average (1) of one horizon per smoothing factor, an exponential
+     * moving average decayed lazily (3), or the mean of each element over the inputs that gave
+     * it a value (4). W holds the first horizon; the others are kept alongside and start out
+     * from W. Modes 3 and 4 also take sparse and masked inputs. A lazily decayed average counts
+     * elements missing from an input as 0; both start out at 0.
+     *
+     * @param mode   0 for the cumulative mean, 1 for an exponential moving average,
+     *               3 for a lazily decayed one, 4 for a mean kept per element
+     * @param alphas Smoothing factors in (0, 1], up to 8, or a single one in (0, 1) for mode 3;
+     *               ignored for modes 0 and 4
+     * @return       1 on success, 0 on failure
+     */
+    public native int setAveragingMode(int mode, float[] alphas);
+
+    /**
+     * A native method that averages a sparse input into W, for averaging modes 3 and 4. Only the
+     * given elements are touched; under mode 3 the others decay the next time they are updated or read.
+     *
+     * @param indices Distinct elements of W given an input
+     * @param values  Input of each element in indices
+     * @return        1 on success, 0 on failure
+     */
+    public native int updateWeightsSparse(long[] indices, float[] values);
+
+    /**
+     * A native method that averages sparse inputs in compressed rows into W, one step per row,
+     * for averaging modes 3 and 4.
+     *
+     * @param rowOffsets Start of each row in indices and values, followed by the end of the last
+     * @param indices    Distinct elements of W given an input within each row
+     * @param values     Input of each element in indices
+     * @return           1 on success, 0 on failure. No row is applied when any row is invalid.
+     */
+    public native int updateWeightsSparseRows(long[] rowOffsets, long[] indices, float[] values);
+
+    /**
+     * A native method that averages a dense input with missing elements into W, for averaging
+     * modes 3 and 4. Elements flagged 0 in the mask are treated as absent from the input.
+     *
+     * @param input Input vector of the size of W
+     * @param mask  Nonzero for each element of input that is valid
+     * @return      1 on success, 0 on failure
+     */
+    public native int updateWeightsMasked(float[] input, byte[] mask);
+
+    /**
+     * A native method that averages one input vector of integers or halves into W, dequantizing
+     * each element as scale * q + offset of its channel during the update. Element i belongs to
+     * channel i % scales.length; a single scale and offset apply to the whole vector.
+     *
+     * The fused update only blends W itself. It is refused in averaging modes 2, 3 and 4,
+     * with more than one EMA horizon, while deltas are subscribed, with sampled verification
+     * and with the convergence monitor on; dequantize into updateWeightsArray for those.
+     *
+     * @param input   Direct buffer of mSizeW elements in native byte order
+     * @param type    0 for uint8, 1 for uint16, 2 for int16, 3 for float16
+     * @param scales  Scale of each channel, up to 64
+     * @param offsets Offset of each channel
+     * @return        1 on success, 0 on failure
+     */
+    public native int updateWeightsQuantized(ByteBuffer input, int type, float[] scales, float[] offsets);
+
+    /**
+     * A native method that makes W the mean of the last length inputs. The inputs are kept
+     * in a ring, as float32 (0), float16 (1) or bytes spread evenly over [low, high] (2),
+     * and averaged as stored. The window starts out empty. Sliding windows cannot be
+     * checkpointed or checked by sampled verification.
+     *
+     * @param length        Number of inputs averaged
+     * @param elementType   Type inputs are stored as in the ring
+     * @param low           Smallest byte-stored input
+     * @param high          Largest byte-stored input
+     * @param resumInterval Steps between recomputing the running sum from the ring, 0 for length
+     * @return              1 on success, 0 on failure
+     */
+    public native int setSlidingWindow(int length, int elementType, float low, float high, int resumInterval);
+
+    /**
+     * A native method that reads every horizon of consecutive elements of W, interleaved:
+     * values holds one row of as many values as there are horizons per element.
+     *
+     * @param begin  Index of the first element
+     * @param values Array receiving the rows
+     * @return       1 on success, 0 on failure
+     */
+    public native int readHorizons(long begin, float[] values);
+
+    /**
+     * A native method that takes a snapshot of W between two update steps without
+     * waiting for queued work. Updates go on while the snapshot is read.
+     *
+     * @return A handle to the snapshot, 0 on failure
+     * @see #releaseSnapshot
+     */
+    public native long snapshotW();
+
+    /**
+     * A native method that reports the step count W had when the snapshot was taken.
+     *
+     * @param handle The handle returned by snapshotW
+     * @return       The step count, -1 for an unknown handle
+     */
+    public native long snapshotStep(long handle);
+
+    /**
+     * A native method that reports whether a snapshot can be read without waiting.
+     *
+     * @param handle The handle returned by snapshotW
+     * @return       True once the snapshot has been copied
+     */
+    public native boolean snapshotReady(long handle);
+
+    /**
+     * A native method that reads values.length consecutive elements of a snapshot,
+     * waiting for its copy but not for updates queued after it.
+     *
+     * @param handle The handle returned by snapshotW
+     * @param begin  Index of the first element
+     * @param values Array receiving the elements
+     * @return       1 on success, 0 on failure
+     */
+    public native int readSnapshot(long handle, long begin, float[] values);
+
+    /**
+     * A native method that frees a snapshot.
+     *
+     * @param handle The handle returned by snapshotW
+     */
+    public native void releaseSnapshot(long handle);
+
     /**
 	 * Loads the kernel into the app_execdir.
      *
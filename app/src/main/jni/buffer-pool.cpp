@@ -0,0 +1,162 @@
+/**
+ * buffer-pool.cpp
+ * @author Jonathan Dowdall
+ * @since 10-18-2026
+ */
+
+#include "buffer-pool.h"
+
+/** Global buffer pool shared by every engine in the process */
+BufferPool bufferPool;
+
+BufferPool::BufferPool()
+    : context(NULL), reservedSize(0), maxReservedSize(64 * 1024 * 1024),
+      maxAllocationSize((size_t) -1)
+{
+}
+
+BufferPool::~BufferPool()
+{
+    freeAllReservedBuffers();
+    for (size_t i = 0; i < allocated.size(); ++i) {
+        clReleaseMemObject(allocated[i].buffer);
+    }
+}
+
+void BufferPool::setContext(cl_context newContext)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    if (newContext == context) return;
+
+    trimReserved(0);
+    for (size_t i = 0; i < allocated.size(); ++i) {
+        clReleaseMemObject(allocated[i].buffer);
+    }
+    allocated.clear();
+    context = newContext;
+}
+
+size_t BufferPool::allocationGranularity(size_t size)
+{
+    if (size < 1024 * 1024) return 4096;
+    if (size < 16 * 1024 * 1024) return 64 * 1024;
+    return 1024 * 1024;
+}
+
+cl_mem BufferPool::allocate(size_t size, cl_mem_flags flags, cl_int *err)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+
+    size_t granularity = allocationGranularity(size);
+    size_t capacity = (size + granularity - 1) / granularity * granularity;
+    if (capacity > maxAllocationSize) capacity = size;
+
+    // Best fit among reserved buffers with matching flags; accept at most
+    // one eighth of slack so a small request doesn't pin a huge buffer.
+    std::list<Entry>::iterator best = reserved.end();
+    for (std::list<Entry>::iterator it = reserved.begin(); it != reserved.end(); ++it) {
+        if (it->flags != flags || it->capacity < capacity) continue;
+        if (it->capacity - capacity > it->capacity / 8) continue;
+        if (best == reserved.end() || it->capacity < best->capacity) best = it;
+    }
+
+    if (best != reserved.end()) {
+        Entry entry = *best;
+        reserved.erase(best);
+        reservedSize -= entry.capacity;
+        allocated.push_back(entry);
+        *err = CL_SUCCESS;
+        return entry.buffer;
+    }
+
+    Entry entry;
+    entry.capacity = capacity;
+    entry.flags = flags;
+    entry.buffer = clCreateBuffer(context, flags, capacity, NULL, err);
+
+    // Device may be out of memory only because of what is being held in reserve
+    if (*err == CL_MEM_OBJECT_ALLOCATION_FAILURE || *err == CL_OUT_OF_RESOURCES) {
+        trimReserved(0);
+        entry.buffer = clCreateBuffer(context, flags, capacity, NULL, err);
+    }
+    if (*err != CL_SUCCESS) return NULL;
+
+    allocated.push_back(entry);
+    return entry.buffer;
+}
+
+void BufferPool::release(cl_mem buffer)
+{
+    if (buffer == NULL) return;
+    std::lock_guard<std::mutex> lock(mutex);
+
+    for (size_t i = 0; i < allocated.size(); ++i) {
+        if (allocated[i].buffer != buffer) continue;
+
+        Entry entry = allocated[i];
+        allocated[i] = allocated.back();
+        allocated.pop_back();
+
+        if (entry.capacity > maxReservedSize) {
+            clReleaseMemObject(entry.buffer);
+            return;
+        }
+        reserved.push_front(entry);
+        reservedSize += entry.capacity;
+        trimReserved(maxReservedSize);
+        return;
+    }
+
+    // Not created by the pool (e.g. wrapping a host pointer)
+    clReleaseMemObject(buffer);
+}
+
+void BufferPool::setMaxAllocationSize(size_t size)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    maxAllocationSize = size;
+}
+
+size_t BufferPool::capacity(cl_mem buffer) const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    for (size_t i = 0; i < allocated.size(); ++i) {
+        if (allocated[i].buffer == buffer) return allocated[i].capacity;
+    }
+    return 0;
+}
+
+void BufferPool::trimReserved(size_t limit)
+{
+    while (reservedSize > limit && !reserved.empty()) {
+        Entry &oldest = reserved.back();
+        clReleaseMemObject(oldest.buffer);
+        reservedSize -= oldest.capacity;
+        reserved.pop_back();
+    }
+}
+
+size_t BufferPool::getReservedSize() const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return reservedSize;
+}
+
+size_t BufferPool::getMaxReservedSize() const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return maxReservedSize;
+}
+
+void BufferPool::setMaxReservedSize(size_t size)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    maxReservedSize = size;
+    trimReserved(maxReservedSize);
+}
+
+void BufferPool::freeAllReservedBuffers()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    trimReserved(0);
+}
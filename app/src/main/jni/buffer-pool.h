@@ -0,0 +1,94 @@
+/**
+ * buffer-pool.h
+ * @author Jonathan Dowdall
+ * @since 10-18-2026
+ */
+
+#ifndef UPDATEWEIGHTS_BUFFER_POOL_H
+#define UPDATEWEIGHTS_BUFFER_POOL_H
+
+#include <cstddef>
+#include <list>
+#include <mutex>
+#include <vector>
+#include <opencv2/core/bufferpool.hpp>
+
+#include "common.h"
+
+/** Owner of every OpenCL buffer created by the native library.
+ *
+ * Buffers are handed out rounded up to a size class and, when released,
+ * kept in a reserved list instead of being freed. A later request with the
+ * same flags and a fitting size class is served from that list without a
+ * clCreateBuffer call, so W and the input vector survive between runs.
+ *
+ * The total size of reserved (released but not freed) buffers is bounded
+ * by the max reserved size; the least recently released buffers are freed
+ * first when the bound is exceeded.
+ *
+ * Modeled on the OpenCL buffer pool behind cv::BufferPoolController.
+ */
+class BufferPool : public cv::BufferPoolController
+{
+public:
+    BufferPool();
+    ~BufferPool();
+
+    /** Bind the pool to a context, freeing every buffer of the previous one. */
+    void setContext(cl_context context);
+
+    /** Hand out a buffer of at least size bytes created with flags.
+     *  Returns NULL and sets *err if the allocation fails. */
+    cl_mem allocate(size_t size, cl_mem_flags flags, cl_int *err);
+
+    /** Return a buffer to the reserved list. Buffers the pool does not own are released. */
+    void release(cl_mem buffer);
+
+    /** Largest single buffer the device can create; size classes never round past it. */
+    void setMaxAllocationSize(size_t size);
+
+    /** Capacity in bytes of a buffer handed out by the pool, 0 if unknown. */
+    size_t capacity(cl_mem buffer) const;
+
+    size_t getReservedSize() const;
+    size_t getMaxReservedSize() const;
+    void setMaxReservedSize(size_t size);
+    void freeAllReservedBuffers();
+
+private:
+    struct Entry
+    {
+        /** The pooled buffer */
+        cl_mem buffer;
+
+        /** Size class the buffer was created with, in bytes */
+        size_t capacity;
+
+        /** Flags the buffer was created with */
+        cl_mem_flags flags;
+    };
+
+    /** Rounding applied to requested sizes: finer for small buffers, coarser for large ones. */
+    static size_t allocationGranularity(size_t size);
+
+    /** Free reserved buffers until the reserved size fits under the limit. Requires mutex. */
+    void trimReserved(size_t limit);
+
+    mutable std::mutex mutex;
+    cl_context context;
+
+    /** Buffers currently handed out */
+    std::vector<Entry> allocated;
+
+    /** Buffers released back to the pool, most recently released first */
+    std::list<Entry> reserved;
+
+    size_t reservedSize;
+    size_t maxReservedSize;
+    size_t maxAllocationSize;
+};
+
+/** Global buffer pool shared by every engine in the process */
+extern BufferPool bufferPool;
+
+#endif // UPDATEWEIGHTS_BUFFER_POOL_H
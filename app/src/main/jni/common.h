@@ -0,0 +1,271 @@
+/**
+ * common.h
+ * @author Jonathan Dowdall
+ * @since 10-18-2026
+ *
+ * Declarations shared between the native translation units: the OpenCL
+ * object container, device properties, LogCat shortcuts and error checking.
+ */
+
+#ifndef UPDATEWEIGHTS_COMMON_H
+#define UPDATEWEIGHTS_COMMON_H
+
+#include <CL/cl.h>
+#include <android/log.h>
+
+/* Container for all OpenCL-specific objects used.
+ *
+ * The container consists of the following parts:
+ *   - Regular OpenCL objects, used in almost each
+ *     OpenCL application.
+ *   - Specific OpenCL objects - buffers, used in this
+ *     particular sample.
+ *
+ * For convenience, collect all objects in one structure.
+ * Avoid global variables and make easier the process of passing
+ * all arguments in functions.
+ *
+ * As defined by Kronos specification:
+ * https://www.khronos.org/registry/cl/specs/opencl-1.0.29.pdf
+ */
+struct OpenCLObjects
+{
+    /** The platform consists of one or more OpenCL devices */
+    cl_platform_id platform;
+
+    /** A device is a collection of compute units. A command-queue is used to queue
+     * commands to a device. Examples of commands include executing kernels,
+     * or reading and writing memory objects. OpenCL devices typically correspond to a GPU,
+     * a multi-core CPU, and other processors such as DSPs and the Cell/B.E. processor. */
+    cl_device_id device;
+
+    /** The environment within which the kernels execute and
+     * the domain in which synchronization and memory management is defined.
+     * The context includes a set of devices, the memory accessible to those devices,
+     * the corresponding memory properties and one or more command-queues used to
+     * schedule execution of a kernel(s) or operations on memory objects.
+     */
+    cl_context context;
+
+    /** A data structure used to coordinate execution of the kernels on the devices.
+     * The host places commands into the command-queue
+     * which are then scheduled onto the devices within the context.
+     */
+    cl_command_queue queue;
+
+    /** Second queue for reads of snapshots of W, so they never wait behind updates. */
+    cl_command_queue readQueue;
+
+    /** An object that encapsulates the following:
+     *      - A reference to an associated context.
+     *      - A program source or binary.
+     *      - The latest successfully built program executable,
+     *        the list of devices for which the program executable
+     *        is built, the build options used and a build log.
+     *      - The number of kernel objects currently attached.
+     */
+    cl_program program;
+
+    /** Kernel used to update elements in array W when provided new input vector. */
+    cl_kernel updateWeights;
+
+    /** Kernels reducing an array to its statistics: per work-group, then across groups. */
+    cl_kernel reduceStats;
+    cl_kernel reduceStatsFinal;
+
+    /** Kernel copying the elements of W at a list of indices into a compact buffer. */
+    cl_kernel gatherW;
+    cl_kernel gatherHalfW;
+
+    /** Kernel widening W stored as halves into a buffer of floats. */
+    cl_kernel widenHalfW;
+
+    /** Kernel selecting the k largest or smallest elements, per work-group and then across groups. */
+    cl_kernel topK;
+
+    /** UpdateWeights that also appends the elements that moved beyond a threshold to a delta stream. */
+    cl_kernel updateWeightsDelta;
+
+    /** UpdateWeights that also reduces the change it made to W, for convergence monitoring. */
+    cl_kernel updateWeightsMonitored;
+
+    /** UpdateWeights that also blends the input into the extra horizons of an exponential moving average. */
+    cl_kernel updateWeightsEma;
+
+    /** Kernels of a sliding window: a step through its input ring, and recomputing its running sum. */
+    cl_kernel updateWindow;
+    cl_kernel resumWindow;
+
+    /** Kernels of a lazily decayed average: a step through the elements given an input, and bringing a range up to date. */
+    cl_kernel updateLazy;
+    cl_kernel settleLazy;
+
+    /** Kernel of a mean kept per element over the inputs it was given */
+    cl_kernel updateCounted;
+
+    /** Kernel of UpdateWeights over an input of integers, dequantized as it is read */
+    cl_kernel updateWeightsQuantized;
+
+    /** Kernel of UpdateWeights with W stored as halves */
+    cl_kernel updateWeightsHalf;
+};
+
+/** The GPU properties provided by OpenCL APU queries.
+ *
+ * These properties are important to properly manage problem dimensions
+ * and memory management.
+ */
+struct GpuProperties{
+    /** The name of the GPU device */
+    char name[128];
+
+    /** How many compute units (GPU cores) are on the device */
+    cl_int computeUnits;
+
+    /** Maximum global memory size */
+    cl_ulong globalMem;
+
+    /** Maximum local memory size */
+    cl_ulong localMem;
+
+    /** Maximum size of memory allocation for buffers */
+    cl_ulong maxAllocSize;
+
+    /** True if GPU shares memory with host (integrated graphics)
+     *  False if GPU has dedicated memory (discrete graphics)
+     *      -Information must be transferred between host and GPU
+     */
+    cl_bool unifiedMem;
+
+    /** Alignment in bytes of buffers and sub-buffers, and of host memory used in place */
+    cl_ulong memBaseAlign;
+};
+
+struct W{
+    /** Memory allocated for array w */
+    cl_mem buffer;
+
+    /** Pointer to mapped to allocated memory for array W */
+    float* pointer;
+
+    /** Size of array */
+    cl_ulong size;
+
+    /** Number of elements allocated, at least size */
+    cl_ulong capacity;
+};
+
+/** How W averages its inputs. Stored in state files, so values must not change. */
+enum AveragingMode
+{
+    /** Cumulative mean w = (t-1)/t * w + x/t */
+    MODE_CUMULATIVE = 0,
+
+    /** Exponential moving average w = (1 - alpha) * w + alpha * x, of one or more horizons */
+    MODE_EMA = 1,
+
+    /** Mean of the last N inputs, w = (x_t + ... + x_t-N+1) / N */
+    MODE_WINDOW = 2,
+
+    /** Exponential moving average of sparse inputs, decayed when an element is touched or read */
+    MODE_LAZY_EMA = 3,
+
+    /** Cumulative mean of each element over the inputs that gave it a value */
+    MODE_PER_ELEMENT = 4,
+};
+
+/** Element type of stored arrays: W in state files and input datasets.
+ *  Stored in files, so values must not change. */
+enum ElementType
+{
+    ELEMENT_FLOAT32 = 0,
+    ELEMENT_FLOAT16 = 1,
+    ELEMENT_UINT8 = 2,
+};
+
+/** Input vectors submitted together, averaged into W one after another */
+struct Batch
+{
+    /** Token the submitter identifies the batch by */
+    cl_long token;
+
+    /** count vectors of vectorSize elements, back to back. vectorSize has to match W. */
+    const float *vectors;
+    cl_ulong count;
+    cl_ulong vectorSize;
+
+    /** Timestamp of each vector, NULL if the batch has none */
+    const cl_long *timestamps;
+
+    /** Weight of each vector, NULL if every vector weighs 1 */
+    const float *weights;
+};
+
+/** Statistics of an array x, and of its difference to a reference when one is given */
+struct ArrayStats
+{
+    /** Sum and sum of squares of x; sqrt(sumSquares) is its L2 norm */
+    double sum;
+    double sumSquares;
+
+    /** Smallest and largest element of x */
+    double min;
+    double max;
+
+    /** Sum of squared differences to the reference (square of the L2 distance) and
+     *  largest absolute difference (L-inf distance). 0 without a reference. */
+    double differenceSquares;
+    double maxDifference;
+};
+
+/** An element of W and its index */
+struct IndexedValue
+{
+    cl_ulong index;
+    float value;
+};
+
+/** Global cl variable to store context among functions */
+extern OpenCLObjects cl;
+
+/** Global GPU properties to share between initialization and kernel designs */
+extern GpuProperties gpu;
+
+// Commonly-defined shortcuts for LogCat output from native C applications.
+#define  LOG_TAG    "AndroidBasic"
+#define  LOGD(...)  __android_log_print(ANDROID_LOG_DEBUG, LOG_TAG, __VA_ARGS__)
+#define  LOGE(...)  __android_log_print(ANDROID_LOG_ERROR, LOG_TAG, __VA_ARGS__)
+
+/* This function helps to create informative messages in
+ * case when OpenCL errors occur. The function returns a string
+ * representation for an OpenCL error code.
+ * For example, "CL_DEVICE_NOT_FOUND" instead of "-1".
+ */
+const char* opencl_error_to_str (cl_int error);
+
+/* The following macro is used after each OpenCL call
+ * to check if OpenCL error occurs. In the case when ERR != CL_SUCCESS
+ * the macro forms an error message with OpenCL error code mnemonic,
+ * puts it to LogCat, and returns from a caller function.
+ *
+ * The approach helps to implement consistent error handling tactics
+ * because it is important to catch OpenCL errors as soon as
+ * possible to avoid missing the origin of the problem.
+ *
+ * You may chose a different way to do that. The macro is
+ * simple and context-specific as it assumes you use it in a function
+ * that doesn't have a return value, so it just returns in the end.
+ */
+#define SAMPLE_CHECK_ERRORS(ERR)                                                      \
+    if(ERR != CL_SUCCESS)                                                             \
+    {                                                                                 \
+        LOGE                                                                          \
+        (                                                                             \
+            "OpenCL error with code %s happened in file %s at line %d. Exiting.\n",   \
+            opencl_error_to_str(ERR), __FILE__, __LINE__                              \
+        );                                                                            \
+                                                                                      \
+        return 0;                                                                     \
+    }
+
+#endif // UPDATEWEIGHTS_COMMON_H
@@ -0,0 +1,117 @@
+/**
+ * convergence.cpp
+ * @author Jonathan Dowdall
+ * @since 10-18-2026
+ */
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+
+#include "convergence.h"
+#include "buffer-pool.h"
+
+cl_int enqueueMonitoredUpdate(Convergence &convergence, cl_mem w, cl_mem input, float alpha, cl_mem dirty,
+                              cl_ulong n)
+{
+    cl_int err;
+
+    // Grid-strided like ReduceStats, so the partials stay few enough for a single final group
+    cl_kernel kernels[2] = { cl.updateWeightsMonitored, cl.reduceStatsFinal };
+    size_t local = groupSize(kernels, 2, STAT_COUNT * sizeof(float));
+    size_t groups = (size_t) std::min<cl_ulong>((n + local - 1) / local, (cl_ulong) gpu.computeUnits * 8);
+    cl_uint count = (cl_uint) n;
+    cl_uint groupCount = (cl_uint) groups;
+
+    convergence.partials = bufferPool.allocate(STAT_COUNT * groups * sizeof(float), CL_MEM_READ_WRITE, &err);
+    if (err != CL_SUCCESS) return err;
+    convergence.result = bufferPool.allocate(STAT_COUNT * sizeof(float), CL_MEM_READ_WRITE, &err);
+    if (err != CL_SUCCESS) return err;
+
+    err = clSetKernelArg(cl.updateWeightsMonitored, 0, sizeof(cl_mem), &w);
+    err |= clSetKernelArg(cl.updateWeightsMonitored, 1, sizeof(cl_mem), &input);
+    err |= clSetKernelArg(cl.updateWeightsMonitored, 2, sizeof(float), &alpha);
+    err |= clSetKernelArg(cl.updateWeightsMonitored, 3, sizeof(cl_mem), &dirty);
+    err |= clSetKernelArg(cl.updateWeightsMonitored, 4, sizeof(cl_uint), &count);
+    err |= clSetKernelArg(cl.updateWeightsMonitored, 5, sizeof(cl_mem), &convergence.partials);
+    err |= clSetKernelArg(cl.updateWeightsMonitored, 6, STAT_COUNT * local * sizeof(float), NULL);
+    err |= clSetKernelArg(cl.reduceStatsFinal, 0, sizeof(cl_mem), &convergence.partials);
+    err |= clSetKernelArg(cl.reduceStatsFinal, 1, sizeof(cl_uint), &groupCount);
+    err |= clSetKernelArg(cl.reduceStatsFinal, 2, sizeof(cl_mem), &convergence.result);
+    err |= clSetKernelArg(cl.reduceStatsFinal, 3, STAT_COUNT * local * sizeof(float), NULL);
+
+    size_t globalSize = groups * local;
+    if (err == CL_SUCCESS) err = clEnqueueNDRangeKernel
+            (
+                    cl.queue, // command_queue
+                    cl.updateWeightsMonitored, // kernel
+                    1, // work_dim
+                    NULL, // *global_work_offset
+                    &globalSize, // *global_work_size
+                    &local, // *local_work_size
+                    0, // num_events_in_wait_list
+                    NULL, // *event_wait_list
+                    NULL // *event
+            );
+    if (err == CL_SUCCESS) err = clEnqueueNDRangeKernel
+            (
+                    cl.queue, // command_queue
+                    cl.reduceStatsFinal, // kernel
+                    1, // work_dim
+                    NULL, // *global_work_offset
+                    &local, // *global_work_size
+                    &local, // *local_work_size
+                    0, // num_events_in_wait_list
+                    NULL, // *event_wait_list
+                    NULL // *event
+            );
+
+    // Read along with the step; the values are valid once the queue has finished
+    if (err == CL_SUCCESS) err = clEnqueueReadBuffer
+            (
+                    cl.queue, // command_queue
+                    convergence.result, // buffer
+                    false, // blocking_read
+                    0, // offset
+                    sizeof(convergence.values), // cb
+                    convergence.values, // *ptr
+                    0, // num_events_in_wait_list
+                    NULL, // *event_wait_list
+                    NULL // *event
+            );
+    return err;
+}
+
+void finishMonitoredUpdate(Convergence &convergence, cl_ulong step, bool succeeded)
+{
+    bufferPool.release(convergence.partials);
+    bufferPool.release(convergence.result);
+    convergence.partials = NULL;
+    convergence.result = NULL;
+
+    if (succeeded) {
+        recordChange(convergence, step, convergence.values[STAT_MAX_DIFFERENCE],
+                     std::sqrt((double) convergence.values[STAT_SUM_SQUARES]));
+    }
+}
+
+void recordChange(Convergence &convergence, cl_ulong step, double maxChange, double normChange)
+{
+    convergence.step = step;
+    convergence.maxChange = maxChange;
+    convergence.normChange = normChange;
+
+    // A tolerance of 0 only monitors
+    bool quiet = convergence.tolerance > 0 && maxChange < convergence.tolerance;
+    convergence.quietSteps = quiet ? convergence.quietSteps + 1 : 0;
+    convergence.converged = quiet && convergence.quietSteps >= std::max(convergence.patience, 1);
+}
+
+void resetConvergence(Convergence &convergence)
+{
+    convergence.step = 0;
+    convergence.maxChange = DBL_MAX;
+    convergence.normChange = DBL_MAX;
+    convergence.quietSteps = 0;
+    convergence.converged = false;
+}
@@ -0,0 +1,65 @@
+/**
+ * convergence.h
+ * @author Jonathan Dowdall
+ * @since 10-18-2026
+ */
+
+#ifndef UPDATEWEIGHTS_CONVERGENCE_H
+#define UPDATEWEIGHTS_CONVERGENCE_H
+
+#include "common.h"
+#include "device-reduce.h"
+
+/** Change each step makes to W, and the policy ending ingestion once it has settled.
+ *
+ * A step's change is reduced to its largest magnitude and its L2 norm. Resident W
+ * measures it in the UpdateWeightsMonitored kernel as part of the step. Otherwise it
+ * is derived after the step from the input and the new average: for an input of share
+ * alpha, w' - w = alpha / (1 - alpha) * (input - w'), so the old W is not needed.
+ *
+ * A step is quiet when no element moved by tolerance or more. After patience quiet
+ * steps in a row W is converged, and batches and runs stop early until a step is not.
+ */
+struct Convergence
+{
+    bool active;
+    float tolerance;
+    int patience;
+
+    /** Last step measured, its largest change and the L2 norm of its change.
+     *  Both are DBL_MAX for a step that replaced W with its input. */
+    cl_ulong step;
+    double maxChange;
+    double normChange;
+    int quietSteps;
+    bool converged;
+
+    /** Buffers and results of the fused measurement while its step is queued */
+    cl_mem partials;
+    cl_mem result;
+    float values[STAT_COUNT];
+};
+
+/*
+ * Queue a step of the n elements of resident W that also measures its change.
+ * Finish it with finishMonitoredUpdate once the queue has finished, even on failure.
+ */
+cl_int enqueueMonitoredUpdate(Convergence &convergence, cl_mem w, cl_mem input, float alpha, cl_mem dirty,
+                              cl_ulong n);
+
+/*
+ * Record the change measured by the queued step, if it succeeded, and release its buffers.
+ */
+void finishMonitoredUpdate(Convergence &convergence, cl_ulong step, bool succeeded);
+
+/*
+ * Record the change made by step and apply the stopping policy.
+ */
+void recordChange(Convergence &convergence, cl_ulong step, double maxChange, double normChange);
+
+/*
+ * Forget the measured steps, keeping the policy. Called whenever W is replaced.
+ */
+void resetConvergence(Convergence &convergence);
+
+#endif // UPDATEWEIGHTS_CONVERGENCE_H
@@ -0,0 +1,262 @@
+/**
+ * dataset-reader.cpp
+ * @author Jonathan Dowdall
+ * @since 10-18-2026
+ */
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <stdint.h>
+#include <cstring>
+#include <cstdlib>
+#include <string>
+#include <algorithm>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+#include "dataset-reader.h"
+#include "half-float.h"
+
+/** State shared between a dataset and its prefetch thread */
+struct DatasetPrefetch
+{
+    std::thread thread;
+    std::mutex mutex;
+    std::condition_variable wake;
+
+    /** Offset in the mapping of the vector being read */
+    size_t cursor;
+
+    /** Set to make the thread exit */
+    bool stop;
+};
+
+/*
+ * Bytes per element of a dataset, 0 if the type cannot be read.
+ */
+static size_t elementBytes(cl_uint elementType)
+{
+    switch (elementType) {
+        case ELEMENT_FLOAT32: return 4;
+        case ELEMENT_FLOAT16: return 2;
+        case ELEMENT_UINT8: return 1;
+        default: return 0;
+    }
+}
+
+/*
+ * Parse the header of a .npy file mapped at map into the element type and shape of dataset.
+ * Returns NULL on success, otherwise what is wrong with the file.
+ */
+static const char *parseNpy(Dataset &dataset, const char *map, size_t bytes)
+{
+    if (bytes < 10 || memcmp(map, "\x93NUMPY", 6) != 0) return "not a .npy file";
+
+    // Version 1 has a 16-bit header length, later versions a 32-bit one
+    size_t headerLength, headerStart;
+    const unsigned char *length = (const unsigned char *) map + 8;
+    if (map[6] == 1) {
+        headerLength = length[0] | (size_t) length[1] << 8;
+        headerStart = 10;
+    } else {
+        if (bytes < 12) return "truncated";
+        headerLength = length[0] | (size_t) length[1] << 8
+                       | (size_t) length[2] << 16 | (size_t) length[3] << 24;
+        headerStart = 12;
+    }
+    if (headerLength > bytes - headerStart) return "truncated";
+    std::string header(map + headerStart, headerLength);
+
+    size_t descr = header.find("'descr':");
+    size_t order = header.find("'fortran_order':");
+    size_t shape = header.find("'shape':");
+    if (descr == std::string::npos || order == std::string::npos || shape == std::string::npos) {
+        return "malformed header";
+    }
+
+    // Only little-endian (or byte-sized) types are mapped as they are
+    descr = header.find('\'', descr + 8);
+    std::string type = header.substr(descr + 1, 3);
+    if (type == "<f4") dataset.elementType = ELEMENT_FLOAT32;
+    else if (type == "<f2") dataset.elementType = ELEMENT_FLOAT16;
+    else if (type == "|u1") dataset.elementType = ELEMENT_UINT8;
+    else return "unsupported dtype";
+
+    if (header.find("False", order) != header.find_first_not_of(' ', order + 16)) {
+        return "not C-ordered";
+    }
+
+    // The first axis indexes the vectors and the others make up a vector
+    const char *dims = header.c_str() + header.find('(', shape) + 1;
+    cl_ulong extents[8];
+    int rank = 0;
+    while (rank < 8) {
+        char *end;
+        extents[rank] = strtoull(dims, &end, 10);
+        if (end == dims) break;
+        ++rank;
+        dims = end + strspn(end, ", ");
+    }
+    if (rank == 0) return "scalar array";
+
+    dataset.count = rank > 1 ? extents[0] : 1;
+    dataset.vectorSize = 1;
+    for (int i = rank > 1 ? 1 : 0; i < rank; ++i) dataset.vectorSize *= extents[i];
+    dataset.data = map + headerStart + headerLength;
+    return NULL;
+}
+
+/*
+ * Keep the readahead window ahead of the cursor faulted in, and drop the pages behind it.
+ */
+static void prefetchLoop(Dataset *dataset)
+{
+    DatasetPrefetch *prefetch = dataset->prefetch;
+    size_t pageSize = (size_t) sysconf(_SC_PAGESIZE);
+    size_t faulted = 0, dropped = 0;
+    volatile char sink = 0;
+
+    std::unique_lock<std::mutex> lock(prefetch->mutex);
+    while (!prefetch->stop) {
+        size_t cursor = prefetch->cursor;
+        lock.unlock();
+
+        size_t end = std::min(cursor + DATASET_READAHEAD_BYTES, dataset->mapBytes);
+        if (end > faulted) {
+            size_t start = faulted / pageSize * pageSize;
+            madvise(dataset->map + start, end - start, MADV_WILLNEED);
+
+            // Touch every page so the reader never waits on a fault
+            for (size_t offset = start; offset < end; offset += pageSize) {
+                sink += dataset->map[offset];
+            }
+            faulted = end;
+        }
+
+        // Stay a window behind the cursor; wrapped vectors may still be in use by the device
+        size_t behind = cursor > DATASET_READAHEAD_BYTES
+                        ? (cursor - DATASET_READAHEAD_BYTES) / pageSize * pageSize : 0;
+        if (behind > dropped) {
+            madvise(dataset->map + dropped, behind - dropped, MADV_DONTNEED);
+            dropped = behind;
+        }
+
+        lock.lock();
+        while (!prefetch->stop && prefetch->cursor == cursor) prefetch->wake.wait(lock);
+    }
+}
+
+int openDataset(Dataset &dataset, const char *path, cl_uint elementType, cl_ulong vectorSize)
+{
+    dataset = Dataset();
+    dataset.fd = open(path, O_RDONLY);
+    if (dataset.fd < 0) {
+        LOGE("Cannot open dataset %s\n", path);
+        return 0;
+    }
+
+    struct stat info;
+    if (fstat(dataset.fd, &info) != 0 || info.st_size == 0) {
+        LOGE("Cannot read dataset %s\n", path);
+        close(dataset.fd);
+        dataset = Dataset();
+        return 0;
+    }
+    dataset.mapBytes = (size_t) info.st_size;
+
+    // Writable but private, so drivers wrapping vectors never fault on them or change the file
+    void *pointer = mmap(NULL, dataset.mapBytes, PROT_READ | PROT_WRITE, MAP_PRIVATE, dataset.fd, 0);
+    if (pointer == MAP_FAILED) {
+        LOGE("Cannot map %lu bytes of dataset %s\n", (unsigned long) dataset.mapBytes, path);
+        close(dataset.fd);
+        dataset = Dataset();
+        return 0;
+    }
+    dataset.map = (char *) pointer;
+    madvise(dataset.map, dataset.mapBytes, MADV_SEQUENTIAL);
+
+    const char *problem = NULL;
+    std::string name(path);
+    if (name.size() > 4 && name.compare(name.size() - 4, 4, ".npy") == 0) {
+        problem = parseNpy(dataset, dataset.map, dataset.mapBytes);
+    } else {
+        dataset.elementType = elementType;
+        dataset.vectorSize = vectorSize;
+        dataset.data = dataset.map;
+        if (elementBytes(elementType) == 0) problem = "unsupported element type";
+        else if (vectorSize == 0) problem = "no vector size";
+        else dataset.count = dataset.mapBytes / (vectorSize * elementBytes(elementType));
+    }
+
+    if (problem == NULL) {
+        dataset.vectorBytes = (size_t) (dataset.vectorSize * elementBytes(dataset.elementType));
+        size_t available = dataset.mapBytes - (dataset.data - dataset.map);
+        if (dataset.vectorBytes == 0 || dataset.count > available / dataset.vectorBytes) {
+            problem = "shorter than its shape";
+        }
+    }
+    if (problem != NULL) {
+        LOGE("Cannot read dataset %s: %s\n", path, problem);
+        closeDataset(dataset);
+        return 0;
+    }
+
+    dataset.prefetch = new DatasetPrefetch();
+    dataset.prefetch->cursor = dataset.data - dataset.map;
+    dataset.prefetch->stop = false;
+    dataset.prefetch->thread = std::thread(prefetchLoop, &dataset);
+
+    LOGD("Dataset %s: %llu vectors of %llu elements", path,
+         (unsigned long long) dataset.count, (unsigned long long) dataset.vectorSize);
+    return 1;
+}
+
+const float *nextDatasetVector(Dataset &dataset, float *scratch)
+{
+    if (dataset.next >= dataset.count) return NULL;
+
+    const char *vector = dataset.data + dataset.next * dataset.vectorBytes;
+    ++dataset.next;
+    {
+        std::lock_guard<std::mutex> lock(dataset.prefetch->mutex);
+        dataset.prefetch->cursor = vector - dataset.map;
+    }
+    dataset.prefetch->wake.notify_one();
+
+    switch (dataset.elementType) {
+        case ELEMENT_FLOAT32:
+            return (const float *) vector;
+        case ELEMENT_FLOAT16: {
+            const uint16_t *halves = (const uint16_t *) vector;
+            for (cl_ulong i = 0; i < dataset.vectorSize; ++i) scratch[i] = halfToFloat(halves[i]);
+            return scratch;
+        }
+        default: {
+            // Bytes are scaled to [0, 1] like the synthesized inputs
+            const uint8_t *bytes = (const uint8_t *) vector;
+            for (cl_ulong i = 0; i < dataset.vectorSize; ++i) scratch[i] = bytes[i] * (1.0f / 255.0f);
+            return scratch;
+        }
+    }
+}
+
+void closeDataset(Dataset &dataset)
+{
+    if (dataset.map == NULL) return;
+
+    if (dataset.prefetch != NULL) {
+        {
+            std::lock_guard<std::mutex> lock(dataset.prefetch->mutex);
+            dataset.prefetch->stop = true;
+        }
+        dataset.prefetch->wake.notify_one();
+        dataset.prefetch->thread.join();
+        delete dataset.prefetch;
+    }
+    munmap(dataset.map, dataset.mapBytes);
+    close(dataset.fd);
+    dataset = Dataset();
+}
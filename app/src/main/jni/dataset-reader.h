@@ -0,0 +1,73 @@
+/**
+ * dataset-reader.h
+ * @author Jonathan Dowdall
+ * @since 10-18-2026
+ */
+
+#ifndef UPDATEWEIGHTS_DATASET_READER_H
+#define UPDATEWEIGHTS_DATASET_READER_H
+
+#include "common.h"
+
+/** Bytes the prefetch thread keeps faulted in ahead of the next vector */
+#define DATASET_READAHEAD_BYTES (32 * 1024 * 1024)
+
+struct DatasetPrefetch;
+
+/** Sequence of input vectors memory-mapped from a binary file.
+ *
+ * The file is either raw, holding count vectors of vectorSize elements
+ * back to back, or a little-endian C-ordered .npy array whose first axis
+ * indexes the vectors. A prefetch thread faults in the pages ahead of the
+ * next vector and drops the ones already consumed, so a sequential pass
+ * reads the file at disk bandwidth without growing the page cache.
+ */
+struct Dataset
+{
+    /** Open dataset file */
+    int fd;
+
+    /** Private mapping of the whole file, NULL if none is open */
+    char *map;
+    size_t mapBytes;
+
+    /** First vector within map */
+    const char *data;
+
+    /** ElementType of the stored elements */
+    cl_uint elementType;
+
+    /** Number of elements per vector, and bytes per vector */
+    cl_ulong vectorSize;
+    size_t vectorBytes;
+
+    /** Number of vectors in the file */
+    cl_ulong count;
+
+    /** Index of the next vector to be read */
+    cl_ulong next;
+
+    /** Readahead thread and its state */
+    DatasetPrefetch *prefetch;
+};
+
+/*
+ * Map the dataset at path and start prefetching. A .npy file describes its own
+ * element type and shape; a raw file holds vectors of vectorSize elements of elementType.
+ * The prefetch thread refers to dataset, so it must not move until closed.
+ */
+int openDataset(Dataset &dataset, const char *path, cl_uint elementType, cl_ulong vectorSize);
+
+/*
+ * Address of the next vector as float32 and advance to the one after.
+ * Float32 vectors are returned in place; others are converted into scratch,
+ * which must hold vectorSize elements. NULL once every vector has been read.
+ */
+const float *nextDatasetVector(Dataset &dataset, float *scratch);
+
+/*
+ * Stop the prefetch thread, unmap and close the file.
+ */
+void closeDataset(Dataset &dataset);
+
+#endif // UPDATEWEIGHTS_DATASET_READER_H
@@ -0,0 +1,212 @@
+/**
+ * delta-stream.cpp
+ * @author Jonathan Dowdall
+ * @since 10-18-2026
+ */
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+
+#include <opencv2/core/hal/intrin.hpp>
+
+#include "delta-stream.h"
+#include "buffer-pool.h"
+#include "thread-pool.h"
+
+using namespace cv;
+
+/** Minimum elements per chunk of the host comparison */
+#define DELTA_GRAIN (1 << 16)
+
+/*
+ * Zero size bytes of buffer.
+ */
+static cl_int enqueueZero(cl_mem buffer, size_t size)
+{
+    const cl_uint zero = 0;
+    return clEnqueueFillBuffer
+            (
+                    cl.queue, // command_queue
+                    buffer, // buffer
+                    &zero, // *pattern
+                    sizeof(zero), // pattern_size
+                    0, // offset
+                    size, // size
+                    0, // num_events_in_wait_list
+                    NULL, // *event_wait_list
+                    NULL // *event
+            );
+}
+
+int openDeltaStream(DeltaStream &stream, cl_mem w, const float *host, cl_ulong size, bool initialized,
+                    float epsilon, cl_uint capacity)
+{
+    cl_int err = CL_SUCCESS;
+
+    closeDeltaStream(stream);
+    stream.epsilon = epsilon;
+    stream.capacity = capacity;
+
+    if (w == NULL) {
+        if (initialized) stream.publishedHost.assign(host, host + size);
+        else stream.publishedHost.assign((size_t) size, 0.0f);
+        stream.entries.resize(capacity);
+        stream.entryCount = 0;
+        stream.active = true;
+        return 1;
+    }
+
+    // The kernel records indices as uint
+    if (size > (cl_ulong) CL_UINT_MAX + 1) {
+        LOGE("Deltas of %llu elements on the device exceed 32-bit indices\n", (unsigned long long) size);
+        return 0;
+    }
+
+    stream.published = bufferPool.allocate(size * sizeof(float), CL_MEM_READ_WRITE, &err);
+    if (err == CL_SUCCESS) stream.indices = bufferPool.allocate(capacity * sizeof(cl_uint), CL_MEM_READ_WRITE, &err);
+    if (err == CL_SUCCESS) stream.values = bufferPool.allocate(capacity * sizeof(float), CL_MEM_READ_WRITE, &err);
+    if (err == CL_SUCCESS) stream.count = bufferPool.allocate(2 * sizeof(cl_uint), CL_MEM_READ_WRITE, &err);
+
+    if (err == CL_SUCCESS && initialized) {
+        err = clEnqueueCopyBuffer
+                (
+                        cl.queue, // command_queue
+                        w, // src_buffer
+                        stream.published, // dst_buffer
+                        0, // src_offset
+                        0, // dst_offset
+                        size * sizeof(float), // cb
+                        0, // num_events_in_wait_list
+                        NULL, // *event_wait_list
+                        NULL // *event
+                );
+    } else if (err == CL_SUCCESS) {
+        err = enqueueZero(stream.published, size * sizeof(float));
+    }
+    if (err == CL_SUCCESS) err = enqueueZero(stream.count, 2 * sizeof(cl_uint));
+
+    if (err != CL_SUCCESS) closeDeltaStream(stream);
+    SAMPLE_CHECK_ERRORS(err);
+    stream.active = true;
+    return 1;
+}
+
+void collectHostDeltas(DeltaStream &stream, const float *w, cl_ulong size)
+{
+    // Slots are taken in any order across chunks, as by the kernel
+    std::atomic<uint64_t> next(stream.entryCount);
+    float *published = stream.publishedHost.data();
+    float epsilon = stream.epsilon;
+    cl_ulong capacity = stream.capacity;
+    IndexedValue *entries = stream.entries.data();
+
+    auto append = [&](size_t i) {
+        cl_ulong slot = next.fetch_add(1);
+        if (slot >= capacity) return;
+        entries[slot].index = i;
+        entries[slot].value = w[i];
+        published[i] = w[i];
+    };
+
+    threadPool.parallelFor(0, (size_t) size, DELTA_GRAIN, [&](size_t begin, size_t end) {
+        v_float32x4 limit = v_setall_f32(epsilon);
+        size_t i = begin;
+        for (; i + 4 <= end; i += 4) {
+            // Most elements move less than epsilon and are skipped four at a time
+            int moved = v_signmask(v_abs(v_load(w + i) - v_load(published + i)) > limit);
+            for (int lane = 0; moved != 0; ++lane, moved >>= 1) {
+                if (moved & 1) append(i + lane);
+            }
+        }
+        for (; i < end; ++i) {
+            if (std::fabs(w[i] - published[i]) > epsilon) append(i);
+        }
+    })->wait();
+
+    stream.entryCount = next.load();
+}
+
+int pollDeltas(DeltaStream &stream, std::vector<IndexedValue> &out, bool &overflowed)
+{
+    cl_int err;
+
+    out.clear();
+    overflowed = false;
+    if (!stream.active) return 1;
+
+    if (stream.published == NULL) {
+        overflowed = stream.entryCount > stream.capacity;
+        out.assign(stream.entries.begin(),
+                   stream.entries.begin() + std::min<cl_ulong>(stream.entryCount, stream.capacity));
+        stream.entryCount = 0;
+    } else {
+        // Entry count, and whether any element found no slot
+        cl_uint deviceCount[2] = { 0, 0 };
+        err = clEnqueueReadBuffer
+                (
+                        cl.queue, // command_queue
+                        stream.count, // buffer
+                        true, // blocking_read
+                        0, // offset
+                        sizeof(deviceCount), // cb
+                        deviceCount, // *ptr
+                        0, // num_events_in_wait_list
+                        NULL, // *event_wait_list
+                        NULL // *event
+                );
+        SAMPLE_CHECK_ERRORS(err);
+        overflowed = deviceCount[1] != 0;
+
+        cl_uint stored = std::min(deviceCount[0], stream.capacity);
+        std::vector<uint32_t> indices(stored);
+        std::vector<float> values(stored);
+        if (stored > 0) {
+            err = clEnqueueReadBuffer
+                    (
+                            cl.queue, // command_queue
+                            stream.indices, // buffer
+                            false, // blocking_read
+                            0, // offset
+                            stored * sizeof(cl_uint), // cb
+                            indices.data(), // *ptr
+                            0, // num_events_in_wait_list
+                            NULL, // *event_wait_list
+                            NULL // *event
+                    );
+            err |= clEnqueueReadBuffer
+                    (
+                            cl.queue, // command_queue
+                            stream.values, // buffer
+                            false, // blocking_read
+                            0, // offset
+                            stored * sizeof(float), // cb
+                            values.data(), // *ptr
+                            0, // num_events_in_wait_list
+                            NULL, // *event_wait_list
+                            NULL // *event
+                    );
+        }
+        err |= enqueueZero(stream.count, sizeof(deviceCount));
+        clFinish(cl.queue);
+        SAMPLE_CHECK_ERRORS(err);
+
+        out.resize(stored);
+        for (cl_uint j = 0; j < stored; ++j) {
+            out[j].index = indices[j];
+            out[j].value = values[j];
+        }
+    }
+
+    if (overflowed) LOGD("Changed elements did not fit in %u entries and will be reported later", stream.capacity);
+    return 1;
+}
+
+void closeDeltaStream(DeltaStream &stream)
+{
+    bufferPool.release(stream.published);
+    bufferPool.release(stream.indices);
+    bufferPool.release(stream.values);
+    bufferPool.release(stream.count);
+    stream = DeltaStream();
+}
@@ -0,0 +1,66 @@
+/**
+ * delta-stream.h
+ * @author Jonathan Dowdall
+ * @since 10-18-2026
+ */
+
+#ifndef UPDATEWEIGHTS_DELTA_STREAM_H
+#define UPDATEWEIGHTS_DELTA_STREAM_H
+
+#include <vector>
+
+#include "common.h"
+
+/** Elements of W whose average moved more than epsilon since it was last published.
+ *
+ * Every element has a published value, the last one handed to the subscriber.
+ * Steps append (index, value) for each element that moved too far from it, up
+ * to capacity entries between two polls. An element that does not fit keeps its
+ * old published value and is appended again once there is room, so nothing is lost.
+ *
+ * Resident W is compared by the UpdateWeightsDelta kernel as part of each step.
+ * W updated on the host is compared by collectHostDeltas after each step.
+ */
+struct DeltaStream
+{
+    bool active;
+    float epsilon;
+    cl_uint capacity;
+
+    /** Device published values, entries and entry count, for resident W */
+    cl_mem published;
+    cl_mem indices;
+    cl_mem values;
+    cl_mem count;
+
+    /** Host published values and entries, for W updated on the host */
+    std::vector<float> publishedHost;
+    std::vector<IndexedValue> entries;
+    cl_ulong entryCount;
+};
+
+/*
+ * Start a stream over the size elements of W, in w on the device or host on the host.
+ * Every element starts out published at its current value, or at 0 if W has seen no input yet.
+ */
+int openDeltaStream(DeltaStream &stream, cl_mem w, const float *host, cl_ulong size, bool initialized,
+                    float epsilon, cl_uint capacity);
+
+/*
+ * Compare W on the host against the published values after a step.
+ */
+void collectHostDeltas(DeltaStream &stream, const float *w, cl_ulong size);
+
+/*
+ * Move the entries appended since the last poll to out and start over. overflowed is set if
+ * elements did not fit; they stay unpublished until a step after a poll has made room.
+ * Returns 0 on failure.
+ */
+int pollDeltas(DeltaStream &stream, std::vector<IndexedValue> &out, bool &overflowed);
+
+/*
+ * Release the stream's buffers.
+ */
+void closeDeltaStream(DeltaStream &stream);
+
+#endif // UPDATEWEIGHTS_DELTA_STREAM_H
@@ -0,0 +1,191 @@
+/**
+ * device-read.cpp
+ * @author Jonathan Dowdall
+ * @since 10-18-2026
+ */
+
+#include <vector>
+
+#include "device-read.h"
+#include "buffer-pool.h"
+#include "half-float.h"
+
+/*
+ * Read count elements of elementSize bytes starting at begin.
+ */
+static int readElements(cl_mem buffer, cl_ulong begin, cl_ulong count, size_t elementSize, void *out)
+{
+    if (count == 0) return 1;
+
+    cl_int err = clEnqueueReadBuffer
+            (
+                    cl.queue, // command_queue
+                    buffer, // buffer
+                    true, // blocking_read
+                    begin * elementSize, // offset
+                    count * elementSize, // cb
+                    out, // *ptr
+                    0, // num_events_in_wait_list
+                    NULL, // *event_wait_list
+                    NULL // *event
+            );
+    SAMPLE_CHECK_ERRORS(err);
+    return 1;
+}
+
+int readRange(cl_mem buffer, cl_ulong begin, cl_ulong count, float *out)
+{
+    return readElements(buffer, begin, count, sizeof(float), out);
+}
+
+int readHalfRange(cl_mem buffer, cl_ulong begin, cl_ulong count, float *out)
+{
+    std::vector<uint16_t> halves((size_t) count);
+    if (!readElements(buffer, begin, count, sizeof(uint16_t), halves.data())) return 0;
+    halvesToFloats(halves.data(), out, (size_t) count);
+    return 1;
+}
+
+/*
+ * Read count blocks of width elements of elementSize bytes, stride elements apart.
+ */
+static int readBlocks(cl_mem buffer, cl_ulong begin, cl_ulong width, cl_ulong stride, cl_ulong count,
+                      size_t elementSize, void *out)
+{
+    if (count == 0 || width == 0) return 1;
+    if (width > stride) {
+        LOGE("Blocks of %llu elements overlap at a stride of %llu\n",
+             (unsigned long long) width, (unsigned long long) stride);
+        return 0;
+    }
+
+    // Rows of stride elements in the buffer, packed rows of width elements on the host
+    size_t bufferOrigin[3] = { (size_t) (begin % stride) * elementSize, (size_t) (begin / stride), 0 };
+    size_t hostOrigin[3] = { 0, 0, 0 };
+    size_t region[3] = { (size_t) width * elementSize, (size_t) count, 1 };
+
+    cl_int err = clEnqueueReadBufferRect
+            (
+                    cl.queue, // command_queue
+                    buffer, // buffer
+                    true, // blocking_read
+                    bufferOrigin, // *buffer_offset
+                    hostOrigin, // *host_offset
+                    region, // *region
+                    (size_t) stride * elementSize, // buffer_row_pitch
+                    0, // buffer_slice_pitch
+                    (size_t) width * elementSize, // host_row_pitch
+                    0, // host_slice_pitch
+                    out, // *ptr
+                    0, // num_events_in_wait_list
+                    NULL, // *event_wait_list
+                    NULL // *event
+            );
+    SAMPLE_CHECK_ERRORS(err);
+    return 1;
+}
+
+int readStrided(cl_mem buffer, cl_ulong begin, cl_ulong width, cl_ulong stride, cl_ulong count, float *out)
+{
+    return readBlocks(buffer, begin, width, stride, count, sizeof(float), out);
+}
+
+int readHalfStrided(cl_mem buffer, cl_ulong begin, cl_ulong width, cl_ulong stride, cl_ulong count, float *out)
+{
+    std::vector<uint16_t> halves((size_t) (width * count));
+    if (!readBlocks(buffer, begin, width, stride, count, sizeof(uint16_t), halves.data())) return 0;
+    halvesToFloats(halves.data(), out, halves.size());
+    return 1;
+}
+
+/*
+ * Gather the elements at count indices with kernel, which widens them to floats if need be.
+ */
+static int gather(cl_kernel kernel, cl_mem buffer, const uint64_t *indices, size_t count, float *out)
+{
+    cl_int err;
+    if (count == 0) return 1;
+    if (count > CL_UINT_MAX) {
+        LOGE("Cannot gather %llu elements\n", (unsigned long long) count);
+        return 0;
+    }
+
+    // One allocation can hold more elements than the kernel's uint indices reach on 64-bit devices
+    std::vector<uint32_t> deviceIndices(count);
+    for (size_t j = 0; j < count; ++j) {
+        if (indices[j] > CL_UINT_MAX) {
+            LOGE("Cannot gather element %llu with 32-bit indices\n", (unsigned long long) indices[j]);
+            return 0;
+        }
+        deviceIndices[j] = (uint32_t) indices[j];
+    }
+    cl_uint gatherCount = (cl_uint) count;
+
+    cl_mem indexBuffer = bufferPool.allocate(count * sizeof(uint32_t), CL_MEM_READ_ONLY, &err);
+    SAMPLE_CHECK_ERRORS(err);
+    cl_mem staging = bufferPool.allocate(count * sizeof(float), CL_MEM_WRITE_ONLY, &err);
+    if (err != CL_SUCCESS) bufferPool.release(indexBuffer);
+    SAMPLE_CHECK_ERRORS(err);
+
+    err = clEnqueueWriteBuffer
+            (
+                    cl.queue, // command_queue
+                    indexBuffer, // buffer
+                    false, // blocking_write
+                    0, // offset
+                    count * sizeof(uint32_t), // cb
+                    deviceIndices.data(), // *ptr
+                    0, // num_events_in_wait_list
+                    NULL, // *event_wait_list
+                    NULL // *event
+            );
+
+    err |= clSetKernelArg(kernel, 0, sizeof(cl_mem), &buffer);
+    err |= clSetKernelArg(kernel, 1, sizeof(cl_mem), &indexBuffer);
+    err |= clSetKernelArg(kernel, 2, sizeof(cl_uint), &gatherCount);
+    err |= clSetKernelArg(kernel, 3, sizeof(cl_mem), &staging);
+
+    size_t globalSize = count;
+    if (err == CL_SUCCESS) err = clEnqueueNDRangeKernel
+            (
+                    cl.queue, // command_queue
+                    kernel, // kernel
+                    1, // work_dim
+                    NULL, // *global_work_offset
+                    &globalSize, // *global_work_size
+                    NULL, // *local_work_size
+                    0, // num_events_in_wait_list
+                    NULL, // *event_wait_list
+                    NULL // *event
+            );
+
+    // The blocking read also means the index upload has finished with deviceIndices
+    if (err == CL_SUCCESS) err = clEnqueueReadBuffer
+            (
+                    cl.queue, // command_queue
+                    staging, // buffer
+                    true, // blocking_read
+                    0, // offset
+                    count * sizeof(float), // cb
+                    out, // *ptr
+                    0, // num_events_in_wait_list
+                    NULL, // *event_wait_list
+                    NULL // *event
+            );
+
+    if (err != CL_SUCCESS) clFinish(cl.queue);
+    bufferPool.release(indexBuffer);
+    bufferPool.release(staging);
+    SAMPLE_CHECK_ERRORS(err);
+    return 1;
+}
+
+int readGather(cl_mem buffer, const uint64_t *indices, size_t count, float *out)
+{
+    return gather(cl.gatherW, buffer, indices, count, out);
+}
+
+int readHalfGather(cl_mem buffer, const uint64_t *indices, size_t count, float *out)
+{
+    return gather(cl.gatherHalfW, buffer, indices, count, out);
+}
@@ -0,0 +1,47 @@
+/**
+ * device-read.h
+ * @author Jonathan Dowdall
+ * @since 10-18-2026
+ */
+
+#ifndef UPDATEWEIGHTS_DEVICE_READ_H
+#define UPDATEWEIGHTS_DEVICE_READ_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "common.h"
+
+/*
+ * Partial reads of a float buffer. Each moves only the requested elements,
+ * however large the buffer, and blocks until they are in out.
+ */
+
+/*
+ * Read the count elements starting at begin.
+ */
+int readRange(cl_mem buffer, cl_ulong begin, cl_ulong count, float *out);
+
+/*
+ * Read count blocks of width elements, the first starting at begin and each
+ * following one stride elements after the previous.
+ */
+int readStrided(cl_mem buffer, cl_ulong begin, cl_ulong width, cl_ulong stride, cl_ulong count, float *out);
+
+/*
+ * Read the elements at count arbitrary indices, gathered on the device into a compact buffer.
+ * Indices have to fit 32 bits.
+ */
+int readGather(cl_mem buffer, const uint64_t *indices, size_t count, float *out);
+
+/*
+ * The same reads of a buffer of halves, widened to floats on the host.
+ * Only half the bytes cross from the device.
+ */
+int readHalfRange(cl_mem buffer, cl_ulong begin, cl_ulong count, float *out);
+
+int readHalfStrided(cl_mem buffer, cl_ulong begin, cl_ulong width, cl_ulong stride, cl_ulong count, float *out);
+
+int readHalfGather(cl_mem buffer, const uint64_t *indices, size_t count, float *out);
+
+#endif // UPDATEWEIGHTS_DEVICE_READ_H
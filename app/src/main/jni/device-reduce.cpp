@@ -0,0 +1,226 @@
+/**
+ * device-reduce.cpp
+ * @author Jonathan Dowdall
+ * @since 10-18-2026
+ */
+
+#include <algorithm>
+#include <vector>
+
+#include "device-reduce.h"
+#include "buffer-pool.h"
+
+/** Upper bound on the work-group size of the reductions */
+#define REDUCE_MAX_GROUP_SIZE 256
+
+size_t groupSize(const cl_kernel *kernels, int count, size_t localBytes)
+{
+    size_t limit = REDUCE_MAX_GROUP_SIZE;
+    limit = std::min<size_t>(limit, gpu.localMem / localBytes);
+
+    for (int i = 0; i < count; ++i) {
+        size_t kernelMax;
+        cl_int err = clGetKernelWorkGroupInfo
+                (
+                        kernels[i],
+                        cl.device,
+                        CL_KERNEL_WORK_GROUP_SIZE,
+                        sizeof(kernelMax),
+                        &kernelMax,
+                        NULL
+                );
+        if (err == CL_SUCCESS) limit = std::min(limit, kernelMax);
+    }
+
+    size_t size = 1;
+    while (size * 2 <= limit) size *= 2;
+    return size;
+}
+
+int deviceStats(cl_mem x, cl_mem ref, cl_ulong n, ArrayStats &stats)
+{
+    cl_int err;
+
+    stats = ArrayStats();
+    if (n == 0) return 1;
+    if (n > CL_UINT_MAX) {
+        LOGE("Cannot reduce %llu elements on the device\n", (unsigned long long) n);
+        return 0;
+    }
+
+    // A few groups per compute unit; every work-item strides through its share of the rest
+    cl_kernel kernels[2] = { cl.reduceStats, cl.reduceStatsFinal };
+    size_t local = groupSize(kernels, 2, STAT_COUNT * sizeof(float));
+    size_t groups = (size_t) std::min<cl_ulong>((n + local - 1) / local, (cl_ulong) gpu.computeUnits * 8);
+    cl_uint count = (cl_uint) n;
+    cl_uint groupCount = (cl_uint) groups;
+
+    cl_mem partials = bufferPool.allocate(STAT_COUNT * groups * sizeof(float), CL_MEM_READ_WRITE, &err);
+    SAMPLE_CHECK_ERRORS(err);
+    cl_mem result = bufferPool.allocate(STAT_COUNT * sizeof(float), CL_MEM_READ_WRITE, &err);
+    if (err != CL_SUCCESS) bufferPool.release(partials);
+    SAMPLE_CHECK_ERRORS(err);
+
+    err = clSetKernelArg(cl.reduceStats, 0, sizeof(cl_mem), &x);
+    err |= clSetKernelArg(cl.reduceStats, 1, sizeof(cl_mem), ref != NULL ? &ref : NULL);
+    err |= clSetKernelArg(cl.reduceStats, 2, sizeof(cl_uint), &count);
+    err |= clSetKernelArg(cl.reduceStats, 3, sizeof(cl_mem), &partials);
+    err |= clSetKernelArg(cl.reduceStats, 4, STAT_COUNT * local * sizeof(float), NULL);
+    err |= clSetKernelArg(cl.reduceStatsFinal, 0, sizeof(cl_mem), &partials);
+    err |= clSetKernelArg(cl.reduceStatsFinal, 1, sizeof(cl_uint), &groupCount);
+    err |= clSetKernelArg(cl.reduceStatsFinal, 2, sizeof(cl_mem), &result);
+    err |= clSetKernelArg(cl.reduceStatsFinal, 3, STAT_COUNT * local * sizeof(float), NULL);
+
+    size_t globalSize = groups * local;
+    if (err == CL_SUCCESS) err = clEnqueueNDRangeKernel
+            (
+                    cl.queue, // command_queue
+                    cl.reduceStats, // kernel
+                    1, // work_dim
+                    NULL, // *global_work_offset
+                    &globalSize, // *global_work_size
+                    &local, // *local_work_size
+                    0, // num_events_in_wait_list
+                    NULL, // *event_wait_list
+                    NULL // *event
+            );
+    if (err == CL_SUCCESS) err = clEnqueueNDRangeKernel
+            (
+                    cl.queue, // command_queue
+                    cl.reduceStatsFinal, // kernel
+                    1, // work_dim
+                    NULL, // *global_work_offset
+                    &local, // *global_work_size
+                    &local, // *local_work_size
+                    0, // num_events_in_wait_list
+                    NULL, // *event_wait_list
+                    NULL // *event
+            );
+
+    float values[STAT_COUNT];
+    if (err == CL_SUCCESS) err = clEnqueueReadBuffer
+            (
+                    cl.queue, // command_queue
+                    result, // buffer
+                    true, // blocking_read
+                    0, // offset
+                    sizeof(values), // cb
+                    values, // *ptr
+                    0, // num_events_in_wait_list
+                    NULL, // *event_wait_list
+                    NULL // *event
+            );
+
+    // The in-order queue is done with both buffers once the read has completed
+    if (err != CL_SUCCESS) clFinish(cl.queue);
+    bufferPool.release(partials);
+    bufferPool.release(result);
+    SAMPLE_CHECK_ERRORS(err);
+
+    stats.sum = values[STAT_SUM];
+    stats.sumSquares = values[STAT_SUM_SQUARES];
+    stats.min = values[STAT_MIN];
+    stats.max = values[STAT_MAX];
+    stats.differenceSquares = values[STAT_DIFFERENCE_SQUARES];
+    stats.maxDifference = values[STAT_MAX_DIFFERENCE];
+    return 1;
+}
+
+int deviceTopK(cl_mem x, cl_ulong n, cl_uint k, bool smallest, std::vector<IndexedValue> &top)
+{
+    cl_int err;
+
+    top.clear();
+    if (n == 0 || k == 0) return 1;
+    if (k > TOPK_MAX_K || n >= CL_UINT_MAX) {
+        LOGE("Cannot select %u of %llu elements on the device\n", k, (unsigned long long) n);
+        return 0;
+    }
+
+    // Every group leaves k candidates; a single group then merges them
+    size_t local = groupSize(&cl.topK, 1, sizeof(float) + 2 * sizeof(cl_uint));
+    size_t groups = (size_t) std::min<cl_ulong>((n + local - 1) / local, (cl_ulong) gpu.computeUnits * 4);
+    cl_uint count = (cl_uint) n;
+    cl_uint candidates = (cl_uint) (groups * k);
+    cl_int select = smallest ? 1 : 0;
+
+    cl_mem partialValues = bufferPool.allocate(candidates * sizeof(float), CL_MEM_READ_WRITE, &err);
+    SAMPLE_CHECK_ERRORS(err);
+    cl_mem partialIndices = bufferPool.allocate(candidates * sizeof(cl_uint), CL_MEM_READ_WRITE, &err);
+    cl_mem topValues = err == CL_SUCCESS ? bufferPool.allocate(k * sizeof(float), CL_MEM_WRITE_ONLY, &err) : NULL;
+    cl_mem topIndices = err == CL_SUCCESS ? bufferPool.allocate(k * sizeof(cl_uint), CL_MEM_WRITE_ONLY, &err) : NULL;
+
+    // The first stage reads x itself, the second the candidates and their indices
+    cl_mem stageValues[2] = { x, partialValues };
+    cl_mem stageIndices[2] = { NULL, partialIndices };
+    cl_uint stageCount[2] = { count, candidates };
+    cl_mem outValues[2] = { partialValues, topValues };
+    cl_mem outIndices[2] = { partialIndices, topIndices };
+    size_t globalSize[2] = { groups * local, local };
+
+    for (int stage = 0; stage < 2 && err == CL_SUCCESS; ++stage) {
+        err = clSetKernelArg(cl.topK, 0, sizeof(cl_mem), &stageValues[stage]);
+        err |= clSetKernelArg(cl.topK, 1, sizeof(cl_mem), stage == 0 ? NULL : &stageIndices[stage]);
+        err |= clSetKernelArg(cl.topK, 2, sizeof(cl_uint), &stageCount[stage]);
+        err |= clSetKernelArg(cl.topK, 3, sizeof(cl_uint), &k);
+        err |= clSetKernelArg(cl.topK, 4, sizeof(cl_int), &select);
+        err |= clSetKernelArg(cl.topK, 5, sizeof(cl_mem), &outValues[stage]);
+        err |= clSetKernelArg(cl.topK, 6, sizeof(cl_mem), &outIndices[stage]);
+        err |= clSetKernelArg(cl.topK, 7, local * sizeof(float), NULL);
+        err |= clSetKernelArg(cl.topK, 8, local * sizeof(cl_uint), NULL);
+        err |= clSetKernelArg(cl.topK, 9, local * sizeof(cl_uint), NULL);
+        if (err == CL_SUCCESS) err = clEnqueueNDRangeKernel
+                (
+                        cl.queue, // command_queue
+                        cl.topK, // kernel
+                        1, // work_dim
+                        NULL, // *global_work_offset
+                        &globalSize[stage], // *global_work_size
+                        &local, // *local_work_size
+                        0, // num_events_in_wait_list
+                        NULL, // *event_wait_list
+                        NULL // *event
+                );
+    }
+
+    std::vector<float> values(k);
+    std::vector<uint32_t> indices(k);
+    if (err == CL_SUCCESS) err = clEnqueueReadBuffer
+            (
+                    cl.queue, // command_queue
+                    topValues, // buffer
+                    false, // blocking_read
+                    0, // offset
+                    k * sizeof(float), // cb
+                    values.data(), // *ptr
+                    0, // num_events_in_wait_list
+                    NULL, // *event_wait_list
+                    NULL // *event
+            );
+    if (err == CL_SUCCESS) err = clEnqueueReadBuffer
+            (
+                    cl.queue, // command_queue
+                    topIndices, // buffer
+                    true, // blocking_read
+                    0, // offset
+                    k * sizeof(cl_uint), // cb
+                    indices.data(), // *ptr
+                    0, // num_events_in_wait_list
+                    NULL, // *event_wait_list
+                    NULL // *event
+            );
+
+    if (err != CL_SUCCESS) clFinish(cl.queue);
+    bufferPool.release(partialValues);
+    bufferPool.release(partialIndices);
+    bufferPool.release(topValues);
+    bufferPool.release(topIndices);
+    SAMPLE_CHECK_ERRORS(err);
+
+    // Slots left empty when W has fewer than k elements come last
+    for (cl_uint r = 0; r < k && indices[r] != TOPK_NONE; ++r) {
+        IndexedValue entry = { indices[r], values[r] };
+        top.push_back(entry);
+    }
+    return 1;
+}
@@ -0,0 +1,48 @@
+/**
+ * device-reduce.h
+ * @author Jonathan Dowdall
+ * @since 10-18-2026
+ */
+
+#ifndef UPDATEWEIGHTS_DEVICE_REDUCE_H
+#define UPDATEWEIGHTS_DEVICE_REDUCE_H
+
+#include <vector>
+
+#include "common.h"
+
+/** Statistics computed by the ReduceStats kernels. Indices match STAT_* in the kernel source. */
+enum ReduceStat
+{
+    STAT_SUM = 0,
+    STAT_SUM_SQUARES = 1,
+    STAT_MIN = 2,
+    STAT_MAX = 3,
+    STAT_DIFFERENCE_SQUARES = 4,
+    STAT_MAX_DIFFERENCE = 5,
+    STAT_COUNT = 6,
+};
+
+/*
+ * Largest power of two work-group size every one of the kernels can run with
+ * and whose localBytes per work-item fit in local memory.
+ */
+size_t groupSize(const cl_kernel *kernels, int count, size_t localBytes);
+
+/*
+ * Reduce n elements of x, and their difference to ref unless it is NULL, on the device.
+ * Only the STAT_COUNT results are read back.
+ */
+int deviceStats(cl_mem x, cl_mem ref, cl_ulong n, ArrayStats &stats);
+
+/** Largest k deviceTopK selects, and the index of empty candidates. Match the kernel source. */
+#define TOPK_MAX_K 32
+#define TOPK_NONE 0xffffffffu
+
+/*
+ * Select the k largest elements of x, or the k smallest, on the device, best first.
+ * Only the k (index, value) pairs are read back; fewer if x has fewer than k elements.
+ */
+int deviceTopK(cl_mem x, cl_ulong n, cl_uint k, bool smallest, std::vector<IndexedValue> &top);
+
+#endif // UPDATEWEIGHTS_DEVICE_REDUCE_H
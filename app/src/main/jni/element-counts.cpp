@@ -0,0 +1,105 @@
+/**
+ * element-counts.cpp
+ * @author Jonathan Dowdall
+ * @since 10-18-2026
+ */
+
+#include <algorithm>
+
+#include "element-counts.h"
+#include "buffer-pool.h"
+
+/** Minimum elements per chunk of the host update */
+#define COUNTED_GRAIN (1 << 16)
+
+/*
+ * Fill size bytes of buffer with a float.
+ */
+static cl_int enqueueFill(cl_mem buffer, float value, size_t size)
+{
+    return clEnqueueFillBuffer
+            (
+                    cl.queue, // command_queue
+                    buffer, // buffer
+                    &value, // *pattern
+                    sizeof(value), // pattern_size
+                    0, // offset
+                    size, // size
+                    0, // num_events_in_wait_list
+                    NULL, // *event_wait_list
+                    NULL // *event
+            );
+}
+
+int openElementCounts(ElementCounts &counts, cl_mem w, float *host, cl_ulong size, float initial, bool zero)
+{
+    cl_int err = CL_SUCCESS;
+
+    closeElementCounts(counts);
+    if (w == NULL) {
+        counts.hostCounts.assign((size_t) size, initial);
+        if (zero) std::fill(host, host + size, 0.0f);
+        return 1;
+    }
+
+    counts.counts = bufferPool.allocate(size * sizeof(float), CL_MEM_READ_WRITE, &err);
+    SAMPLE_CHECK_ERRORS(err);
+    err = enqueueFill(counts.counts, initial, size * sizeof(float));
+    if (err == CL_SUCCESS && zero) err = enqueueFill(w, 0.0f, size * sizeof(float));
+    if (err != CL_SUCCESS) closeElementCounts(counts);
+    SAMPLE_CHECK_ERRORS(err);
+    return 1;
+}
+
+cl_int enqueueCountedUpdate(ElementCounts &counts, cl_mem w, cl_mem dirty, cl_mem indices, cl_mem values,
+                            cl_ulong count, float weight)
+{
+    cl_uint elements = (cl_uint) count;
+
+    cl_int err = clSetKernelArg(cl.updateCounted, 0, sizeof(cl_mem), &w);
+    err |= clSetKernelArg(cl.updateCounted, 1, sizeof(cl_mem), &counts.counts);
+    err |= clSetKernelArg(cl.updateCounted, 2, sizeof(cl_mem), dirty != NULL ? &dirty : NULL);
+    err |= clSetKernelArg(cl.updateCounted, 3, sizeof(cl_mem), indices != NULL ? &indices : NULL);
+    err |= clSetKernelArg(cl.updateCounted, 4, sizeof(cl_mem), &values);
+    err |= clSetKernelArg(cl.updateCounted, 5, sizeof(cl_uint), &elements);
+    err |= clSetKernelArg(cl.updateCounted, 6, sizeof(float), &weight);
+
+    size_t globalDimensions[3] = {(size_t) count, 1, 1};
+    if (err == CL_SUCCESS && count > 0) err = clEnqueueNDRangeKernel
+            (
+                    cl.queue, // command_queue
+                    cl.updateCounted, // kernel
+                    3, // work_dim
+                    NULL, // *global_work_offset
+                    globalDimensions, // *global_work_size
+                    NULL, // *local_work_size
+                    0, // num_events_in_wait_list
+                    NULL, // *event_wait_list
+                    NULL // *event
+            );
+    return err;
+}
+
+std::shared_ptr<ThreadPool::Job> updateHostCounted(ElementCounts &counts, float *w, const uint64_t *indices,
+                                                   const float *values, cl_ulong count, float weight)
+{
+    float *totals = counts.hostCounts.data();
+
+    return threadPool.parallelFor(0, (size_t) count, COUNTED_GRAIN, [=](size_t begin, size_t end) {
+        for (size_t j = begin; j < end; ++j) {
+            size_t i = indices != NULL ? (size_t) indices[j] : j;
+            float before = totals[i];
+            float total = before + weight;
+            totals[i] = total;
+            w[i] = before == 0 ? values[j] : w[i] + (weight / total) * (values[j] - w[i]);
+        }
+    });
+}
+
+void closeElementCounts(ElementCounts &counts)
+{
+    bufferPool.release(counts.counts);
+    counts.counts = NULL;
+    counts.hostCounts.clear();
+    counts.hostCounts.shrink_to_fit();
+}
@@ -0,0 +1,55 @@
+/**
+ * element-counts.h
+ * @author Jonathan Dowdall
+ * @since 10-18-2026
+ */
+
+#ifndef UPDATEWEIGHTS_ELEMENT_COUNTS_H
+#define UPDATEWEIGHTS_ELEMENT_COUNTS_H
+
+#include <stdint.h>
+#include <memory>
+#include <vector>
+
+#include "common.h"
+#include "thread-pool.h"
+
+/** Weight each element of W has received, for a mean kept per element.
+ *
+ * Sparse and masked inputs give values to some elements only. Each element
+ * averages the inputs it was actually given, weighted by its own running total
+ * rather than by the weight of all steps, so a step touches only its elements.
+ */
+struct ElementCounts
+{
+    /** Totals on the device for resident W, or on the host */
+    cl_mem counts;
+    std::vector<float> hostCounts;
+};
+
+/*
+ * Start the size elements of W with a total of initial each, on the device or the host.
+ * W, w on the device or host on the host, is zeroed first if zero is set.
+ */
+int openElementCounts(ElementCounts &counts, cl_mem w, float *host, cl_ulong size, float initial, bool zero);
+
+/*
+ * Queue averaging count inputs of the given weight into device W: values at indices,
+ * or a dense input when indices is NULL.
+ */
+cl_int enqueueCountedUpdate(ElementCounts &counts, cl_mem w, cl_mem dirty, cl_mem indices, cl_mem values,
+                            cl_ulong count, float weight);
+
+/*
+ * Average count inputs of the given weight into host W on the thread pool: values at indices,
+ * or a dense input when indices is NULL.
+ */
+std::shared_ptr<ThreadPool::Job> updateHostCounted(ElementCounts &counts, float *w, const uint64_t *indices,
+                                                   const float *values, cl_ulong count, float weight);
+
+/*
+ * Release the totals.
+ */
+void closeElementCounts(ElementCounts &counts);
+
+#endif // UPDATEWEIGHTS_ELEMENT_COUNTS_H
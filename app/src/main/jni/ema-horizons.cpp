@@ -0,0 +1,188 @@
+/**
+ * ema-horizons.cpp
+ * @author Jonathan Dowdall
+ * @since 10-18-2026
+ */
+
+#include <algorithm>
+#include <cmath>
+
+#include <opencv2/core/hal/intrin.hpp>
+
+#include "ema-horizons.h"
+#include "buffer-pool.h"
+
+using namespace cv;
+
+/** Minimum elements per chunk of the host blend */
+#define EMA_GRAIN (1 << 16)
+
+float emaShare(float alpha, float weight, unsigned int t)
+{
+    if (t <= 1) return 1.0f;
+
+    // An input of weight w counts as w inputs of weight 1
+    return (float) (1.0 - std::pow(1.0 - (double) alpha, (double) weight));
+}
+
+int openHorizons(EmaHorizons &horizons, cl_mem w, const float *host, cl_ulong size, bool initialized,
+                 bool onDevice)
+{
+    cl_int err = CL_SUCCESS;
+
+    closeHorizons(horizons);
+    cl_uint extra = horizons.alphas.empty() ? 0 : (cl_uint) horizons.alphas.size() - 1;
+    if (extra == 0 || size == 0) return 1;
+
+    horizons.extra = extra;
+    if (!onDevice) {
+        horizons.host.assign((size_t) (size * horizons.extra), 0.0f);
+        if (initialized) {
+            for (cl_ulong i = 0; i < size; ++i) {
+                std::fill_n(&horizons.host[i * horizons.extra], horizons.extra, host[i]);
+            }
+        }
+        return 1;
+    }
+
+    horizons.buffer = bufferPool.allocate(size * horizons.extra * sizeof(float), CL_MEM_READ_WRITE, &err);
+    SAMPLE_CHECK_ERRORS(err);
+
+    if (initialized) {
+        // Taking all of W as the input copies it into every horizon
+        std::vector<float> shares(horizons.extra, 1.0f);
+        err = enqueueEmaUpdate(horizons, NULL, w, 1.0f, NULL, shares.data(), size);
+    } else {
+        const float zero = 0.0f;
+        err = clEnqueueFillBuffer
+                (
+                        cl.queue, // command_queue
+                        horizons.buffer, // buffer
+                        &zero, // *pattern
+                        sizeof(zero), // pattern_size
+                        0, // offset
+                        size * horizons.extra * sizeof(float), // size
+                        0, // num_events_in_wait_list
+                        NULL, // *event_wait_list
+                        NULL // *event
+                );
+    }
+    if (err != CL_SUCCESS) closeHorizons(horizons);
+    SAMPLE_CHECK_ERRORS(err);
+    return 1;
+}
+
+cl_int enqueueEmaUpdate(EmaHorizons &horizons, cl_mem w, cl_mem input, float alpha, cl_mem dirty,
+                        const float *shares, cl_ulong size)
+{
+    cl_float8 alphas = {};
+    std::copy(shares, shares + horizons.extra, alphas.s);
+
+    cl_int err = clSetKernelArg(cl.updateWeightsEma, 0, sizeof(cl_mem), w != NULL ? &w : NULL);
+    err |= clSetKernelArg(cl.updateWeightsEma, 1, sizeof(cl_mem), &input);
+    err |= clSetKernelArg(cl.updateWeightsEma, 2, sizeof(float), &alpha);
+    err |= clSetKernelArg(cl.updateWeightsEma, 3, sizeof(cl_mem), dirty != NULL ? &dirty : NULL);
+    err |= clSetKernelArg(cl.updateWeightsEma, 4, sizeof(cl_mem), &horizons.buffer);
+    err |= clSetKernelArg(cl.updateWeightsEma, 5, sizeof(cl_float8), &alphas);
+    err |= clSetKernelArg(cl.updateWeightsEma, 6, sizeof(cl_uint), &horizons.extra);
+
+    size_t globalDimensions[3] = {(size_t) size, 1, 1};
+    if (err == CL_SUCCESS) err = clEnqueueNDRangeKernel
+            (
+                    cl.queue, // command_queue
+                    cl.updateWeightsEma, // kernel
+                    3, // work_dim
+                    NULL, // *global_work_offset
+                    globalDimensions, // *global_work_size
+                    NULL, // *local_work_size
+                    0, // num_events_in_wait_list
+                    NULL, // *event_wait_list
+                    NULL // *event
+            );
+    return err;
+}
+
+/*
+ * Blend input elements [begin, end) into their horizons. The shares repeat every extra values
+ * and vectors every 4, so they are laid out once over both and vectors start where they line up.
+ */
+static void blendChunk(const float *input, float *horizons, const float *shares, cl_uint extra,
+                       size_t begin, size_t end)
+{
+    // Least common multiple of extra and 4
+    size_t span = extra % 4 == 0 ? extra : extra % 2 == 0 ? extra * 2 : extra * 4;
+    float pattern[4 * EMA_MAX_HORIZONS];
+    for (size_t j = 0; j < span; ++j) pattern[j] = shares[j % extra];
+
+    size_t j = begin * extra;
+    size_t last = end * extra;
+    auto blend = [&](size_t j) {
+        float a = shares[j % extra];
+        horizons[j] = ((1 - a) * horizons[j]) + (a * input[j / extra]);
+    };
+
+    v_float32x4 one = v_setall_f32(1.0f);
+    for (; j < last && j % span != 0; ++j) blend(j);
+    for (; j + span <= last; j += span) {
+        for (size_t v = 0; v < span; v += 4) {
+            size_t f = j + v;
+            v_float32x4 x;
+            if (extra == 1) {
+                x = v_load(input + f);
+            } else {
+                float lanes[4] = { input[f / extra], input[(f + 1) / extra],
+                                   input[(f + 2) / extra], input[(f + 3) / extra] };
+                x = v_load(lanes);
+            }
+            v_float32x4 a = v_load(pattern + v);
+            v_store(horizons + f, ((one - a) * v_load(horizons + f)) + (a * x));
+        }
+    }
+    for (; j < last; ++j) blend(j);
+}
+
+std::shared_ptr<ThreadPool::Job> blendHostHorizons(EmaHorizons &horizons, const float *input,
+                                                   const float *shares, cl_ulong size)
+{
+    float *values = horizons.host.data();
+    cl_uint extra = horizons.extra;
+    std::vector<float> copied(shares, shares + extra);
+
+    return threadPool.parallelFor(0, (size_t) size, EMA_GRAIN, [=](size_t begin, size_t end) {
+        blendChunk(input, values, copied.data(), extra, begin, end);
+    });
+}
+
+int readHorizons(EmaHorizons &horizons, cl_ulong begin, cl_ulong count, float *values)
+{
+    cl_ulong first = begin * horizons.extra;
+    cl_ulong length = count * horizons.extra;
+    if (horizons.buffer == NULL) {
+        std::copy(horizons.host.begin() + first, horizons.host.begin() + first + length, values);
+        return 1;
+    }
+
+    cl_int err = clEnqueueReadBuffer
+            (
+                    cl.queue, // command_queue
+                    horizons.buffer, // buffer
+                    true, // blocking_read
+                    first * sizeof(float), // offset
+                    length * sizeof(float), // cb
+                    values, // *ptr
+                    0, // num_events_in_wait_list
+                    NULL, // *event_wait_list
+                    NULL // *event
+            );
+    SAMPLE_CHECK_ERRORS(err);
+    return 1;
+}
+
+void closeHorizons(EmaHorizons &horizons)
+{
+    bufferPool.release(horizons.buffer);
+    horizons.buffer = NULL;
+    horizons.extra = 0;
+    horizons.host.clear();
+    horizons.host.shrink_to_fit();
+}
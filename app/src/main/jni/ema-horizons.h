@@ -0,0 +1,76 @@
+/**
+ * ema-horizons.h
+ * @author Jonathan Dowdall
+ * @since 10-18-2026
+ */
+
+#ifndef UPDATEWEIGHTS_EMA_HORIZONS_H
+#define UPDATEWEIGHTS_EMA_HORIZONS_H
+
+#include <memory>
+#include <vector>
+
+#include "common.h"
+#include "thread-pool.h"
+
+/** Most horizons an exponential moving average keeps, W's own included. Matches the float8 of the kernel. */
+#define EMA_MAX_HORIZONS 8
+
+/** Horizons of an exponential moving average, e.g. fast, medium and slow.
+ *
+ * W holds the first horizon, so everything reading W sees it. The extra horizons are
+ * interleaved per element, horizon h of element i at i * extra + h, so a step reads
+ * each input element once for all of them. They live next to W: on the device for
+ * resident W if they fit, otherwise on the host.
+ */
+struct EmaHorizons
+{
+    /** Smoothing factor of each horizon, W's own first */
+    std::vector<float> alphas;
+
+    /** Number of extra horizons, one less than alphas */
+    cl_uint extra;
+
+    /** Interleaved extra horizons, on the device or on the host */
+    cl_mem buffer;
+    std::vector<float> host;
+};
+
+/*
+ * Share of an input of the given weight in a horizon with smoothing factor alpha at step t.
+ * The first input is taken as it is.
+ */
+float emaShare(float alpha, float weight, unsigned int t);
+
+/*
+ * Allocate the extra horizons of size elements, on the device or the host, each starting out
+ * as W: w on the device or host on the host. Zero if W has seen no input yet.
+ */
+int openHorizons(EmaHorizons &horizons, cl_mem w, const float *host, cl_ulong size, bool initialized,
+                 bool onDevice);
+
+/*
+ * Queue a step blending input into the device horizons, with shares of the input for each extra
+ * horizon, and into w with share alpha unless w is NULL.
+ */
+cl_int enqueueEmaUpdate(EmaHorizons &horizons, cl_mem w, cl_mem input, float alpha, cl_mem dirty,
+                        const float *shares, cl_ulong size);
+
+/*
+ * Blend host input into the host horizons on the thread pool. Join the returned job before
+ * input goes away.
+ */
+std::shared_ptr<ThreadPool::Job> blendHostHorizons(EmaHorizons &horizons, const float *input,
+                                                   const float *shares, cl_ulong size);
+
+/*
+ * Read the extra horizons of count elements from begin, interleaved, into values.
+ */
+int readHorizons(EmaHorizons &horizons, cl_ulong begin, cl_ulong count, float *values);
+
+/*
+ * Release the extra horizons, keeping the smoothing factors.
+ */
+void closeHorizons(EmaHorizons &horizons);
+
+#endif // UPDATEWEIGHTS_EMA_HORIZONS_H
@@ -0,0 +1,91 @@
+/**
+ * engine.cpp
+ * @author Jonathan Dowdall
+ * @since 10-18-2026
+ */
+
+#include "engine.h"
+
+/** Global engine W is updated on */
+Engine engine;
+
+Engine::Engine()
+    : busy(false), stopping(false)
+{
+}
+
+Engine::~Engine()
+{
+    stop();
+}
+
+void Engine::start(std::function<void()> onStart, std::function<void()> onStop)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    if (worker.joinable()) return;
+
+    this->onStart = onStart;
+    this->onStop = onStop;
+    stopping = false;
+    worker = std::thread(&Engine::run, this);
+}
+
+void Engine::stop()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (!worker.joinable()) return;
+        stopping = true;
+    }
+    changed.notify_all();
+    worker.join();
+}
+
+std::future<int> Engine::submit(Task task)
+{
+    std::packaged_task<int()> packaged(task);
+    std::future<int> result = packaged.get_future();
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        queue.push_back(std::move(packaged));
+    }
+    changed.notify_all();
+    return result;
+}
+
+std::unique_lock<std::mutex> Engine::idle()
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    changed.wait(lock, [this] { return !busy && (queue.empty() || !worker.joinable()); });
+    return lock;
+}
+
+bool Engine::onWorker() const
+{
+    return std::this_thread::get_id() == worker.get_id();
+}
+
+void Engine::run()
+{
+    if (onStart) onStart();
+
+    std::unique_lock<std::mutex> lock(mutex);
+    while (true) {
+        changed.wait(lock, [this] { return stopping || !queue.empty(); });
+        if (queue.empty()) break;
+
+        std::packaged_task<int()> task = std::move(queue.front());
+        queue.pop_front();
+        busy = true;
+        lock.unlock();
+
+        task();
+
+        lock.lock();
+        busy = false;
+        changed.notify_all();
+    }
+    lock.unlock();
+
+    if (onStop) onStop();
+}
@@ -0,0 +1,95 @@
+/**
+ * engine.h
+ * @author Jonathan Dowdall
+ * @since 10-18-2026
+ */
+
+#ifndef UPDATEWEIGHTS_ENGINE_H
+#define UPDATEWEIGHTS_ENGINE_H
+
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <deque>
+#include <future>
+#include <functional>
+#include <stdint.h>
+
+#include "common.h"
+
+/** Reports how much of a task is done: units done so far and in total */
+typedef std::function<void(uint64_t done, uint64_t total)> Progress;
+
+/** Worker thread running submitted tasks on W one at a time, in submission order.
+ *
+ * Callers get a future for the result of each task and return immediately.
+ * Code touching W outside of a task first takes idle(), which waits for the
+ * queue to drain and keeps the worker from starting anything else meanwhile.
+ */
+class Engine
+{
+public:
+    typedef std::function<int()> Task;
+
+    Engine();
+    ~Engine();
+
+    /*
+     * Start the worker. onStart and onStop run on it before its first and after its last task.
+     */
+    void start(std::function<void()> onStart, std::function<void()> onStop);
+
+    /*
+     * Finish the queued tasks and join the worker.
+     */
+    void stop();
+
+    /*
+     * Queue task; the future holds its result, 1 on success and 0 on failure.
+     */
+    std::future<int> submit(Task task);
+
+    /*
+     * Wait until every queued task has run and hold the worker off until the lock is released.
+     * Must not be called from a task.
+     */
+    std::unique_lock<std::mutex> idle();
+
+    /*
+     * Whether the calling thread is the worker.
+     */
+    bool onWorker() const;
+
+private:
+    void run();
+
+    std::thread worker;
+    std::function<void()> onStart, onStop;
+
+    mutable std::mutex mutex;
+    std::condition_variable changed;
+    std::deque<std::packaged_task<int()>> queue;
+    bool busy;
+    bool stopping;
+};
+
+/** Global engine W is updated on */
+extern Engine engine;
+
+/*
+ * Headless equivalents of the Java API, for hosts without a Java VM.
+ * Every call returns at once; the future becomes ready once the work has run.
+ */
+
+/*
+ * Average the next time inputs into W; the result is the number of steps run.
+ */
+std::future<int> updateWeightsAsync(int time, Progress progress = Progress());
+
+/*
+ * Average a batch into W. Its vectors, timestamps and weights must stay valid
+ * until the future is ready.
+ */
+std::future<int> submitBatchAsync(const Batch &batch, Progress progress = Progress());
+
+#endif // UPDATEWEIGHTS_ENGINE_H
@@ -0,0 +1,116 @@
+/**
+ * half-float.h
+ * @author Jonathan Dowdall
+ * @since 10-18-2026
+ */
+
+#ifndef UPDATEWEIGHTS_HALF_FLOAT_H
+#define UPDATEWEIGHTS_HALF_FLOAT_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <cstring>
+
+#if defined(__F16C__)
+#include <immintrin.h>
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+#endif
+
+/*
+ * Convert an IEEE 754 half to float, including subnormals, infinities and NaN.
+ */
+static inline float halfToFloat(uint16_t half)
+{
+    uint32_t sign = (uint32_t) (half & 0x8000) << 16;
+    uint32_t exponent = (half >> 10) & 0x1f;
+    uint32_t mantissa = half & 0x3ff;
+    uint32_t bits;
+
+    if (exponent == 0x1f) {
+        bits = sign | 0x7f800000 | (mantissa << 13);
+    } else if (exponent != 0) {
+        bits = sign | ((exponent + 112) << 23) | (mantissa << 13);
+    } else if (mantissa == 0) {
+        bits = sign;
+    } else {
+        // Subnormal half; normalize it since every one is a normal float
+        exponent = 113;
+        while (!(mantissa & 0x400)) {
+            mantissa <<= 1;
+            --exponent;
+        }
+        bits = sign | (exponent << 23) | ((mantissa & 0x3ff) << 13);
+    }
+
+    float value;
+    memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+/*
+ * Convert a float to the nearest IEEE 754 half, ties to even, as vstore_half does by default.
+ * Values beyond the half range become infinities; NaN stays NaN.
+ */
+static inline uint16_t floatToHalf(float value)
+{
+    uint32_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    uint32_t sign = (bits >> 16) & 0x8000;
+    uint32_t magnitude = bits & 0x7fffffff;
+
+    if (magnitude >= 0x7f800000) return (uint16_t) (sign | 0x7c00 | (magnitude > 0x7f800000 ? 0x200 : 0));
+    if (magnitude >= 0x477ff000) return (uint16_t) (sign | 0x7c00);
+
+    uint32_t half, rest, halfway;
+    if (magnitude < 0x38800000) {
+        // Subnormal half, in units of 2^-24; 2^-25 and below round to zero
+        if (magnitude <= 0x33000000) return (uint16_t) sign;
+        uint32_t shift = 126 - (magnitude >> 23);
+        uint32_t mantissa = (magnitude & 0x7fffff) | 0x800000;
+        half = mantissa >> shift;
+        rest = mantissa & ((1u << shift) - 1);
+        halfway = 1u << (shift - 1);
+    } else {
+        // Rebias the exponent; a carry out of the mantissa rounds up into it
+        half = (magnitude >> 13) - (112 << 10);
+        rest = magnitude & 0x1fff;
+        halfway = 0x1000;
+    }
+    if (rest > halfway || (rest == halfway && (half & 1))) ++half;
+    return (uint16_t) (sign | half);
+}
+
+/*
+ * Widen count halves to floats, four at a time with F16C or NEON where available.
+ */
+static inline void halvesToFloats(const uint16_t *in, float *out, size_t count)
+{
+    size_t i = 0;
+#if defined(__F16C__)
+    for (; i + 4 <= count; i += 4) {
+        _mm_storeu_ps(out + i, _mm_cvtph_ps(_mm_loadl_epi64((const __m128i *) (in + i))));
+    }
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+    for (; i + 4 <= count; i += 4) vst1q_f32(out + i, vcvt_f32_f16(vreinterpret_f16_u16(vld1_u16(in + i))));
+#endif
+    for (; i < count; ++i) out[i] = halfToFloat(in[i]);
+}
+
+/*
+ * Narrow count floats to the nearest halves, four at a time with F16C or NEON where available.
+ */
+static inline void floatsToHalves(const float *in, uint16_t *out, size_t count)
+{
+    size_t i = 0;
+#if defined(__F16C__)
+    for (; i + 4 <= count; i += 4) {
+        _mm_storel_epi64((__m128i *) (out + i), _mm_cvtps_ph(_mm_loadu_ps(in + i), _MM_FROUND_TO_NEAREST_INT));
+    }
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+    for (; i + 4 <= count; i += 4) vst1_u16(out + i, vreinterpret_u16_f16(vcvt_f16_f32(vld1q_f32(in + i))));
+#endif
+    for (; i < count; ++i) out[i] = floatToHalf(in[i]);
+}
+
+#endif // UPDATEWEIGHTS_HALF_FLOAT_H
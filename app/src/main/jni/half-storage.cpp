@@ -0,0 +1,78 @@
+/**
+ * half-storage.cpp
+ * @author Jonathan Dowdall
+ * @since 10-18-2026
+ */
+
+#include <cmath>
+#include <vector>
+
+#include "half-storage.h"
+#include "half-float.h"
+
+size_t bytesPerElement(const HalfStorage &storage)
+{
+    return storage.enabled ? sizeof(uint16_t) : sizeof(float);
+}
+
+cl_uint stepSeed(const HalfStorage &storage, unsigned int step)
+{
+    return storage.seed ^ (step * 0x85ebca6bu);
+}
+
+int writeHalfRange(cl_mem buffer, cl_ulong begin, cl_ulong count, const float *values)
+{
+    if (count == 0) return 1;
+    for (cl_ulong i = 0; i < count; ++i) {
+        if (!(std::fabs(values[i]) <= HALF_STORAGE_MAX)) {
+            LOGE("Element %llu of W, %f, is beyond the range of a half\n", (unsigned long long) (begin + i), values[i]);
+            return 0;
+        }
+    }
+
+    std::vector<uint16_t> halves((size_t) count);
+    floatsToHalves(values, halves.data(), (size_t) count);
+    cl_int err = clEnqueueWriteBuffer
+            (
+                    cl.queue, // command_queue
+                    buffer, // buffer
+                    true, // blocking_write
+                    begin * sizeof(uint16_t), // offset
+                    count * sizeof(uint16_t), // cb
+                    halves.data(), // *ptr
+                    0, // num_events_in_wait_list
+                    NULL, // *event_wait_list
+                    NULL // *event
+            );
+    SAMPLE_CHECK_ERRORS(err);
+    return 1;
+}
+
+cl_int enqueueHalfUpdate(const HalfStorage &storage, cl_mem w, cl_mem input, float alpha, cl_mem dirty,
+                         unsigned int step, cl_ulong size)
+{
+    cl_int stochastic = storage.rounding == ROUND_STOCHASTIC;
+    cl_uint seed = stepSeed(storage, step);
+
+    cl_int err = clSetKernelArg(cl.updateWeightsHalf, 0, sizeof(cl_mem), &w);
+    err |= clSetKernelArg(cl.updateWeightsHalf, 1, sizeof(cl_mem), &input);
+    err |= clSetKernelArg(cl.updateWeightsHalf, 2, sizeof(float), &alpha);
+    err |= clSetKernelArg(cl.updateWeightsHalf, 3, sizeof(cl_mem), dirty != NULL ? &dirty : NULL);
+    err |= clSetKernelArg(cl.updateWeightsHalf, 4, sizeof(cl_int), &stochastic);
+    err |= clSetKernelArg(cl.updateWeightsHalf, 5, sizeof(cl_uint), &seed);
+
+    size_t globalDimensions[3] = {(size_t) size, 1, 1};
+    if (err == CL_SUCCESS) err = clEnqueueNDRangeKernel
+            (
+                    cl.queue, // command_queue
+                    cl.updateWeightsHalf, // kernel
+                    3, // work_dim
+                    NULL, // *global_work_offset
+                    globalDimensions, // *global_work_size
+                    NULL, // *local_work_size
+                    0, // num_events_in_wait_list
+                    NULL, // *event_wait_list
+                    NULL // *event
+            );
+    return err;
+}
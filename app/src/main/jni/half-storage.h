@@ -0,0 +1,65 @@
+/**
+ * half-storage.h
+ * @author Jonathan Dowdall
+ * @since 10-18-2026
+ */
+
+#ifndef UPDATEWEIGHTS_HALF_STORAGE_H
+#define UPDATEWEIGHTS_HALF_STORAGE_H
+
+#include "common.h"
+
+/** Largest finite half. Larger values would become infinities, or be clamped by stochastic rounding. */
+#define HALF_STORAGE_MAX 65504.0f
+
+/** How a float is rounded to the half W stores. Values match those passed to the kernels. */
+enum HalfRounding
+{
+    /** Nearest half, ties to even */
+    ROUND_NEAREST = 0,
+
+    /** The half above or below, with a chance proportional to how near it is */
+    ROUND_STOCHASTIC = 1,
+};
+
+/** Storage of resident W and its input vector as halves, for half the memory and traffic
+ * of floats, and twice the elements in a single device allocation. Inputs given as floats
+ * are narrowed on the host.
+ *
+ * Updates load each element as a float, blend in float and round the result back to
+ * a half. Rounding to nearest loses any change smaller than half a unit in the last
+ * place, so a long average with a small share stops moving and drifts; stochastic
+ * rounding keeps those changes in expectation and the average unbiased.
+ */
+struct HalfStorage
+{
+    bool enabled;
+    HalfRounding rounding;
+
+    /** Seed of the random bits of stochastic rounding, combined with the step */
+    cl_uint seed;
+};
+
+/*
+ * Bytes per element of resident W.
+ */
+size_t bytesPerElement(const HalfStorage &storage);
+
+/*
+ * Seed of the rounding bits of the given step, so that no two steps round alike.
+ */
+cl_uint stepSeed(const HalfStorage &storage, unsigned int step);
+
+/*
+ * Narrow count floats to halves and write them at begin of a buffer of halves.
+ * Refuses values beyond HALF_STORAGE_MAX rather than writing infinities.
+ */
+int writeHalfRange(cl_mem buffer, cl_ulong begin, cl_ulong count, const float *values);
+
+/*
+ * Queue averaging an input stored as halves into W stored as halves with share alpha, at the given step.
+ */
+cl_int enqueueHalfUpdate(const HalfStorage &storage, cl_mem w, cl_mem input, float alpha, cl_mem dirty,
+                         unsigned int step, cl_ulong size);
+
+#endif // UPDATEWEIGHTS_HALF_STORAGE_H
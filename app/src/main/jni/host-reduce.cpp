@@ -0,0 +1,260 @@
+/**
+ * host-reduce.cpp
+ * @author Jonathan Dowdall
+ * @since 10-18-2026
+ */
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstring>
+#include <vector>
+
+#include <opencv2/core/hal/intrin.hpp>
+
+#include "host-reduce.h"
+#include "thread-pool.h"
+
+using namespace cv;
+
+/** Elements per block. Each block is reduced by one thread into one partial result,
+ *  so results do not depend on how many threads ran. */
+#define HOST_REDUCE_BLOCK (1 << 16)
+
+/** Elements accumulated in single precision lanes before they are added into doubles.
+ *  Bounds the rounding error of a block to that of a short float sum. */
+#define HOST_REDUCE_FLUSH 256
+
+/*
+ * Statistics of one block. hasRef is a template argument to keep the test out of the loop.
+ */
+template <bool hasRef>
+static void blockStats(const float *x, const float *ref, size_t n, ArrayStats &stats)
+{
+    double sum = 0.0, sumSquares = 0.0, differenceSquares = 0.0;
+    v_float32x4 low = v_setall_f32(FLT_MAX);
+    v_float32x4 high = v_setall_f32(-FLT_MAX);
+    v_float32x4 maxDifference = v_setzero_f32();
+
+    size_t vectorEnd = n & ~(size_t) 3;
+    for (size_t flush = 0; flush < vectorEnd; flush += HOST_REDUCE_FLUSH) {
+        size_t end = std::min(vectorEnd, flush + HOST_REDUCE_FLUSH);
+        v_float32x4 s = v_setzero_f32(), s2 = v_setzero_f32(), d2 = v_setzero_f32();
+        for (size_t i = flush; i < end; i += 4) {
+            v_float32x4 v = v_load(x + i);
+            s += v;
+            s2 += v * v;
+            low = v_min(low, v);
+            high = v_max(high, v);
+            if (hasRef) {
+                v_float32x4 d = v - v_load(ref + i);
+                d2 += d * d;
+                maxDifference = v_max(maxDifference, v_abs(d));
+            }
+        }
+        sum += v_reduce_sum(s);
+        sumSquares += v_reduce_sum(s2);
+        if (hasRef) differenceSquares += v_reduce_sum(d2);
+    }
+
+    stats.min = v_reduce_min(low);
+    stats.max = v_reduce_max(high);
+    stats.maxDifference = v_reduce_max(maxDifference);
+
+    for (size_t i = vectorEnd; i < n; ++i) {
+        double v = x[i];
+        sum += v;
+        sumSquares += v * v;
+        stats.min = std::min(stats.min, v);
+        stats.max = std::max(stats.max, v);
+        if (hasRef) {
+            double d = v - ref[i];
+            differenceSquares += d * d;
+            stats.maxDifference = std::max(stats.maxDifference, std::fabs(d));
+        }
+    }
+
+    stats.sum = sum;
+    stats.sumSquares = sumSquares;
+    stats.differenceSquares = differenceSquares;
+}
+
+/*
+ * Combine the partials of blocks [begin, end) pairwise, so rounding grows with the log of the block count.
+ */
+static ArrayStats combineStats(const std::vector<ArrayStats> &partials, size_t begin, size_t end)
+{
+    if (end - begin == 1) return partials[begin];
+
+    size_t middle = begin + (end - begin) / 2;
+    ArrayStats a = combineStats(partials, begin, middle);
+    ArrayStats b = combineStats(partials, middle, end);
+    a.sum += b.sum;
+    a.sumSquares += b.sumSquares;
+    a.min = std::min(a.min, b.min);
+    a.max = std::max(a.max, b.max);
+    a.differenceSquares += b.differenceSquares;
+    a.maxDifference = std::max(a.maxDifference, b.maxDifference);
+    return a;
+}
+
+void hostStats(const float *x, const float *ref, size_t n, ArrayStats &stats)
+{
+    stats = ArrayStats();
+    if (n == 0) return;
+
+    size_t blocks = (n + HOST_REDUCE_BLOCK - 1) / HOST_REDUCE_BLOCK;
+    std::vector<ArrayStats> partials(blocks);
+    threadPool.parallelFor(0, blocks, 1, [&](size_t first, size_t last) {
+        for (size_t b = first; b < last; ++b) {
+            size_t begin = b * HOST_REDUCE_BLOCK;
+            size_t count = std::min<size_t>(HOST_REDUCE_BLOCK, n - begin);
+            if (ref != NULL) blockStats<true>(x + begin, ref + begin, count, partials[b]);
+            else blockStats<false>(x + begin, NULL, count, partials[b]);
+        }
+    })->wait();
+
+    stats = combineStats(partials, 0, blocks);
+}
+
+/*
+ * Bucket of a distance in units in the last place.
+ */
+static inline int ulpBucket(uint32_t distance)
+{
+    return distance == 0 ? 0 : 32 - __builtin_clz(distance);
+}
+
+/*
+ * Map the bits of a float to an integer that orders like the float, with +0 and -0 both at 0.
+ */
+static inline int32_t orderedBits(float value)
+{
+    int32_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    int32_t sign = bits >> 31;
+    return (bits ^ (sign & 0x7fffffff)) - sign;
+}
+
+void ulpHistogram(const float *x, const float *ref, size_t n, uint64_t histogram[ULP_BUCKETS])
+{
+    std::fill(histogram, histogram + ULP_BUCKETS, 0);
+    if (n == 0) return;
+
+    size_t blocks = (n + HOST_REDUCE_BLOCK - 1) / HOST_REDUCE_BLOCK;
+    std::vector<uint64_t> partials(blocks * ULP_BUCKETS, 0);
+    threadPool.parallelFor(0, blocks, 1, [&](size_t first, size_t last) {
+        const v_int32x4 magnitude = v_setall_s32(0x7fffffff);
+        for (size_t b = first; b < last; ++b) {
+            uint64_t *counts = &partials[b * ULP_BUCKETS];
+            size_t begin = b * HOST_REDUCE_BLOCK;
+            size_t end = begin + std::min<size_t>(HOST_REDUCE_BLOCK, n - begin);
+
+            // Same mapping as orderedBits, four lanes at a time
+            size_t i = begin;
+            for (; i + 4 <= end; i += 4) {
+                v_int32x4 a = v_reinterpret_as_s32(v_load(x + i));
+                v_int32x4 r = v_reinterpret_as_s32(v_load(ref + i));
+                v_int32x4 aSign = a >> 31;
+                v_int32x4 rSign = r >> 31;
+                a = (a ^ (aSign & magnitude)) - aSign;
+                r = (r ^ (rSign & magnitude)) - rSign;
+
+                int32_t ordered[4], orderedRef[4];
+                v_store(ordered, a);
+                v_store(orderedRef, r);
+                for (int lane = 0; lane < 4; ++lane) {
+                    int64_t distance = (int64_t) ordered[lane] - orderedRef[lane];
+                    ++counts[ulpBucket((uint32_t) (distance < 0 ? -distance : distance))];
+                }
+            }
+            for (; i < end; ++i) {
+                int64_t distance = (int64_t) orderedBits(x[i]) - orderedBits(ref[i]);
+                ++counts[ulpBucket((uint32_t) (distance < 0 ? -distance : distance))];
+            }
+        }
+    })->wait();
+
+    for (size_t b = 0; b < blocks; ++b) {
+        for (int bucket = 0; bucket < ULP_BUCKETS; ++bucket) histogram[bucket] += partials[b * ULP_BUCKETS + bucket];
+    }
+}
+
+/*
+ * Whether a ranks before b: larger key, then lower index.
+ */
+static inline bool ranksBefore(float aKey, cl_ulong aIndex, float bKey, cl_ulong bIndex)
+{
+    return aKey > bKey || (aKey == bKey && aIndex < bIndex);
+}
+
+/*
+ * The k best of one block, as keys negated when selecting the smallest.
+ * Kept in a heap with the worst candidate on top, so most elements are rejected
+ * four at a time against it.
+ */
+static void blockTopK(const float *x, size_t begin, size_t end, size_t k, bool smallest,
+                      std::vector<IndexedValue> &heap)
+{
+    auto worseFirst = [](const IndexedValue &a, const IndexedValue &b) {
+        return ranksBefore(a.value, a.index, b.value, b.index);
+    };
+    float sign = smallest ? -1.0f : 1.0f;
+    v_float32x4 signs = v_setall_f32(sign);
+
+    size_t i = begin;
+    for (; i < end; ++i) {
+        if (heap.size() == k) break;
+        IndexedValue entry = { i, sign * x[i] };
+        heap.push_back(entry);
+        std::push_heap(heap.begin(), heap.end(), worseFirst);
+    }
+
+    for (; i + 4 <= end; i += 4) {
+        // Keys equal to the worst candidate lose to it on index, being later
+        v_float32x4 keys = v_load(x + i) * signs;
+        int better = v_signmask(keys > v_setall_f32(heap.front().value));
+        for (int lane = 0; better != 0; ++lane, better >>= 1) {
+            float key = sign * x[i + lane];
+            if (!(better & 1) || key <= heap.front().value) continue;
+            std::pop_heap(heap.begin(), heap.end(), worseFirst);
+            heap.back().index = i + lane;
+            heap.back().value = key;
+            std::push_heap(heap.begin(), heap.end(), worseFirst);
+        }
+    }
+    for (; i < end; ++i) {
+        float key = sign * x[i];
+        if (key <= heap.front().value) continue;
+        std::pop_heap(heap.begin(), heap.end(), worseFirst);
+        heap.back().index = i;
+        heap.back().value = key;
+        std::push_heap(heap.begin(), heap.end(), worseFirst);
+    }
+}
+
+void hostTopK(const float *x, size_t n, size_t k, bool smallest, std::vector<IndexedValue> &top)
+{
+    top.clear();
+    k = std::min(k, n);
+    if (k == 0) return;
+
+    size_t blocks = (n + HOST_REDUCE_BLOCK - 1) / HOST_REDUCE_BLOCK;
+    std::vector<std::vector<IndexedValue>> partials(blocks);
+    threadPool.parallelFor(0, blocks, 1, [&](size_t first, size_t last) {
+        for (size_t b = first; b < last; ++b) {
+            partials[b].reserve(k);
+            blockTopK(x, b * HOST_REDUCE_BLOCK, std::min<size_t>(n, (b + 1) * HOST_REDUCE_BLOCK),
+                      k, smallest, partials[b]);
+        }
+    })->wait();
+
+    for (size_t b = 0; b < blocks; ++b) top.insert(top.end(), partials[b].begin(), partials[b].end());
+    std::partial_sort(top.begin(), top.begin() + k, top.end(), [](const IndexedValue &a, const IndexedValue &b) {
+        return ranksBefore(a.value, a.index, b.value, b.index);
+    });
+    top.resize(k);
+    if (smallest) {
+        for (size_t r = 0; r < k; ++r) top[r].value = -top[r].value;
+    }
+}
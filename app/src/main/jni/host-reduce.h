@@ -0,0 +1,38 @@
+/**
+ * host-reduce.h
+ * @author Jonathan Dowdall
+ * @since 10-18-2026
+ */
+
+#ifndef UPDATEWEIGHTS_HOST_REDUCE_H
+#define UPDATEWEIGHTS_HOST_REDUCE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+#include "common.h"
+
+/** Buckets of the ULP distance histogram: bucket 0 counts equal elements, bucket b
+ *  distances in [2^(b-1), 2^b). The last bucket reaches the largest distance, 2^32 - 1. */
+#define ULP_BUCKETS 33
+
+/*
+ * Reduce n elements of x, and their difference to ref unless it is NULL, on the host.
+ * Same statistics as deviceStats, vectorized and spread over the thread pool.
+ */
+void hostStats(const float *x, const float *ref, size_t n, ArrayStats &stats);
+
+/*
+ * Count the elements of x by their distance to ref in units in the last place.
+ * +0 and -0 are equal; histogram is overwritten.
+ */
+void ulpHistogram(const float *x, const float *ref, size_t n, uint64_t histogram[ULP_BUCKETS]);
+
+/*
+ * Select the k largest elements of x, or the k smallest, best first; fewer if n < k.
+ * Ties go to the lower index.
+ */
+void hostTopK(const float *x, size_t n, size_t k, bool smallest, std::vector<IndexedValue> &top);
+
+#endif // UPDATEWEIGHTS_HOST_REDUCE_H
@@ -0,0 +1,161 @@
+/**
+ * lazy-decay.cpp
+ * @author Jonathan Dowdall
+ * @since 10-18-2026
+ */
+
+#include <algorithm>
+#include <cmath>
+
+#include "lazy-decay.h"
+#include "buffer-pool.h"
+
+/** Minimum elements per chunk of the host update */
+#define LAZY_GRAIN (1 << 16)
+
+float lazyFactor(const LazyDecay &lazy, unsigned int now, uint32_t last)
+{
+    if (now == last) return 1.0f;
+    return std::exp2((float) (now - last) * std::log2(1.0f - lazy.alpha));
+}
+
+/*
+ * Fill size bytes of buffer with a 32-bit pattern.
+ */
+static cl_int enqueueFill(cl_mem buffer, const void *pattern, size_t size)
+{
+    return clEnqueueFillBuffer
+            (
+                    cl.queue, // command_queue
+                    buffer, // buffer
+                    pattern, // *pattern
+                    4, // pattern_size
+                    0, // offset
+                    size, // size
+                    0, // num_events_in_wait_list
+                    NULL, // *event_wait_list
+                    NULL // *event
+            );
+}
+
+int openLazyDecay(LazyDecay &lazy, cl_mem w, float *host, cl_ulong size, unsigned int now, bool zero)
+{
+    cl_int err = CL_SUCCESS;
+
+    closeLazyDecay(lazy);
+    if (w == NULL) {
+        lazy.hostLastStep.assign((size_t) size, now);
+        if (zero) std::fill(host, host + size, 0.0f);
+        return 1;
+    }
+
+    lazy.lastStep = bufferPool.allocate(size * sizeof(cl_uint), CL_MEM_READ_WRITE, &err);
+    SAMPLE_CHECK_ERRORS(err);
+    const cl_uint step = now;
+    const float nothing = 0.0f;
+    err = enqueueFill(lazy.lastStep, &step, size * sizeof(cl_uint));
+    if (err == CL_SUCCESS && zero) err = enqueueFill(w, &nothing, size * sizeof(float));
+    if (err != CL_SUCCESS) closeLazyDecay(lazy);
+    SAMPLE_CHECK_ERRORS(err);
+    return 1;
+}
+
+cl_int enqueueLazyUpdate(LazyDecay &lazy, cl_mem w, cl_mem dirty, cl_mem indices, cl_mem values,
+                         cl_ulong count, unsigned int now)
+{
+    cl_uint elements = (cl_uint) count;
+    cl_uint step = now;
+    float decayLog2 = std::log2(1.0f - lazy.alpha);
+
+    cl_int err = clSetKernelArg(cl.updateLazy, 0, sizeof(cl_mem), &w);
+    err |= clSetKernelArg(cl.updateLazy, 1, sizeof(cl_mem), &lazy.lastStep);
+    err |= clSetKernelArg(cl.updateLazy, 2, sizeof(cl_mem), dirty != NULL ? &dirty : NULL);
+    err |= clSetKernelArg(cl.updateLazy, 3, sizeof(cl_mem), indices != NULL ? &indices : NULL);
+    err |= clSetKernelArg(cl.updateLazy, 4, sizeof(cl_mem), &values);
+    err |= clSetKernelArg(cl.updateLazy, 5, sizeof(cl_uint), &elements);
+    err |= clSetKernelArg(cl.updateLazy, 6, sizeof(cl_uint), &step);
+    err |= clSetKernelArg(cl.updateLazy, 7, sizeof(float), &lazy.alpha);
+    err |= clSetKernelArg(cl.updateLazy, 8, sizeof(float), &decayLog2);
+
+    size_t globalDimensions[3] = {(size_t) count, 1, 1};
+    if (err == CL_SUCCESS && count > 0) err = clEnqueueNDRangeKernel
+            (
+                    cl.queue, // command_queue
+                    cl.updateLazy, // kernel
+                    3, // work_dim
+                    NULL, // *global_work_offset
+                    globalDimensions, // *global_work_size
+                    NULL, // *local_work_size
+                    0, // num_events_in_wait_list
+                    NULL, // *event_wait_list
+                    NULL // *event
+            );
+    return err;
+}
+
+cl_int enqueueSettle(LazyDecay &lazy, cl_mem w, cl_mem dirty, cl_ulong begin, cl_ulong count,
+                     unsigned int now)
+{
+    cl_uint elements = (cl_uint) count;
+    cl_uint step = now;
+    float decayLog2 = std::log2(1.0f - lazy.alpha);
+
+    cl_int err = clSetKernelArg(cl.settleLazy, 0, sizeof(cl_mem), &w);
+    err |= clSetKernelArg(cl.settleLazy, 1, sizeof(cl_mem), &lazy.lastStep);
+    err |= clSetKernelArg(cl.settleLazy, 2, sizeof(cl_mem), dirty != NULL ? &dirty : NULL);
+    err |= clSetKernelArg(cl.settleLazy, 3, sizeof(cl_ulong), &begin);
+    err |= clSetKernelArg(cl.settleLazy, 4, sizeof(cl_uint), &elements);
+    err |= clSetKernelArg(cl.settleLazy, 5, sizeof(cl_uint), &step);
+    err |= clSetKernelArg(cl.settleLazy, 6, sizeof(float), &decayLog2);
+
+    size_t globalDimensions[3] = {(size_t) count, 1, 1};
+    if (err == CL_SUCCESS && count > 0) err = clEnqueueNDRangeKernel
+            (
+                    cl.queue, // command_queue
+                    cl.settleLazy, // kernel
+                    3, // work_dim
+                    NULL, // *global_work_offset
+                    globalDimensions, // *global_work_size
+                    NULL, // *local_work_size
+                    0, // num_events_in_wait_list
+                    NULL, // *event_wait_list
+                    NULL // *event
+            );
+    return err;
+}
+
+std::shared_ptr<ThreadPool::Job> updateHostLazy(LazyDecay &lazy, float *w, const uint64_t *indices,
+                                                const float *values, cl_ulong count, unsigned int now)
+{
+    uint32_t *lastStep = lazy.hostLastStep.data();
+    LazyDecay *decay = &lazy;
+    float alpha = lazy.alpha;
+
+    return threadPool.parallelFor(0, (size_t) count, LAZY_GRAIN, [=](size_t begin, size_t end) {
+        for (size_t j = begin; j < end; ++j) {
+            size_t i = indices != NULL ? (size_t) indices[j] : j;
+            w[i] = lazyFactor(*decay, now, lastStep[i]) * w[i] + alpha * values[j];
+            lastStep[i] = now;
+        }
+    });
+}
+
+void settleHost(LazyDecay &lazy, float *w, cl_ulong begin, cl_ulong count, unsigned int now)
+{
+    uint32_t *lastStep = lazy.hostLastStep.data();
+    threadPool.parallelFor((size_t) begin, (size_t) (begin + count), LAZY_GRAIN, [&](size_t first, size_t last) {
+        for (size_t i = first; i < last; ++i) {
+            if (lastStep[i] == now) continue;
+            w[i] *= lazyFactor(lazy, now, lastStep[i]);
+            lastStep[i] = now;
+        }
+    })->wait();
+}
+
+void closeLazyDecay(LazyDecay &lazy)
+{
+    bufferPool.release(lazy.lastStep);
+    lazy.lastStep = NULL;
+    lazy.hostLastStep.clear();
+    lazy.hostLastStep.shrink_to_fit();
+}
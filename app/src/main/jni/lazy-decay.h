@@ -0,0 +1,75 @@
+/**
+ * lazy-decay.h
+ * @author Jonathan Dowdall
+ * @since 10-18-2026
+ */
+
+#ifndef UPDATEWEIGHTS_LAZY_DECAY_H
+#define UPDATEWEIGHTS_LAZY_DECAY_H
+
+#include <stdint.h>
+#include <memory>
+#include <vector>
+
+#include "common.h"
+#include "thread-pool.h"
+
+/** Exponential moving average of sparse inputs with lazy decay.
+ *
+ * Every step decays all of W by 1 - alpha, elements without an input counting as
+ * given 0. Rather than touching every element, W holds each one as of the step it
+ * was last brought up to date at, and the decay of the steps since is applied when
+ * an input touches it or it is settled to be read. A step then costs as much as
+ * the elements it gives an input to.
+ */
+struct LazyDecay
+{
+    float alpha;
+
+    /** Step each element was last brought up to date at, on the device for resident W or on the host */
+    cl_mem lastStep;
+    std::vector<uint32_t> hostLastStep;
+};
+
+/*
+ * Decay of an element over the steps from last to now, as the kernels compute it.
+ */
+float lazyFactor(const LazyDecay &lazy, unsigned int now, uint32_t last);
+
+/*
+ * Start tracking size elements of W as up to date at step now, on the device or the host.
+ * W, w on the device or host on the host, is zeroed first if zero is set.
+ */
+int openLazyDecay(LazyDecay &lazy, cl_mem w, float *host, cl_ulong size, unsigned int now, bool zero);
+
+/*
+ * Queue a step blending count inputs into device W at step now: values at indices,
+ * or a dense input when indices is NULL.
+ */
+cl_int enqueueLazyUpdate(LazyDecay &lazy, cl_mem w, cl_mem dirty, cl_mem indices, cl_mem values,
+                         cl_ulong count, unsigned int now);
+
+/*
+ * Queue bringing elements [begin, begin + count) of device W up to date at step now.
+ */
+cl_int enqueueSettle(LazyDecay &lazy, cl_mem w, cl_mem dirty, cl_ulong begin, cl_ulong count,
+                     unsigned int now);
+
+/*
+ * Blend count inputs into host W at step now on the thread pool: values at indices,
+ * or a dense input when indices is NULL.
+ */
+std::shared_ptr<ThreadPool::Job> updateHostLazy(LazyDecay &lazy, float *w, const uint64_t *indices,
+                                                const float *values, cl_ulong count, unsigned int now);
+
+/*
+ * Bring elements [begin, begin + count) of host W up to date at step now.
+ */
+void settleHost(LazyDecay &lazy, float *w, cl_ulong begin, cl_ulong count, unsigned int now);
+
+/*
+ * Release the step of every element, keeping alpha.
+ */
+void closeLazyDecay(LazyDecay &lazy);
+
+#endif // UPDATEWEIGHTS_LAZY_DECAY_H
@@ -5,126 +5,124 @@
  */
 
 #include <jni.h>
-#include <CL/cl.h>
 #include <string>
 #include <fstream>
 #include <iostream>
-#include <android/log.h>
 #include <vector>
 #include <random>
 #include <algorithm>
 #include <chrono>
 #include <ctime>
 #include <cstdlib>
+#include <cstdint>
+#include <cfloat>
+#include <cmath>
+#include <atomic>
+#include <map>
+
+#include "common.h"
+#include "buffer-pool.h"
+#include "tiled-w.h"
+#include "state-file.h"
+#include "dataset-reader.h"
+#include "engine.h"
+#include "thread-pool.h"
+#include "device-reduce.h"
+#include "host-reduce.h"
+#include "sampled-check.h"
+#include "device-read.h"
+#include "snapshot.h"
+#include "delta-stream.h"
+#include "convergence.h"
+#include "ema-horizons.h"
+#include "window-average.h"
+#include "lazy-decay.h"
+#include "element-counts.h"
+#include "quantized-input.h"
+#include "half-storage.h"
 
-/* Container for all OpenCL-specific objects used.
- *
- * The container consists of the following parts:
- *   - Regular OpenCL objects, used in almost each
- *     OpenCL application.
- *   - Specific OpenCL objects - buffers, used in this
- *     particular sample.
- *
- * For convenience, collect all objects in one structure.
- * Avoid global variables and make easier the process of passing
- * all arguments in functions.
- *
- * As defined by Kronos specification:
- * https://www.khronos.org/registry/cl/specs/opencl-1.0.29.pdf
- */
-struct OpenCLObjects
-{
-    /** The platform consists of one or more OpenCL devices */
-    cl_platform_id platform;
-
-    /** A device is a collection of compute units. A command-queue is used to queue
-     * commands to a device. Examples of commands include executing kernels,
-     * or reading and writing memory objects. OpenCL devices typically correspond to a GPU,
-     * a multi-core CPU, and other processors such as DSPs and the Cell/B.E. processor. */
-    cl_device_id device;
-
-    /** The environment within which the kernels execute and
-     * the domain in which synchronization and memory management is defined.
-     * The context includes a set of devices, the memory accessible to those devices,
-     * the corresponding memory properties and one or more command-queues used to
-     * schedule execution of a kernel(s) or operations on memory objects.
-     */
-    cl_context context;
+/** Global cl variable to store context among functions */
+OpenCLObjects cl;
 
-    /** A data structure used to coordinate execution of the kernels on the devices.
-     * The host places commands into the command-queue
-     * which are then scheduled onto the devices within the context.
-     */
-    cl_command_queue queue;
-
-    /** An object that encapsulates the following:
-     *      - A reference to an associated context.
-     *      - A program source or binary.
-     *      - The latest successfully built program executable,
-     *        the list of devices for which the program executable
-     *        is built, the build options used and a build log.
-     *      - The number of kernel objects currently attached.
-     */
-    cl_program program;
+/** Global GPU properties to share between initialization and kernel designs */
+GpuProperties gpu;
 
-    /** Kernel used to update elements in array W when provided new input vector. */
-    cl_kernel updateWeights;
-};
+/** Global array that maintains input average for GPU computation. */
+W wGpu;
 
-/** The GPU properties provided by OpenCL APU queries.
- *
- * These properties are important to properly manage problem dimensions
- * and memory management.
- */
-struct GpuProperties{
-    /** The name of the GPU device */
-    char name[128];
+/** Storage of resident W, as floats unless set to halves. Tiled W is always in floats. */
+HalfStorage storageW;
 
-    /** How many compute units (GPU cores) are on the device */
-    cl_int computeUnits;
+/** Global array that maintains input average for GPU computation. */
+float *wCpu;
 
-    /** Maximum global memory size */
-    cl_ulong globalMem;
+/** Global array of input vector. */
+W inputVector;
 
-    /** Maximum local memory size */
-    cl_ulong localMem;
+/** Global host copy of the input vector used by the CPU computation. */
+float *inputCpu;
 
-    /** Maximum size of memory allocation for buffers */
-    cl_ulong maxAllocSize;
+/** Global W streamed through the device when too large for a single allocation. */
+TiledW tiledW;
 
-    /** True if GPU shares memory with host (integrated graphics)
-     *  False if GPU has dedicated memory (discrete graphics)
-     *      -Information must be transferred between host and GPU
-     */
-    cl_bool unifiedMem;
-};
+/** Global flag set when the GPU computation uses tiledW instead of wGpu */
+bool tiled = false;
 
-struct W{
-    /** Memory allocated for array w */
-    cl_mem buffer;
+/** Global state file W is checkpointed to and restored from, and its path. */
+StateFile state;
+std::string statePath;
 
-    /** Pointer to mapped to allocated memory for array W */
-    float* pointer;
+/** Global flag set while the state file matches W outside of its dirty tiles */
+bool stateCurrent = false;
 
-    /** Size of array */
-    int size;
-};
+/** Global per-tile flags of W modified since the last checkpoint.
+ *  Set on the host, and by the kernels in dirtyBuffer for resident W. */
+std::vector<cl_uchar> dirtyTiles;
+cl_mem dirtyBuffer;
 
+/** Global dataset input vectors are streamed from instead of being synthesized, if open,
+ *  and the vector its float16 and uint8 elements are converted into */
+Dataset dataset;
+std::vector<float> datasetVector;
 
-/** Global cl variable to store context among functions */
-OpenCLObjects cl;
+/** Global number of elements of W checked against a sampled CPU shadow, 0 to keep
+ *  the full CPU W instead, and the shadow itself */
+cl_ulong verifySamples = 0;
+ShadowSample shadow;
 
-/** Global GPU properties to share between initialization and kernel designs */
-GpuProperties gpu;
+/** Global lock held while a step is queued, and while W is replaced, so snapshots fall between steps */
+std::mutex stepMutex;
 
-/** Global array that maintains input average for GPU computation. */
-W wGpu;
+/** Global lock held while a lazily decayed W is settled. Snapshots settle under stepMutex alone and
+ *  readers under the engine lock alone, so neither keeps the other from settling the same elements. */
+std::mutex settleMutex;
 
-/** Global array that maintains input average for GPU computation. */
-float *wCpu;
+/** Global stream of elements whose average moved, while a subscriber is polling it */
+DeltaStream deltas;
 
-/** Global array of input vector. */
-W inputVector;
+/** Global change made by each step, while monitored, and the policy stopping ingestion once W converged */
+Convergence convergence;
+
+/** Global way W averages its inputs, and the horizons of the exponential moving average */
+AveragingMode averagingMode = MODE_CUMULATIVE;
+EmaHorizons horizons;
+
+/** Global sliding window of the last inputs W averages in window mode, and the one of the CPU reference */
+SlidingWindow window;
+SlidingWindow cpuWindow;
+
+/** Last step of each element of a lazily decayed average, in W and in the CPU reference */
+LazyDecay lazy;
+LazyDecay cpuLazy;
+
+/** Weight each element of W and of the CPU reference has received, for a mean kept per element */
+ElementCounts counts;
+ElementCounts cpuCounts;
+
+/** Global snapshots of W taken by readers, by handle, and the last handle given out */
+std::map<jlong, std::shared_ptr<Snapshot>> snapshots;
+std::mutex snapshotMutex;
+jlong lastSnapshot = 0;
 
 /** Global variables to keep track of elapsed time for cpu/gpu functions */
 long long cpuTime = 0;
@@ -133,6 +131,27 @@ long long gpuTime = 0;
 /** Global variable keeping track of time iterations for updating weights */
 unsigned int t = 0;
 
+/** Global sum of the weights of all inputs averaged into W, t if every one weighed 1 */
+double totalWeight = 0;
+
+/** Global tokens of the last task submitted from Java and the last one completed */
+std::atomic<jlong> submittedToken(0);
+std::atomic<jlong> completedToken(0);
+
+/** Global Java VM, the engine thread's environment in it, and the listener
+ *  notified of progress and completion of tasks submitted from Java */
+JavaVM *javaVm;
+JNIEnv *workerEnv;
+jobject engineListener;
+jmethodID onProgressMethod;
+jmethodID onCompleteMethod;
+
+/** Minimum milliseconds between progress reports of a task */
+#define PROGRESS_INTERVAL_MS 100
+
+/** Minimum elements per chunk of the CPU update spread over the thread pool */
+#define CPU_GRAIN (1 << 16)
+
 /** Global flag for timing metrics */
 bool timer = true;
 
@@ -141,10 +160,6 @@ bool cpuTesting = true;
 bool gpuTesting = true;
 
 /********************************** Helper Functions ********************************************/
-// Commonly-defined shortcuts for LogCat output from native C applications.
-#define  LOG_TAG    "AndroidBasic"
-#define  LOGD(...)  __android_log_print(ANDROID_LOG_DEBUG, LOG_TAG, __VA_ARGS__)
-#define  LOGE(...)  __android_log_print(ANDROID_LOG_ERROR, LOG_TAG, __VA_ARGS__)
 
 /* This function helps to create informative messages in
  * case when OpenCL errors occur. The function returns a string
@@ -216,31 +231,6 @@ return "UNKNOWN ERROR CODE";
 #undef CASE_CL_CONSTANT
 }
 
-/* The following macro is used after each OpenCL call
- * to check if OpenCL error occurs. In the case when ERR != CL_SUCCESS
- * the macro forms an error message with OpenCL error code mnemonic,
- * puts it to LogCat, and returns from a caller function.
- *
- * The approach helps to implement consistent error handling tactics
- * because it is important to catch OpenCL errors as soon as
- * possible to avoid missing the origin of the problem.
- *
- * You may chose a different way to do that. The macro is
- * simple and context-specific as it assumes you use it in a function
- * that doesn't have a return value, so it just returns in the end.
- */
-#define SAMPLE_CHECK_ERRORS(ERR)                                                      \
-    if(ERR != CL_SUCCESS)                                                             \
-    {                                                                                 \
-        LOGE                                                                          \
-        (                                                                             \
-            "OpenCL error with code %s happened in file %s at line %d. Exiting.\n",   \
-            opencl_error_to_str(ERR), __FILE__, __LINE__                              \
-        );                                                                            \
-                                                                                      \
-        return 0;                                                                     \
-    }
-
 /*
  * Load the program out of the file in to a string for opencl compiling.
  */
@@ -255,525 +245,2783 @@ inline std::string loadProgram(std::string input)
                         (std::istreambuf_iterator<char>()));
 }
 
-/********************************** /Helper Functions ********************************************/
+/*
+ * Zero size bytes of a buffer of floats or halves, as given by elementSize, starting at offset,
+ * without waiting for it to complete. Offset and size have to be multiples of elementSize.
+ * Only needed where W is read before any input has been written to it.
+ */
+cl_int enqueueClear(cl_mem buffer, size_t offset, size_t size, size_t elementSize)
+{
+    const cl_float zero = 0.0f;
+    const cl_half zeroHalf = 0;
+    return clEnqueueFillBuffer
+            (
+                    cl.queue, // command_queue
+                    buffer, // buffer
+                    elementSize == sizeof(cl_half) ? (const void *) &zeroHalf : &zero, // *pattern
+                    elementSize == sizeof(cl_half) ? sizeof(zeroHalf) : sizeof(zero), // pattern_size
+                    offset, // offset
+                    size, // size
+                    0, // num_events_in_wait_list
+                    NULL, // *event_wait_list
+                    NULL // *event
+            );
+}
 
-enum NativeType
+/*
+ * Memory flags for W and the input vector.
+ * If unified memory, allocate memory on host. Otherwise allocate on GPU memory.
+ */
+cl_mem_flags wFlags()
 {
-    JBoolean,
-    JByte,
-    JChar,
-    JShort,
-    JInt,
-    JLong,
-    Jfloat,
-    JDouble,
-};
+    return CL_MEM_READ_WRITE | (gpu.unifiedMem ? CL_MEM_ALLOC_HOST_PTR : 0);
+}
 
-extern "C" JNIEXPORT jint JNICALL
-Java_com_example_jonny_updateweights_MainActivity_initOpenCl(JNIEnv *env, jobject instance, jstring kernelName) {
-    // The following variable stores return codes for all OpenCL calls.
-    // In the code it is used with the SAMPLE_CHECK_ERRORS macro defined
-    // before this function.
-    cl_int err = CL_SUCCESS;
+cl_mem_flags inputFlags()
+{
+    return CL_MEM_READ_ONLY | (gpu.unifiedMem ? CL_MEM_ALLOC_HOST_PTR : 0);
+}
 
-    /* -----------------------------------------------------------------------
-     * Step 1: Query and choose OpenCL platform.
-     */
-    clGetPlatformIDs(1, &cl.platform, NULL);
-    char platform_name[100];
-    err = clGetPlatformInfo(
-            cl.platform,
-            CL_PLATFORM_NAME,
-            100,
-            platform_name,
-            0
-    );
-    LOGD("Platform: %s", platform_name);
+/*
+ * Grow a device vector to hold size elements of elementSize bytes, at least doubling its
+ * capacity when it runs out. The first vec.size elements are preserved by a device-side copy.
+ */
+int growBuffer(W &vec, cl_ulong size, cl_mem_flags flags, size_t elementSize)
+{
+    cl_int err;
 
-    /* -----------------------------------------------------------------------
-     * Step 2: Create context with a device of the specified type.
-     * Required device type is passed as function argument required_device_type.
-     * Use this function to create context for any CPU or GPU OpenCL device.
-     */
-    cl_context_properties context_props[] = {
-            CL_CONTEXT_PLATFORM,
-            cl_context_properties(cl.platform),
-            0
-    };
-    cl.context = clCreateContextFromType
-            (
-                    context_props,
-                    CL_DEVICE_TYPE_GPU, //Searching sepcifically for GPU
-                    0,
-                    0,
-                    &err
-            );
-    if (err == CL_DEVICE_NOT_AVAILABLE || err == CL_DEVICE_NOT_FOUND) return 0;
-    SAMPLE_CHECK_ERRORS(err);
+    if (size <= vec.capacity) {
+        vec.size = size;
+        return 1;
+    }
 
-    /* -----------------------------------------------------------------------
-     * Step 3: Query for OpenCL device that was used for context creation.
-     */
-    err = clGetContextInfo
-            (
-                    cl.context,
-                    CL_CONTEXT_DEVICES,
-                    sizeof(cl.device),
-                    &cl.device,
-                    0
-            );
+    cl_ulong maxCapacity = gpu.maxAllocSize / elementSize;
+    cl_ulong capacity = std::max(vec.capacity * 2, size);
+    if (capacity > maxCapacity) capacity = maxCapacity;
+    if (size > capacity) {
+        LOGE("%llu elements exceed the maximum allocation of %llu\n",
+             (unsigned long long) size, (unsigned long long) maxCapacity);
+        return 0;
+    }
 
-    err = clGetDeviceInfo
-            (
-                    cl.device,
-                    CL_DEVICE_NAME,
-                    sizeof(gpu.name),
-                    gpu.name,
-                    NULL
-            );
+    cl_mem buffer = bufferPool.allocate(capacity * elementSize, flags, &err);
     SAMPLE_CHECK_ERRORS(err);
-    LOGD("CL_DEVICE_NAME: %s", gpu.name );
 
-    err = clGetDeviceInfo
-            (
-                    cl.device,
-                    CL_DEVICE_MAX_COMPUTE_UNITS,
-                    sizeof(gpu.computeUnits),
-                    &gpu.computeUnits,
-                    NULL
-            );
-    SAMPLE_CHECK_ERRORS(err);
-    LOGD("Total Cores: %d", gpu.computeUnits );
+    if (vec.size > 0) {
+        err = clEnqueueCopyBuffer
+                (
+                        cl.queue, // command_queue
+                        vec.buffer, // src_buffer
+                        buffer, // dst_buffer
+                        0, // src_offset
+                        0, // dst_offset
+                        vec.size * elementSize, // cb
+                        0, // num_events_in_wait_list
+                        NULL, // *event_wait_list
+                        NULL // *event
+                );
+        if (err != CL_SUCCESS) bufferPool.release(buffer);
+        SAMPLE_CHECK_ERRORS(err);
+    }
 
-    err = clGetDeviceInfo
-            (
-                    cl.device,
-                    CL_DEVICE_GLOBAL_MEM_SIZE,
-                    sizeof(gpu.globalMem),
-                    &gpu.globalMem,
-                    NULL
-            );
-    SAMPLE_CHECK_ERRORS(err);
-    LOGD("Global Memory Size (bytes): %lu", (unsigned long) gpu.globalMem );
+    // The in-order queue finishes the copy before the old buffer can be handed out again
+    bufferPool.release(vec.buffer);
+    vec.buffer = buffer;
+    vec.capacity = bufferPool.capacity(buffer) / elementSize;
+    vec.size = size;
+    return 1;
+}
 
-    err = clGetDeviceInfo
-            (
-                    cl.device,
-                    CL_DEVICE_LOCAL_MEM_SIZE,
-                    sizeof(gpu.localMem),
-                    &gpu.localMem,
-                    NULL
-            );
-    SAMPLE_CHECK_ERRORS(err);
-    LOGD("Local Memory Size (bytes): %lu", (unsigned long) gpu.localMem );
+/*
+ * Resize a host array to capacity elements, keeping its first keep elements.
+ * The array starts on the device base address alignment, so it can be wrapped in place.
+ */
+int growHost(float *&array, cl_ulong capacity, cl_ulong keep)
+{
+    void *grown = NULL;
+    size_t align = (size_t) std::max<cl_ulong>(gpu.memBaseAlign, sizeof(void *));
+    if (capacity > SIZE_MAX / sizeof(float) || posix_memalign(&grown, align, capacity * sizeof(float)) != 0) {
+        LOGE("Cannot allocate %llu host elements\n", (unsigned long long) capacity);
+        return 0;
+    }
+    if (array != NULL) std::copy(array, array + std::min(keep, capacity), (float *) grown);
+    free(array);
+    array = (float *) grown;
+    return 1;
+}
 
-    err = clGetDeviceInfo
-            (
-                    cl.device,
-                    CL_DEVICE_MAX_MEM_ALLOC_SIZE,
-                    sizeof(gpu.maxAllocSize),
-                    &gpu.maxAllocSize,
-                    NULL
-            );
-    SAMPLE_CHECK_ERRORS(err);
-    LOGD("Maximum memory allocation (bytes): %lu", (unsigned long) gpu.maxAllocSize );
+/*
+ * Write count floats at begin of a device vector, narrowed to halves first if half is set.
+ */
+int writeElements(cl_mem buffer, cl_ulong begin, cl_ulong count, const float *values, bool half)
+{
+    if (half) return writeHalfRange(buffer, begin, count, values);
+    if (count == 0) return 1;
 
-    err = clGetDeviceInfo
+    cl_int err = clEnqueueWriteBuffer
             (
-                    cl.device,
-                    CL_DEVICE_HOST_UNIFIED_MEMORY,
-                    sizeof(gpu.unifiedMem),
-                    &gpu.unifiedMem,
-                    NULL
+                    cl.queue, // command_queue
+                    buffer, // buffer
+                    true, // blocking_write
+                    begin * sizeof(float), // offset
+                    count * sizeof(float), // cb
+                    values, // *ptr
+                    0, // num_events_in_wait_list
+                    NULL, // *event_wait_list
+                    NULL // *event
             );
     SAMPLE_CHECK_ERRORS(err);
+    return 1;
+}
 
-    /* -----------------------------------------------------------------------
-     * Step 4: Create OpenCL program from its source code.
-     * The file name is passed by java.
-     * Convert the jstring to const char* and append the needed directory path.
-     */
-    const char* fileName = env->GetStringUTFChars(kernelName, 0);
-    std::string fileDir;
-    fileDir.append("/data/data/com.example.jonny.updateweights/app_execdir/");
-    fileDir.append(fileName);
-    std::string kernelSource = loadProgram(fileDir);
-    //std::string to const char* needed for the clCreateProgramWithSource function
-    const char* kernelSourceChar = kernelSource.c_str();
+/*
+ * Fill input elements [begin, end) with random values and upload them.
+ * Tiled W streams the input from the host, so there is nothing to upload.
+ */
+int randomizeInput(cl_ulong begin, cl_ulong end)
+{
+    for (cl_ulong i = begin; i < end; ++i) {
+        inputCpu[i] = static_cast <float> (rand()) / static_cast <float> (RAND_MAX);
+    }
+    if (tiled) return 1;
+    return writeElements(inputVector.buffer, begin, end - begin, inputCpu + begin, storageW.enabled);
+}
 
-    cl.program = clCreateProgramWithSource
+/*
+ * Number of elements in W, wherever it is stored.
+ */
+cl_ulong sizeW()
+{
+    return tiled ? tiledW.size : wGpu.size;
+}
+
+/*
+ * Return the device storage of W and the input vector.
+ */
+void releaseW()
+{
+    if (tiled) releaseTiledW(tiledW);
+    tiled = false;
+    bufferPool.release(wGpu.buffer);
+    bufferPool.release(inputVector.buffer);
+    wGpu = W();
+    inputVector = W();
+}
+
+/*
+ * Whether size elements of W, and of the input, fit in a single device allocation.
+ */
+bool fitsDevice(cl_ulong size)
+{
+    return size <= gpu.maxAllocSize / bytesPerElement(storageW);
+}
+
+/*
+ * Flag the tiles holding elements [begin, end) as modified since the last checkpoint.
+ */
+void markDirty(cl_ulong begin, cl_ulong end)
+{
+    if (begin >= end) return;
+    std::fill
             (
-                    cl.context,
-                    1,
-                    &kernelSourceChar,
-                    0,
-                    &err
+                    dirtyTiles.begin() + (begin >> DIRTY_TILE_SHIFT),
+                    dirtyTiles.begin() + ((end - 1) >> DIRTY_TILE_SHIFT) + 1,
+                    1
             );
+}
+
+/*
+ * Mark the state file as being written before tiled W mapped from it first changes after a checkpoint.
+ * Otherwise a crash would leave newer elements behind a clean header with the old count and weight.
+ */
+int unsealState()
+{
+    if (!tiled || tiledW.ownsHost || state.header == NULL || !state.header->clean) return 1;
+    return beginCheckpoint(state);
+}
 
+/*
+ * Bring elements [begin, begin + count) of a lazily decayed W up to date, leaving the
+ * CPU reference as it is. Safe under stepMutex alone, unlike the reference, which a
+ * step may still be updating on the thread pool after releasing it.
+ */
+int settleDevice(cl_ulong begin, cl_ulong count)
+{
+    if (averagingMode != MODE_LAZY_EMA || count == 0 || !gpuTesting) return 1;
+
+    std::lock_guard<std::mutex> settle(settleMutex);
+    if (tiled) {
+        if (!unsealState()) return 0;
+        settleHost(lazy, tiledW.host, begin, count, t);
+        markDirty(begin, begin + count);
+        return 1;
+    }
+    cl_int err = enqueueSettle(lazy, wGpu.buffer, dirtyBuffer, begin, count, t);
     SAMPLE_CHECK_ERRORS(err);
+    return 1;
+}
 
-    /* -----------------------------------------------------------------------
-     * Step 5: Build the program.
-     * During creation a program is not built. Call the build function explicitly.
+/*
+ * Bring elements [begin, begin + count) of a lazily decayed W and CPU reference up to date,
+ * so they can be read. Does nothing in the other modes, where W is always up to date.
+ */
+int settleW(cl_ulong begin, cl_ulong count)
+{
+    if (averagingMode != MODE_LAZY_EMA || count == 0) return 1;
+
+    if (cpuTesting) {
+        std::lock_guard<std::mutex> settle(settleMutex);
+        settleHost(cpuLazy, wCpu, begin, count, t);
+        if (!gpuTesting) markDirty(begin, begin + count);
+    }
+    return settleDevice(begin, count);
+}
+
+/*
+ * Whether resident W is stored as halves.
+ */
+bool halfW()
+{
+    return !tiled && storageW.enabled;
+}
+
+/*
+ * Read count elements of W starting at begin into values.
+ */
+int readW(cl_ulong begin, cl_ulong count, float *values)
+{
+    if (!settleW(begin, count)) return 0;
+    if (tiled) {
+        std::copy(tiledW.host + begin, tiledW.host + begin + count, values);
+        return 1;
+    }
+    if (halfW()) return readHalfRange(wGpu.buffer, begin, count, values);
+    return readRange(wGpu.buffer, begin, count, values);
+}
+
+/*
+ * Read count blocks of width elements of W, stride elements apart, into values.
+ */
+int readWStrided(cl_ulong begin, cl_ulong width, cl_ulong stride, cl_ulong count, float *values)
+{
+    if (count > 0 && !settleW(begin, (count - 1) * stride + width)) return 0;
+    if (tiled) {
+        for (cl_ulong b = 0; b < count; ++b) {
+            const float *block = tiledW.host + begin + b * stride;
+            std::copy(block, block + width, values + b * width);
+        }
+        return 1;
+    }
+    if (halfW()) return readHalfStrided(wGpu.buffer, begin, width, stride, count, values);
+    return readStrided(wGpu.buffer, begin, width, stride, count, values);
+}
+
+/*
+ * Read the elements of W at the given indices into values.
+ */
+int gatherW(const std::vector<uint64_t> &indices, float *values)
+{
+    // The indices may be anywhere, so all of W is settled
+    if (!indices.empty() && !settleW(0, sizeW())) return 0;
+    if (tiled) {
+        for (size_t j = 0; j < indices.size(); ++j) values[j] = tiledW.host[indices[j]];
+        return 1;
+    }
+    if (halfW()) return readHalfGather(wGpu.buffer, indices.data(), indices.size(), values);
+    return readGather(wGpu.buffer, indices.data(), indices.size(), values);
+}
+
+/*
+ * Restart an open delta stream over the current W, with every element published as it is now.
+ * Called whenever W is created or changes size.
+ */
+int resetDeltas()
+{
+    if (!deltas.active) return 1;
+    bool onHost = tiled || !gpuTesting;
+    return openDeltaStream(deltas, onHost ? NULL : wGpu.buffer, gpuTesting ? tiledW.host : wCpu, sizeW(),
+                           t > 0, deltas.epsilon, deltas.capacity);
+}
+
+/*
+ * Restart the extra horizons of an exponential moving average from the current W.
+ * Called whenever W is created or changes size, and when the averaging mode changes.
+ */
+int resetHorizons()
+{
+    cl_ulong size = sizeW();
+    if (averagingMode != MODE_EMA || horizons.alphas.size() <= 1 || size == 0) {
+        closeHorizons(horizons);
+        return 1;
+    }
+
+    // Next to resident W when they fit, otherwise on the host
+    cl_ulong extra = horizons.alphas.size() - 1;
+    bool onDevice = gpuTesting && !tiled && fitsDevice(size * extra);
+    const float *host = !gpuTesting ? wCpu : tiled ? tiledW.host : NULL;
+    std::vector<float> resident;
+    if (!onDevice && host == NULL && t > 0) {
+        resident.resize((size_t) size);
+        if (!readW(0, size, resident.data())) return 0;
+        host = resident.data();
+    }
+    return openHorizons(horizons, onDevice ? wGpu.buffer : NULL, host, size, t > 0, onDevice);
+}
+
+/*
+ * Empty the sliding windows of W and of the CPU reference, and size them to the current W.
+ * Called whenever W is created or changes size, and when the averaging mode changes.
+ */
+int resetWindow()
+{
+    cl_ulong size = sizeW();
+    closeWindow(window);
+    closeWindow(cpuWindow);
+    if (averagingMode != MODE_WINDOW || size == 0) return 1;
+
+    // The CPU reference keeps a ring of its own, with the same settings
+    cpuWindow = window;
+    if (gpuTesting && !openWindow(window, size, !tiled)) return 0;
+    if (cpuTesting && !openWindow(cpuWindow, size, false)) return 0;
+    return 1;
+}
+
+/*
+ * Start every element of a lazily decayed W out as up to date at the current step.
+ * Called whenever W is created or changes size, and when the averaging mode changes.
+ */
+int resetLazy()
+{
+    cl_ulong size = sizeW();
+    closeLazyDecay(lazy);
+    closeLazyDecay(cpuLazy);
+    if (averagingMode != MODE_LAZY_EMA || size == 0) return 1;
+    if (size > CL_UINT_MAX) {
+        LOGE("A lazily decayed average indexes at most %u elements\n", CL_UINT_MAX);
+        return 0;
+    }
+
+    // Inputs absent from a step count as 0, so a new average starts out at 0 rather than at its first input
+    bool zero = t == 0;
+    if (zero && !unsealState()) return 0;
+    if (gpuTesting && !openLazyDecay(lazy, tiled ? NULL : wGpu.buffer, tiledW.host, size, t, zero)) return 0;
+    cpuLazy.alpha = lazy.alpha;
+    if (cpuTesting && !openLazyDecay(cpuLazy, NULL, wCpu, size, t, zero)) return 0;
+    if (zero && (tiled || !gpuTesting)) markDirty(0, size);
+    return 1;
+}
+
+/*
+ * Start the per-element totals of W and of the CPU reference out at the weight of all steps so far.
+ * Called whenever W is created or changes size, and when the averaging mode changes.
+ */
+int resetCounts()
+{
+    cl_ulong size = sizeW();
+    closeElementCounts(counts);
+    closeElementCounts(cpuCounts);
+    if (averagingMode != MODE_PER_ELEMENT || size == 0) return 1;
+    if (size > CL_UINT_MAX) {
+        LOGE("A mean kept per element indexes at most %u elements\n", CL_UINT_MAX);
+        return 0;
+    }
+
+    // Every element has had every input so far. Elements never given one read as 0.
+    bool zero = t == 0;
+    float initial = (float) totalWeight;
+    if (zero && !unsealState()) return 0;
+    if (gpuTesting && !openElementCounts(counts, tiled ? NULL : wGpu.buffer, tiledW.host, size, initial, zero)) {
+        return 0;
+    }
+    if (cpuTesting && !openElementCounts(cpuCounts, NULL, wCpu, size, initial, zero)) return 0;
+    if (zero && (tiled || !gpuTesting)) markDirty(0, size);
+    return 1;
+}
+
+/*
+ * Convert resident W and the input vector to halves or back to floats through the host, keeping
+ * their values up to rounding. Tiled W stays in floats; the setting takes effect once W is resident again.
+ */
+int repackW(bool half)
+{
+    cl_ulong size = wGpu.size;
+    if (tiled || half == storageW.enabled || wGpu.buffer == NULL) {
+        storageW.enabled = half;
+        return 1;
+    }
+
+    std::vector<float> values((size_t) size);
+    if (!readW(0, size, values.data())) return 0;
+
+    // Both are written before either replaces the old one, so a failure leaves W as it was.
+    // Halves are refused when W or the input holds values beyond their range.
+    HalfStorage previous = storageW;
+    storageW.enabled = half;
+    size_t bytes = bytesPerElement(storageW);
+    W packed = W();
+    W packedInput = W();
+    if (!growBuffer(packed, size, wFlags(), bytes) || !growBuffer(packedInput, size, inputFlags(), bytes)
+            || !writeElements(packed.buffer, 0, size, values.data(), half)
+            || !writeElements(packedInput.buffer, 0, size, inputCpu, half)) {
+        bufferPool.release(packed.buffer);
+        bufferPool.release(packedInput.buffer);
+        storageW = previous;
+        return 0;
+    }
+
+    bufferPool.release(wGpu.buffer);
+    bufferPool.release(inputVector.buffer);
+    wGpu = packed;
+    inputVector = packedInput;
+    markDirty(0, size);
+    return 1;
+}
+
+/*
+ * Record the change of a step that was not measured as part of it, from the input of share alpha
+ * and W after the step. input is on the host and, for resident W, inputBuffer on the device.
+ */
+int measureChange(const float *input, cl_mem inputBuffer, float alpha, cl_ulong step)
+{
+    cl_ulong size = sizeW();
+
+    // The input replaced W, which may not have held anything before
+    if (alpha >= 1.0f) {
+        recordChange(convergence, step, DBL_MAX, DBL_MAX);
+        return 1;
+    }
+
+    ArrayStats residual;
+    if (gpuTesting && !tiled) {
+        if (!deviceStats(inputBuffer, wGpu.buffer, size, residual)) return 0;
+    } else {
+        hostStats(input, gpuTesting ? tiledW.host : wCpu, (size_t) size, residual);
+    }
+
+    double scale = alpha / (1.0 - alpha);
+    recordChange(convergence, step, scale * residual.maxDifference, scale * std::sqrt(residual.differenceSquares));
+    return 1;
+}
+
+/*
+ * The snapshot with the given handle, or an empty pointer if there is none.
+ */
+std::shared_ptr<Snapshot> findSnapshot(jlong handle)
+{
+    std::lock_guard<std::mutex> lock(snapshotMutex);
+    std::map<jlong, std::shared_ptr<Snapshot>>::iterator found = snapshots.find(handle);
+    if (found == snapshots.end()) {
+        LOGE("No snapshot %lld\n", (long long) handle);
+        return std::shared_ptr<Snapshot>();
+    }
+    return found->second;
+}
+
+/*
+ * Draw a new sample of W for the shadow and start it from the current W.
+ * Called whenever W is created or changes size while sampled verification is on.
+ */
+int resampleShadow()
+{
+    if (verifySamples == 0) {
+        shadow = ShadowSample();
+        return 1;
+    }
+    drawSample(shadow, sizeW(), verifySamples, shadow.stratified);
+    return gatherW(shadow.indices, shadow.values.data());
+}
+
+/*
+ * Merge the flags the kernels set in dirtyBuffer into dirtyTiles and clear them.
+ */
+int collectDirty()
+{
+    if (dirtyBuffer == NULL || dirtyTiles.empty()) return 1;
+
+    cl_int err;
+    std::vector<cl_uchar> flags(dirtyTiles.size());
+    err = clEnqueueReadBuffer
+            (
+                    cl.queue, // command_queue
+                    dirtyBuffer, // buffer
+                    true, // blocking_read
+                    0, // offset
+                    flags.size(), // cb
+                    &flags[0], // *ptr
+                    0, // num_events_in_wait_list
+                    NULL, // *event_wait_list
+                    NULL // *event
+            );
+    SAMPLE_CHECK_ERRORS(err);
+
+    for (size_t i = 0; i < flags.size(); ++i) dirtyTiles[i] |= flags[i];
+
+    const cl_uchar zero = 0;
+    err = clEnqueueFillBuffer(cl.queue, dirtyBuffer, &zero, 1, 0, flags.size(), 0, NULL, NULL);
+    SAMPLE_CHECK_ERRORS(err);
+    return 1;
+}
+
+/*
+ * Size the dirty flags for W going from oldSize to size elements.
+ * Flags of existing tiles are kept and added elements are dirty.
+ */
+int resizeDirty(cl_ulong oldSize, cl_ulong size)
+{
+    cl_int err;
+    if (!collectDirty()) return 0;
+
+    size_t tiles = (size_t) ((size + DIRTY_TILE_SIZE - 1) >> DIRTY_TILE_SHIFT);
+    dirtyTiles.resize(tiles, 0);
+    if (oldSize < size) markDirty(oldSize, size);
+
+    // Tiled W marks its tiles on the host
+    bufferPool.release(dirtyBuffer);
+    dirtyBuffer = NULL;
+    if (tiled || tiles == 0) return 1;
+
+    dirtyBuffer = bufferPool.allocate(tiles, CL_MEM_READ_WRITE, &err);
+    SAMPLE_CHECK_ERRORS(err);
+    const cl_uchar zero = 0;
+    err = clEnqueueFillBuffer(cl.queue, dirtyBuffer, &zero, 1, 0, tiles, 0, NULL, NULL);
+    SAMPLE_CHECK_ERRORS(err);
+    return 1;
+}
+
+/*
+ * Device buffer using host input in place, for resident W on a device sharing
+ * memory with the host. NULL if the input cannot be wrapped, e.g. when misaligned.
+ */
+cl_mem wrapInput(const float *input)
+{
+    cl_ulong bytes = sizeW() * sizeof(float);
+    if (!gpu.unifiedMem || bytes > gpu.maxAllocSize) return NULL;
+    if ((uintptr_t) input % gpu.memBaseAlign != 0) return NULL;
+
+    cl_int err;
+    cl_mem buffer = clCreateBuffer
+            (
+                    cl.context,
+                    CL_MEM_READ_ONLY | CL_MEM_USE_HOST_PTR,
+                    bytes,
+                    (void *) input,
+                    &err
+            );
+    return err == CL_SUCCESS ? buffer : NULL;
+}
+
+/*
+ * Make host input of sizeW() elements the input of the next step. For resident W,
+ * inputBuffer is set to a device buffer holding it: the input wrapped in place where
+ * possible, otherwise a pooled buffer after a non-blocking write, or narrowed to halves
+ * for half W. Either way input has to stay valid until the step has finished.
+ * inputVector keeps the synthesized input for the steps that reuse it.
+ */
+int stageInput(const float *input, cl_mem &inputBuffer)
+{
+    inputBuffer = inputVector.buffer;
+    if (!gpuTesting || tiled) return 1;
+
+    cl_mem wrapped = halfW() ? NULL : wrapInput(input);
+    if (wrapped != NULL) {
+        inputBuffer = wrapped;
+        return 1;
+    }
+
+    cl_int err;
+    cl_mem staging = bufferPool.allocate((size_t) (sizeW() * bytesPerElement(storageW)), CL_MEM_READ_ONLY, &err);
+    SAMPLE_CHECK_ERRORS(err);
+
+    // Half W reads its input as halves too, narrowed on the host
+    if (halfW()) {
+        if (!writeHalfRange(staging, 0, sizeW(), input)) {
+            bufferPool.release(staging);
+            return 0;
+        }
+        inputBuffer = staging;
+        return 1;
+    }
+
+    err = clEnqueueWriteBuffer
+            (
+                    cl.queue, // command_queue
+                    staging, // buffer
+                    false, // blocking_write
+                    0, // offset
+                    sizeW() * sizeof(float), // cb
+                    input, // *ptr
+                    0, // num_events_in_wait_list
+                    NULL, // *event_wait_list
+                    NULL // *event
+            );
+    if (err != CL_SUCCESS) bufferPool.release(staging);
+    SAMPLE_CHECK_ERRORS(err);
+    inputBuffer = staging;
+    return 1;
+}
+
+/*
+ * Queue kernel, UpdateWeights or UpdateWeightsDelta, blending inputBuffer into resident W
+ * with share alpha of the result.
+ */
+cl_int enqueueUpdate(cl_kernel kernel, cl_mem inputBuffer, float alpha, cl_ulong size)
+{
+    cl_int err;
+
+    // Set kernel arguments
+    err = clSetKernelArg
+            (
+                    kernel,
+                    0,
+                    sizeof(wGpu.buffer),
+                    &wGpu.buffer
+            );
+    err |= clSetKernelArg
+            (
+                    kernel,
+                    1,
+                    sizeof(inputBuffer),
+                    &inputBuffer
+            );
+    err |= clSetKernelArg
+            (
+                    kernel,
+                    2,
+                    sizeof(float),
+                    &alpha
+            );
+    err |= clSetKernelArg
+            (
+                    kernel,
+                    3,
+                    sizeof(dirtyBuffer),
+                    &dirtyBuffer
+            );
+    if (deltas.active) {
+        err |= clSetKernelArg(kernel, 4, sizeof(cl_mem), &deltas.published);
+        err |= clSetKernelArg(kernel, 5, sizeof(float), &deltas.epsilon);
+        err |= clSetKernelArg(kernel, 6, sizeof(cl_mem), &deltas.indices);
+        err |= clSetKernelArg(kernel, 7, sizeof(cl_mem), &deltas.values);
+        err |= clSetKernelArg(kernel, 8, sizeof(cl_mem), &deltas.count);
+        err |= clSetKernelArg(kernel, 9, sizeof(cl_uint), &deltas.capacity);
+    }
+
+    // Run kernel
+    size_t globalDimensions[3] = {(size_t) size, 1, 1};
+    if (err == CL_SUCCESS) err = clEnqueueNDRangeKernel
+            (
+                    cl.queue, // command_queue
+                    kernel, // kernel
+                    3, // work_dim
+                    NULL, // *global_work_offset
+                    globalDimensions, // *global_work_size
+                    NULL, // *local_work_size
+                    0, // num_events_in_wait_list
+                    NULL, // *event_wait_list
+                    NULL // *event
+            );
+    return err;
+}
+
+/*
+ * Whether W takes sparse inputs, whose steps leave most of its elements untouched.
+ */
+bool sparseMode()
+{
+    return averagingMode == MODE_LAZY_EMA || averagingMode == MODE_PER_ELEMENT;
+}
+
+/*
+ * Whether the change of a step can be measured from its input and W after it. Neither holds
+ * for a sliding window, whose step also drops an old input, nor for a lazily decayed W.
+ */
+bool measurable()
+{
+    return averagingMode == MODE_CUMULATIVE || averagingMode == MODE_EMA;
+}
+
+/*
+ * Average one input of the given weight into W on the CPU and GPU, as enabled.
+ * input holds the elements on the host and, for resident W, inputBuffer on the device.
+ * A buffer other than inputVector is released once the step has finished.
+ */
+int applyInput(const float *input, cl_mem inputBuffer, float weight)
+{
+    cl_int err = CL_SUCCESS;
+    cl_ulong size = sizeW();
+
+    // An input without weight leaves the average as it is
+    if (weight == 0 || !unsealState()) {
+        if (inputBuffer != inputVector.buffer) bufferPool.release(inputBuffer);
+        return weight == 0;
+    }
+
+    // t and the commands of the step are queued together, so a snapshot sees whole steps
+    std::unique_lock<std::mutex> step(stepMutex);
+
+    // Share of the input in the new average; 1/t when every input weighs 1
+    ++t;
+    totalWeight += weight;
+    float alpha = averagingMode == MODE_EMA ? emaShare(horizons.alphas[0], weight, t)
+                  : averagingMode == MODE_LAZY_EMA ? lazy.alpha
+                  : (float) (weight / totalWeight);
+    float shares[EMA_MAX_HORIZONS];
+    for (cl_uint h = 0; h < horizons.extra; ++h) shares[h] = emaShare(horizons.alphas[h + 1], weight, t);
+    cl_ulong stepIndex = t;
+    bool monitored = false;
+    bool fused = false;
+
+    // Set time values
+    std::chrono::system_clock::time_point gpuStart, gpuEnd;
+    std::chrono::steady_clock::time_point cpuStart;
+
+    // The CPU reference runs on the thread pool while the GPU works, and is joined below
+    std::shared_ptr<ThreadPool::Job> cpuJob;
+    if (cpuTesting && averagingMode == MODE_WINDOW)
+    {
+        cpuStart = std::chrono::steady_clock::now();
+        cpuJob = updateHostWindow(cpuWindow, input, wCpu, size);
+    }
+    else if (cpuTesting && averagingMode == MODE_PER_ELEMENT)
+    {
+        cpuStart = std::chrono::steady_clock::now();
+        cpuJob = updateHostCounted(cpuCounts, wCpu, NULL, input, size, weight);
+    }
+    else if (cpuTesting && averagingMode == MODE_LAZY_EMA)
+    {
+        cpuStart = std::chrono::steady_clock::now();
+        cpuJob = updateHostLazy(cpuLazy, wCpu, NULL, input, size, t);
+    }
+    else if (cpuTesting)
+    {
+        cpuStart = std::chrono::steady_clock::now();
+        cpuJob = threadPool.parallelFor
+                (
+                        0,
+                        (size_t) size,
+                        CPU_GRAIN,
+                        [input, alpha](size_t begin, size_t end) {
+                            if (alpha >= 1.0f) {
+                                // Average of a single input is the input itself
+                                std::copy(input + begin, input + end, wCpu + begin);
+                                return;
+                            }
+                            for (size_t i = begin; i < end; ++i) {
+                                wCpu[i] = ((1 - alpha) * wCpu[i]) + (alpha * input[i]);
+                            }
+                        }
+                );
+    }
+
+    // Extra horizons kept on the host are blended in alongside
+    std::shared_ptr<ThreadPool::Job> horizonJob;
+    if (!horizons.host.empty()) horizonJob = blendHostHorizons(horizons, input, shares, size);
+
+    // The sampled shadow is small enough to update in line
+    if (verifySamples > 0) updateShadow(shadow, input, alpha);
+
+    if (gpuTesting)
+    {
+        if (timer) gpuStart = std::chrono::system_clock::now();
+        if (averagingMode == MODE_WINDOW && tiled) {
+            // Tiled W lives on the host, and so does its window
+            updateHostWindow(window, input, tiledW.host, size)->wait();
+        } else if (averagingMode == MODE_WINDOW) {
+            err = enqueueWindowUpdate(window, wGpu.buffer, inputBuffer, dirtyBuffer, size);
+
+            // Share 0 leaves W as it is, so the delta kernel only compares it against the published values
+            if (deltas.active && err == CL_SUCCESS) err = enqueueUpdate(cl.updateWeightsDelta, wGpu.buffer, 0.0f, size);
+        } else if (averagingMode == MODE_LAZY_EMA && tiled) {
+            updateHostLazy(lazy, tiledW.host, NULL, input, size, t)->wait();
+        } else if (averagingMode == MODE_LAZY_EMA) {
+            // A dense input touches every element, bringing all of W up to date
+            err = enqueueLazyUpdate(lazy, wGpu.buffer, dirtyBuffer, NULL, inputBuffer, size, t);
+        } else if (averagingMode == MODE_PER_ELEMENT && tiled) {
+            updateHostCounted(counts, tiledW.host, NULL, input, size, weight)->wait();
+        } else if (averagingMode == MODE_PER_ELEMENT) {
+            err = enqueueCountedUpdate(counts, wGpu.buffer, dirtyBuffer, NULL, inputBuffer, size, weight);
+        } else if (tiled) {
+            // Tiled W sets the arguments of every tile itself
+            err = updateTiledW(tiledW, input, alpha) ? CL_SUCCESS : CL_OUT_OF_RESOURCES;
+        } else if (halfW()) {
+            err = enqueueHalfUpdate(storageW, wGpu.buffer, inputBuffer, alpha, dirtyBuffer, t, size);
+        } else if (alpha >= 1.0f && !deltas.active) {
+            // W may be uninitialized, so copy rather than scale it by 1 - alpha = 0
+            err = clEnqueueCopyBuffer
+                    (
+                            cl.queue, // command_queue
+                            inputBuffer, // src_buffer
+                            wGpu.buffer, // dst_buffer
+                            0, // src_offset
+                            0, // dst_offset
+                            wGpu.size * sizeof(float), // cb
+                            0, // num_events_in_wait_list
+                            NULL, // *event_wait_list
+                            NULL // *event
+                    );
+            markDirty(0, size);
+        } else if (convergence.active && !deltas.active && size <= CL_UINT_MAX) {
+            // The change is reduced as W is updated, saving a second pass over it
+            err = enqueueMonitoredUpdate(convergence, wGpu.buffer, inputBuffer, alpha, dirtyBuffer, size);
+            monitored = true;
+        } else if (horizons.buffer != NULL && !deltas.active) {
+            // W and the extra horizons read the input once between them
+            err = enqueueEmaUpdate(horizons, wGpu.buffer, inputBuffer, alpha, dirtyBuffer, shares, size);
+            fused = true;
+        } else {
+            // The delta variant also reports elements that moved past the subscriber's epsilon
+            err = enqueueUpdate(deltas.active ? cl.updateWeightsDelta : cl.updateWeights, inputBuffer, alpha, size);
+        }
+        if (horizons.buffer != NULL && !fused && err == CL_SUCCESS) {
+            err = enqueueEmaUpdate(horizons, NULL, inputBuffer, alpha, NULL, shares, size);
+        }
+        step.unlock();
+        clFinish(cl.queue);
+        if (monitored) {
+            finishMonitoredUpdate(convergence, stepIndex, err == CL_SUCCESS);
+        } else if (convergence.active && measurable() && !tiled && err == CL_SUCCESS) {
+            // Measured from the input, which is released below
+            if (!measureChange(input, inputBuffer, alpha, stepIndex)) err = CL_OUT_OF_RESOURCES;
+        }
+        if (inputBuffer != inputVector.buffer) bufferPool.release(inputBuffer);
+        if (timer) gpuEnd = std::chrono::system_clock::now();
+        if (timer)
+            gpuTime += std::chrono::duration_cast<std::chrono::milliseconds>(
+                    gpuEnd - gpuStart).count();
+    }
+
+    // Inputs only live for their step, so the CPU reference is joined before returning
+    if (cpuJob) {
+        cpuJob->wait();
+        if (timer)
+            cpuTime += std::chrono::duration_cast<std::chrono::milliseconds>(
+                    cpuJob->finishTime() - cpuStart).count();
+    }
+    if (horizonJob) horizonJob->wait();
+    SAMPLE_CHECK_ERRORS(err);
+
+    // W updated on the host is compared against the published values once complete
+    if (deltas.active && (tiled || !gpuTesting)) {
+        if (!step.owns_lock()) step.lock();
+        collectHostDeltas(deltas, gpuTesting ? tiledW.host : wCpu, size);
+    }
+    if (convergence.active && measurable() && (tiled || (!gpuTesting && cpuTesting))) {
+        measureChange(input, NULL, alpha, stepIndex);
+    }
+
+    // Kernels flag the tiles of resident W; everything else is written in full
+    if (tiled || !gpuTesting) markDirty(0, size);
+    return 1;
+}
+
+/*
+ * Take one step with inputs only at the given elements. A lazily decayed average counts every
+ * other element as given 0, a mean kept per element leaves them as they are. indices are sorted
+ * and distinct; only they are touched, on the GPU and by the CPU reference alike.
+ */
+int applySparse(const std::vector<uint64_t> &indices, const std::vector<float> &values)
+{
+    cl_int err = CL_SUCCESS;
+    cl_ulong count = indices.size();
+    if (!unsealState()) return 0;
+
+    std::unique_lock<std::mutex> step(stepMutex);
+    ++t;
+    totalWeight += 1;
+    unsigned int now = t;
+    bool perElement = averagingMode == MODE_PER_ELEMENT;
+
+    std::chrono::system_clock::time_point gpuStart, gpuEnd;
+    std::chrono::steady_clock::time_point cpuStart;
+
+    // The CPU reference is lazy too, so a step costs as much as its inputs on either side
+    std::shared_ptr<ThreadPool::Job> cpuJob;
+    if (cpuTesting && perElement)
+    {
+        cpuStart = std::chrono::steady_clock::now();
+        cpuJob = updateHostCounted(cpuCounts, wCpu, indices.data(), values.data(), count, 1.0f);
+    }
+    else if (cpuTesting)
+    {
+        cpuStart = std::chrono::steady_clock::now();
+        cpuJob = updateHostLazy(cpuLazy, wCpu, indices.data(), values.data(), count, now);
+    }
+
+    if (gpuTesting)
+    {
+        if (timer) gpuStart = std::chrono::system_clock::now();
+        if (tiled && perElement) {
+            updateHostCounted(counts, tiledW.host, indices.data(), values.data(), count, 1.0f)->wait();
+            for (uint64_t i : indices) markDirty(i, i + 1);
+        } else if (tiled) {
+            updateHostLazy(lazy, tiledW.host, indices.data(), values.data(), count, now)->wait();
+            for (uint64_t i : indices) markDirty(i, i + 1);
+        } else if (count > 0) {
+            // Indices go to the device as 32 bits, which every W taking sparse inputs fits
+            std::vector<uint32_t> narrow(indices.begin(), indices.end());
+            cl_mem indexBuffer = bufferPool.allocate(count * sizeof(cl_uint), CL_MEM_READ_ONLY, &err);
+            cl_mem valueBuffer = NULL;
+            if (err == CL_SUCCESS) valueBuffer = bufferPool.allocate(count * sizeof(float), CL_MEM_READ_ONLY, &err);
+            if (err == CL_SUCCESS) {
+                err = clEnqueueWriteBuffer
+                        (
+                                cl.queue, // command_queue
+                                indexBuffer, // buffer
+                                false, // blocking_write
+                                0, // offset
+                                count * sizeof(cl_uint), // cb
+                                narrow.data(), // *ptr
+                                0, // num_events_in_wait_list
+                                NULL, // *event_wait_list
+                                NULL // *event
+                        );
+                err |= clEnqueueWriteBuffer
+                        (
+                                cl.queue, // command_queue
+                                valueBuffer, // buffer
+                                false, // blocking_write
+                                0, // offset
+                                count * sizeof(float), // cb
+                                values.data(), // *ptr
+                                0, // num_events_in_wait_list
+                                NULL, // *event_wait_list
+                                NULL // *event
+                        );
+            }
+            if (err == CL_SUCCESS && perElement) {
+                err = enqueueCountedUpdate(counts, wGpu.buffer, dirtyBuffer, indexBuffer, valueBuffer, count, 1.0f);
+            } else if (err == CL_SUCCESS) {
+                err = enqueueLazyUpdate(lazy, wGpu.buffer, dirtyBuffer, indexBuffer, valueBuffer, count, now);
+            }
+            step.unlock();
+            clFinish(cl.queue);
+            bufferPool.release(indexBuffer);
+            bufferPool.release(valueBuffer);
+        }
+        if (timer) gpuEnd = std::chrono::system_clock::now();
+        if (timer)
+            gpuTime += std::chrono::duration_cast<std::chrono::milliseconds>(
+                    gpuEnd - gpuStart).count();
+    }
+
+    if (cpuJob) {
+        cpuJob->wait();
+        if (timer)
+            cpuTime += std::chrono::duration_cast<std::chrono::milliseconds>(
+                    cpuJob->finishTime() - cpuStart).count();
+    }
+    SAMPLE_CHECK_ERRORS(err);
+
+    if (!gpuTesting) {
+        for (uint64_t i : indices) markDirty(i, i + 1);
+    }
+    return 1;
+}
+
+/*
+ * Average one input of integers of the given weight into W on the CPU and GPU, as enabled.
+ * The integers are dequantized as each update reads them, so no float copy of the input is made.
+ */
+int applyQuantized(const QuantizedInput &input, float weight)
+{
+    cl_int err = CL_SUCCESS;
+    cl_ulong size = sizeW();
+
+    if (weight == 0) return 1;
+    if (!unsealState()) return 0;
+
+    std::unique_lock<std::mutex> step(stepMutex);
+    ++t;
+    totalWeight += weight;
+    float alpha = averagingMode == MODE_EMA ? emaShare(horizons.alphas[0], weight, t)
+                                            : (float) (weight / totalWeight);
+
+    std::chrono::system_clock::time_point gpuStart, gpuEnd;
+    std::chrono::steady_clock::time_point cpuStart;
+
+    std::shared_ptr<ThreadPool::Job> cpuJob;
+    if (cpuTesting)
+    {
+        cpuStart = std::chrono::steady_clock::now();
+        cpuJob = updateHostQuantized(input, wCpu, alpha, size);
+    }
+
+    if (gpuTesting)
+    {
+        if (timer) gpuStart = std::chrono::system_clock::now();
+        if (tiled) {
+            updateHostQuantized(input, tiledW.host, alpha, size)->wait();
+        } else {
+            // Only the integers cross to the device
+            cl_mem params = uploadQuantizedParams(input);
+            cl_mem raw = NULL;
+            if (params == NULL) err = CL_OUT_OF_RESOURCES;
+            if (err == CL_SUCCESS) raw = bufferPool.allocate(size * quantizedBytes(input.type), CL_MEM_READ_ONLY, &err);
+            if (err == CL_SUCCESS) {
+                err = clEnqueueWriteBuffer
+                        (
+                                cl.queue, // command_queue
+                                raw, // buffer
+                                false, // blocking_write
+                                0, // offset
+                                size * quantizedBytes(input.type), // cb
+                                input.data, // *ptr
+                                0, // num_events_in_wait_list
+                                NULL, // *event_wait_list
+                                NULL // *event
+                        );
+            }
+            if (err == CL_SUCCESS) {
+                err = enqueueQuantizedUpdate(input, wGpu.buffer, raw, params, alpha, dirtyBuffer, storageW, t, size);
+            }
+            step.unlock();
+            clFinish(cl.queue);
+            bufferPool.release(raw);
+            bufferPool.release(params);
+        }
+        if (timer) gpuEnd = std::chrono::system_clock::now();
+        if (timer)
+            gpuTime += std::chrono::duration_cast<std::chrono::milliseconds>(
+                    gpuEnd - gpuStart).count();
+    }
+
+    if (cpuJob) {
+        cpuJob->wait();
+        if (timer)
+            cpuTime += std::chrono::duration_cast<std::chrono::milliseconds>(
+                    cpuJob->finishTime() - cpuStart).count();
+    }
+    SAMPLE_CHECK_ERRORS(err);
+
+    if (tiled || !gpuTesting) markDirty(0, size);
+    return 1;
+}
+
+/*
+ * Sort count index-value pairs by index into indices and values, refusing indices outside of W
+ * and indices given more than once.
+ */
+int sortSparse(const jlong *given, const float *givenValues, size_t count, std::vector<uint64_t> &indices,
+               std::vector<float> &values)
+{
+    cl_ulong size = sizeW();
+
+    // Sorted so the CPU reference finds the inputs of each chunk, and duplicates sit side by side
+    std::vector<size_t> order(count);
+    for (size_t j = 0; j < count; ++j) order[j] = j;
+    std::sort(order.begin(), order.end(), [given](size_t a, size_t b) { return given[a] < given[b]; });
+
+    indices.resize(count);
+    values.resize(count);
+    for (size_t j = 0; j < count; ++j) {
+        jlong index = given[order[j]];
+        if (index < 0 || (cl_ulong) index >= size) {
+            LOGE("Index %lld is outside of W\n", (long long) index);
+            return 0;
+        }
+        if (j > 0 && (uint64_t) index == indices[j - 1]) {
+            LOGE("Index %lld is given more than once\n", (long long) index);
+            return 0;
+        }
+        indices[j] = (uint64_t) index;
+        values[j] = givenValues[order[j]];
+    }
+    return 1;
+}
+
+/*
+ * Average every vector of a batch into W, in timestamp order if it has timestamps.
+ */
+int applyBatch(const Batch &batch, const Progress &progress)
+{
+    cl_ulong size = sizeW();
+
+    if (batch.vectorSize != size) {
+        LOGE("Batch vectors have %llu elements, W has %llu\n",
+             (unsigned long long) batch.vectorSize, (unsigned long long) size);
+        return 0;
+    }
+
+    // Stable, so vectors with equal timestamps keep the order they were submitted in
+    std::vector<size_t> order((size_t) batch.count);
+    for (size_t i = 0; i < order.size(); ++i) order[i] = i;
+    if (batch.timestamps != NULL) {
+        std::stable_sort
+                (
+                        order.begin(),
+                        order.end(),
+                        [&batch](size_t a, size_t b) {
+                            return batch.timestamps[a] < batch.timestamps[b];
+                        }
+                );
+    }
+
+    for (size_t i = 0; i < order.size(); ++i) {
+        const float *input = batch.vectors + order[i] * size;
+        float weight = batch.weights != NULL ? batch.weights[order[i]] : 1.0f;
+
+        cl_mem inputBuffer;
+        if (!stageInput(input, inputBuffer)) return 0;
+        if (!applyInput(input, inputBuffer, weight)) return 0;
+        if (progress) progress(i + 1, order.size());
+        if (convergence.converged) {
+            LOGD("W converged after %zu of %zu batch vectors", i + 1, order.size());
+            break;
+        }
+    }
+    return 1;
+}
+
+/*
+ * Run time steps, taking inputs from the open dataset until it runs out, otherwise
+ * reusing the synthesized one. Returns the number of steps run, 0 on failure.
+ */
+int runSteps(int time, const Progress &progress)
+{
+    cl_ulong size = sizeW();
+
+    if (dataset.map != NULL && dataset.vectorSize != size) {
+        LOGE("W was resized to %llu elements; reopen the dataset\n", (unsigned long long) size);
+        return 0;
+    }
+
+    // Steps continue from previous runs so W can be resized between them
+    int steps = 0;
+    for (; steps < time; ++steps) {
+        const float *input = inputCpu;
+        cl_mem inputBuffer = inputVector.buffer;
+        if (dataset.map != NULL) {
+            if (dataset.next >= dataset.count) {
+                LOGD("Dataset exhausted after %d of %d steps", steps, time);
+                break;
+            }
+            input = nextDatasetVector(dataset, datasetVector.data());
+            if (!stageInput(input, inputBuffer)) return 0;
+        }
+        if (!applyInput(input, inputBuffer, 1.0f)) return 0;
+        if (progress) progress(steps + 1, time);
+        if (convergence.converged) {
+            LOGD("W converged after %d of %d steps", steps + 1, time);
+            ++steps;
+            break;
+        }
+    }
+    return steps;
+}
+
+/*
+ * Make JNI calls wait for the tasks queued before them, and keep the engine from
+ * touching W until the returned lock is released. Listeners calling back in run
+ * on the engine thread, inside a task, and so go straight ahead.
+ */
+std::unique_lock<std::mutex> waitForEngine()
+{
+    if (engine.onWorker()) return std::unique_lock<std::mutex>();
+    return engine.idle();
+}
+
+/*
+ * Start the engine thread, attached to the Java VM if there is one.
+ */
+void startEngine()
+{
+    engine.start
+            (
+                    [] {
+                        if (javaVm != NULL) javaVm->AttachCurrentThread(&workerEnv, NULL);
+                    },
+                    [] {
+                        if (javaVm != NULL) javaVm->DetachCurrentThread();
+                        workerEnv = NULL;
+                    }
+            );
+}
+
+/*
+ * Report to the listener, from the engine thread, how far the task with token has got.
+ */
+void notifyProgress(jlong token, uint64_t done, uint64_t total)
+{
+    if (workerEnv == NULL || engineListener == NULL) return;
+
+    workerEnv->CallVoidMethod(engineListener, onProgressMethod, token, (jlong) done, (jlong) total);
+    if (workerEnv->ExceptionCheck()) {
+        workerEnv->ExceptionDescribe();
+        workerEnv->ExceptionClear();
+    }
+}
+
+/*
+ * Report to the listener, from the engine thread, that the task with token has finished.
+ */
+void notifyComplete(jlong token, int result)
+{
+    if (workerEnv == NULL || engineListener == NULL) return;
+
+    workerEnv->CallVoidMethod(engineListener, onCompleteMethod, token, (jint) result);
+    if (workerEnv->ExceptionCheck()) {
+        workerEnv->ExceptionDescribe();
+        workerEnv->ExceptionClear();
+    }
+}
+
+/*
+ * Queue work submitted from Java under a new token. Progress is reported at most
+ * every PROGRESS_INTERVAL_MS, and the result once the work has run.
+ */
+jlong submitFromJava(std::function<int(const Progress &)> work)
+{
+    startEngine();
+    jlong token = ++submittedToken;
+
+    engine.submit([token, work]() {
+        std::chrono::steady_clock::time_point reported = std::chrono::steady_clock::now();
+        Progress progress = [token, &reported](uint64_t done, uint64_t total) {
+            std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+            if (done < total && now - reported < std::chrono::milliseconds(PROGRESS_INTERVAL_MS)) return;
+            reported = now;
+            notifyProgress(token, done, total);
+        };
+
+        int result = work(progress);
+        completedToken = token;
+        notifyComplete(token, result);
+        return result;
+    });
+    return token;
+}
+
+std::future<int> updateWeightsAsync(int time, Progress progress)
+{
+    startEngine();
+    return engine.submit([time, progress]() { return runSteps(time, progress); });
+}
+
+std::future<int> submitBatchAsync(const Batch &batch, Progress progress)
+{
+    startEngine();
+    return engine.submit([batch, progress]() { return applyBatch(batch, progress); });
+}
+
+/********************************** /Helper Functions ********************************************/
+
+enum NativeType
+{
+    JBoolean,
+    JByte,
+    JChar,
+    JShort,
+    JInt,
+    JLong,
+    Jfloat,
+    JDouble,
+};
+
+extern "C" JNIEXPORT jint JNICALL
+Java_com_example_jonny_updateweights_MainActivity_initOpenCl(JNIEnv *env, jobject instance, jstring kernelName) {
+    // The following variable stores return codes for all OpenCL calls.
+    // In the code it is used with the SAMPLE_CHECK_ERRORS macro defined
+    // before this function.
+    cl_int err = CL_SUCCESS;
+
+    // The engine thread attaches itself to the VM to report progress to Java
+    std::unique_lock<std::mutex> lock = waitForEngine();
+    env->GetJavaVM(&javaVm);
+
+    /* -----------------------------------------------------------------------
+     * Step 1: Query and choose OpenCL platform.
+     */
+    clGetPlatformIDs(1, &cl.platform, NULL);
+    char platform_name[100];
+    err = clGetPlatformInfo(
+            cl.platform,
+            CL_PLATFORM_NAME,
+            100,
+            platform_name,
+            0
+    );
+    LOGD("Platform: %s", platform_name);
+
+    /* -----------------------------------------------------------------------
+     * Step 2: Create context with a device of the specified type.
+     * Required device type is passed as function argument required_device_type.
+     * Use this function to create context for any CPU or GPU OpenCL device.
+     */
+    cl_context_properties context_props[] = {
+            CL_CONTEXT_PLATFORM,
+            cl_context_properties(cl.platform),
+            0
+    };
+    cl.context = clCreateContextFromType
+            (
+                    context_props,
+                    CL_DEVICE_TYPE_GPU, //Searching sepcifically for GPU
+                    0,
+                    0,
+                    &err
+            );
+    if (err == CL_DEVICE_NOT_AVAILABLE || err == CL_DEVICE_NOT_FOUND) return 0;
+    SAMPLE_CHECK_ERRORS(err);
+
+    // Every buffer is created through the pool so it can be recycled between runs
+    bufferPool.setContext(cl.context);
+
+    /* -----------------------------------------------------------------------
+     * Step 3: Query for OpenCL device that was used for context creation.
+     */
+    err = clGetContextInfo
+            (
+                    cl.context,
+                    CL_CONTEXT_DEVICES,
+                    sizeof(cl.device),
+                    &cl.device,
+                    0
+            );
+
+    err = clGetDeviceInfo
+            (
+                    cl.device,
+                    CL_DEVICE_NAME,
+                    sizeof(gpu.name),
+                    gpu.name,
+                    NULL
+            );
+    SAMPLE_CHECK_ERRORS(err);
+    LOGD("CL_DEVICE_NAME: %s", gpu.name );
+
+    err = clGetDeviceInfo
+            (
+                    cl.device,
+                    CL_DEVICE_MAX_COMPUTE_UNITS,
+                    sizeof(gpu.computeUnits),
+                    &gpu.computeUnits,
+                    NULL
+            );
+    SAMPLE_CHECK_ERRORS(err);
+    LOGD("Total Cores: %d", gpu.computeUnits );
+
+    err = clGetDeviceInfo
+            (
+                    cl.device,
+                    CL_DEVICE_GLOBAL_MEM_SIZE,
+                    sizeof(gpu.globalMem),
+                    &gpu.globalMem,
+                    NULL
+            );
+    SAMPLE_CHECK_ERRORS(err);
+    LOGD("Global Memory Size (bytes): %lu", (unsigned long) gpu.globalMem );
+
+    // Allow released W and input buffers to stay reserved for the next run
+    bufferPool.setMaxReservedSize(gpu.globalMem / 2);
+
+    err = clGetDeviceInfo
+            (
+                    cl.device,
+                    CL_DEVICE_LOCAL_MEM_SIZE,
+                    sizeof(gpu.localMem),
+                    &gpu.localMem,
+                    NULL
+            );
+    SAMPLE_CHECK_ERRORS(err);
+    LOGD("Local Memory Size (bytes): %lu", (unsigned long) gpu.localMem );
+
+    err = clGetDeviceInfo
+            (
+                    cl.device,
+                    CL_DEVICE_MAX_MEM_ALLOC_SIZE,
+                    sizeof(gpu.maxAllocSize),
+                    &gpu.maxAllocSize,
+                    NULL
+            );
+    SAMPLE_CHECK_ERRORS(err);
+    LOGD("Maximum memory allocation (bytes): %lu", (unsigned long) gpu.maxAllocSize );
+    bufferPool.setMaxAllocationSize(gpu.maxAllocSize);
+
+    err = clGetDeviceInfo
+            (
+                    cl.device,
+                    CL_DEVICE_HOST_UNIFIED_MEMORY,
+                    sizeof(gpu.unifiedMem),
+                    &gpu.unifiedMem,
+                    NULL
+            );
+    SAMPLE_CHECK_ERRORS(err);
+
+    cl_uint alignBits;
+    err = clGetDeviceInfo
+            (
+                    cl.device,
+                    CL_DEVICE_MEM_BASE_ADDR_ALIGN,
+                    sizeof(alignBits),
+                    &alignBits,
+                    NULL
+            );
+    SAMPLE_CHECK_ERRORS(err);
+    gpu.memBaseAlign = std::max<cl_ulong>(alignBits / 8, sizeof(float));
+
+    /* -----------------------------------------------------------------------
+     * Step 4: Create OpenCL program from its source code.
+     * The file name is passed by java.
+     * Convert the jstring to const char* and append the needed directory path.
+     */
+    const char* fileName = env->GetStringUTFChars(kernelName, 0);
+    std::string fileDir;
+    fileDir.append("/data/data/com.example.jonny.updateweights/app_execdir/");
+    fileDir.append(fileName);
+    std::string kernelSource = loadProgram(fileDir);
+    //std::string to const char* needed for the clCreateProgramWithSource function
+    const char* kernelSourceChar = kernelSource.c_str();
+
+    cl.program = clCreateProgramWithSource
+            (
+                    cl.context,
+                    1,
+                    &kernelSourceChar,
+                    0,
+                    &err
+            );
+
+    SAMPLE_CHECK_ERRORS(err);
+
+    /* -----------------------------------------------------------------------
+     * Step 5: Build the program.
+     * During creation a program is not built. Call the build function explicitly.
      * This example utilizes the create-build sequence, still other options are applicable,
      * for example, when a program consists of several parts, some of which are libraries.
      * Consider using clCompileProgram and clLinkProgram as alternatives.
      * Also consider looking into a dedicated chapter in the OpenCL specification
      * for more information on applicable alternatives and options.
      */
-    // Optimization flags used in build process
-    char *options = "-cl-fast-relaxed-math";
+    // Optimization flags used in build process
+    std::string options = "-cl-fast-relaxed-math";
+    options += " -DDIRTY_TILE_SHIFT=" + std::to_string(DIRTY_TILE_SHIFT);
+
+    err = clBuildProgram
+            (
+                    cl.program, // cl_program program
+                    0, // cl_uint num_devices
+                    NULL, // cl_device_id *device_list; if NULL, builds for all devices in program
+                    options.c_str(), // char *options
+                    0,
+                    0
+            );
+    SAMPLE_CHECK_ERRORS(err);
+    if(err == CL_BUILD_PROGRAM_FAILURE) {
+        size_t log_length = 0;
+        err = clGetProgramBuildInfo
+                (
+                        cl.program,
+                        cl.device,
+                        CL_PROGRAM_BUILD_LOG,
+                        0,
+                        0,
+                        &log_length
+                );
+        SAMPLE_CHECK_ERRORS(err);
+
+        std::vector<char> log(log_length);
+
+        err = clGetProgramBuildInfo
+                (
+                        cl.program,
+                        cl.device,
+                        CL_PROGRAM_BUILD_LOG,
+                        log_length,
+                        &log[0],
+                        0
+                );
+        SAMPLE_CHECK_ERRORS(err);
+
+        LOGE
+        (
+                "Error happened during the build of OpenCL program.\nBuild log:%s",
+                &log[0]
+        );
+        return 0;
+    }
+
+    /* -----------------------------------------------------------------------
+     * Step 6: Extract kernel from the built program.
+     * An OpenCL program consists of kernels. Each kernel can be called (enqueued) from
+     * the host part of an application.
+     * First create a kernel to call it from the existing program.
+     * Creating a kernel via clCreateKernel is similar to obtaining an entry point of a specific function
+     * in an OpenCL program.
+     */
+    cl.updateWeights = clCreateKernel
+            (
+                    cl.program,
+                    "UpdateWeights",
+                    &err
+            );
+    SAMPLE_CHECK_ERRORS(err);
+
+    cl.reduceStats = clCreateKernel(cl.program, "ReduceStats", &err);
+    SAMPLE_CHECK_ERRORS(err);
+    cl.reduceStatsFinal = clCreateKernel(cl.program, "ReduceStatsFinal", &err);
+    SAMPLE_CHECK_ERRORS(err);
+    cl.gatherW = clCreateKernel(cl.program, "GatherW", &err);
+    SAMPLE_CHECK_ERRORS(err);
+    cl.topK = clCreateKernel(cl.program, "TopK", &err);
+    SAMPLE_CHECK_ERRORS(err);
+    cl.updateWeightsDelta = clCreateKernel(cl.program, "UpdateWeightsDelta", &err);
+    SAMPLE_CHECK_ERRORS(err);
+    cl.updateWeightsMonitored = clCreateKernel(cl.program, "UpdateWeightsMonitored", &err);
+    SAMPLE_CHECK_ERRORS(err);
+    cl.updateWeightsEma = clCreateKernel(cl.program, "UpdateWeightsEma", &err);
+    SAMPLE_CHECK_ERRORS(err);
+    cl.updateWindow = clCreateKernel(cl.program, "UpdateWindow", &err);
+    SAMPLE_CHECK_ERRORS(err);
+    cl.resumWindow = clCreateKernel(cl.program, "ResumWindow", &err);
+    SAMPLE_CHECK_ERRORS(err);
+    cl.updateLazy = clCreateKernel(cl.program, "UpdateLazy", &err);
+    SAMPLE_CHECK_ERRORS(err);
+    cl.settleLazy = clCreateKernel(cl.program, "SettleLazy", &err);
+    SAMPLE_CHECK_ERRORS(err);
+    cl.updateCounted = clCreateKernel(cl.program, "UpdateCounted", &err);
+    SAMPLE_CHECK_ERRORS(err);
+    cl.updateWeightsQuantized = clCreateKernel(cl.program, "UpdateWeightsQuantized", &err);
+    SAMPLE_CHECK_ERRORS(err);
+    cl.updateWeightsHalf = clCreateKernel(cl.program, "UpdateWeightsHalf", &err);
+    SAMPLE_CHECK_ERRORS(err);
+    cl.gatherHalfW = clCreateKernel(cl.program, "GatherHalfW", &err);
+    SAMPLE_CHECK_ERRORS(err);
+    cl.widenHalfW = clCreateKernel(cl.program, "WidenHalfW", &err);
+    SAMPLE_CHECK_ERRORS(err);
+
+    /* -----------------------------------------------------------------------
+     * Step 7: Create command queue.
+     * OpenCL kernels are enqueued for execution to a particular device through
+     * special objects called command queues. Command queue provides ordering
+     * of calls and other OpenCL commands.
+     * This sample uses a simple in-order OpenCL command queue that doesn't
+     * enable execution of two kernels in parallel on a target device.
+     */
+    cl.queue = clCreateCommandQueue
+            (
+                    cl.context,
+                    cl.device,
+                    CL_QUEUE_PROFILING_ENABLE,
+                    &err
+            );
+    SAMPLE_CHECK_ERRORS(err);
+    cl.readQueue = clCreateCommandQueue
+            (
+                    cl.context,
+                    cl.device,
+                    0,
+                    &err
+            );
+    SAMPLE_CHECK_ERRORS(err);
+
+    if (gpu.unifiedMem == 1) return 2;
+
+    return 1;
+}
+
+extern "C" JNIEXPORT jlong JNICALL
+Java_com_example_jonny_updateweights_MainActivity_initW(JNIEnv *env, jobject instance, jlong size) {
+    std::unique_lock<std::mutex> lock = waitForEngine();
+    std::lock_guard<std::mutex> step(stepMutex);
+
+    if (size <= 0) {
+        LOGE("Invalid size of W %lld\n", (long long) size);
+        return 0;
+    }
+
+    // Hand buffers of a previous initialization back before drawing new ones from the pool
+    releaseW();
+    t = 0;
+    totalWeight = 0;
+
+    // W is created at the requested dimension and grows on demand through resizeW.
+    // Beyond a single device allocation it is kept on the host and streamed in tiles.
+    if (fitsDevice(size)) {
+        if (!growBuffer(wGpu, size, wFlags(), bytesPerElement(storageW))) return 0;
+        if (!growBuffer(inputVector, size, inputFlags(), bytesPerElement(storageW))) return 0;
+    } else {
+        if (!initTiledW(tiledW, size, NULL)) return 0;
+        tiled = true;
+    }
+
+    // Create cpu arrays. W is not cleared: the first update overwrites it.
+    if (!growHost(wCpu, size, 0)) return 0;
+    if (!growHost(inputCpu, size, 0)) return 0;
+
+    // Randomize input vector
+    if (!randomizeInput(0, size)) return 0;
+
+    // Nothing of this W is in a state file yet
+    stateCurrent = false;
+    dirtyTiles.clear();
+    if (!resizeDirty(0, size)) return 0;
+    if (!resampleShadow()) return 0;
+    if (!resetDeltas()) return 0;
+    resetConvergence(convergence);
+    if (!resetHorizons()) return 0;
+    if (!resetWindow()) return 0;
+    if (!resetLazy()) return 0;
+    if (!resetCounts()) return 0;
+
+    return sizeW();
+
+}
+
+extern "C" JNIEXPORT jlong JNICALL
+Java_com_example_jonny_updateweights_MainActivity_initTiledW(JNIEnv *env, jobject instance,
+                                                             jlong size, jstring path) {
+    std::unique_lock<std::mutex> lock = waitForEngine();
+    std::lock_guard<std::mutex> step(stepMutex);
+
+    if (size <= 0) {
+        LOGE("Invalid size of W %lld\n", (long long) size);
+        return 0;
+    }
+
+    releaseW();
+    t = 0;
+    totalWeight = 0;
+
+    // W lives in the given state file, or anonymous host memory, and is always streamed.
+    // Living in the state file means a checkpoint only has to sync it.
+    float *host = NULL;
+    if (path != NULL) {
+        const char *fileName = env->GetStringUTFChars(path, 0);
+        closeStateFile(state);
+        statePath = fileName;
+        env->ReleaseStringUTFChars(path, fileName);
+        if (!createStateFile(state, statePath.c_str(), size)) return 0;
+        host = state.data;
+    }
+    if (!initTiledW(tiledW, size, host)) return 0;
+    tiled = true;
+
+    if (!growHost(wCpu, size, 0)) return 0;
+    if (!growHost(inputCpu, size, 0)) return 0;
+    if (!randomizeInput(0, size)) return 0;
+
+    stateCurrent = false;
+    dirtyTiles.clear();
+    if (!resizeDirty(0, size)) return 0;
+    if (!resampleShadow()) return 0;
+    if (!resetDeltas()) return 0;
+    resetConvergence(convergence);
+    if (!resetHorizons()) return 0;
+    if (!resetWindow()) return 0;
+    if (!resetLazy()) return 0;
+    if (!resetCounts()) return 0;
+
+    return sizeW();
+}
+
+extern "C" JNIEXPORT jlong JNICALL
+Java_com_example_jonny_updateweights_MainActivity_resizeW(JNIEnv *env, jobject instance, jlong size) {
+    std::unique_lock<std::mutex> lock = waitForEngine();
+    std::lock_guard<std::mutex> step(stepMutex);
+
+    cl_int err;
+    cl_ulong oldSize = sizeW();
+
+    if (size <= 0) {
+        LOGE("Invalid size of W %lld\n", (long long) size);
+        return 0;
+    }
+
+    // Decay still owed by a lazily decayed W is applied before its steps restart with the new size
+    if (!settleW(0, oldSize)) return 0;
+
+    // Averages and the step count are kept; storage doubles when out of capacity
+    if (tiled && !tiledW.ownsHost) {
+        // W lives in the state file: grow the file and follow the mapping if it moved
+        if (!resizeStateFile(state, size)) return 0;
+        tiledW.host = state.data;
+        tiledW.capacity = state.capacity;
+        tiledW.size = size;
+    } else if (tiled) {
+        if (!resizeTiledW(tiledW, size)) return 0;
+    } else if (fitsDevice(size)) {
+        if (!growBuffer(wGpu, size, wFlags(), bytesPerElement(storageW))) return 0;
+        if (!growBuffer(inputVector, size, inputFlags(), bytesPerElement(storageW))) return 0;
+    } else {
+        // Outgrew a single allocation: move W to the host and stream it from now on
+        TiledW grown;
+        if (!initTiledW(grown, size, NULL)) return 0;
+        if (!readW(0, oldSize, grown.host)) {
+            releaseTiledW(grown);
+            return 0;
+        }
+
+        releaseW();
+        tiledW = grown;
+        tiled = true;
+    }
+    if (!growHost(wCpu, size, oldSize)) return 0;
+    if (!growHost(inputCpu, size, oldSize)) return 0;
+
+    if ((cl_ulong) size > oldSize) {
+        // New elements have seen a zero for every step so far, as if W had been zero-filled
+        if (t > 0) {
+            if (tiled) {
+                std::fill(tiledW.host + oldSize, tiledW.host + size, 0.0f);
+            } else {
+                size_t bytes = bytesPerElement(storageW);
+                err = enqueueClear(wGpu.buffer, oldSize * bytes, (size - oldSize) * bytes, bytes);
+                SAMPLE_CHECK_ERRORS(err);
+            }
+            std::fill(wCpu + oldSize, wCpu + size, 0.0f);
+        }
+        if (!randomizeInput(oldSize, size)) return 0;
+    }
+    if (!resizeDirty(oldSize, size)) return 0;
+    if ((cl_ulong) size != oldSize && !resampleShadow()) return 0;
+    if ((cl_ulong) size != oldSize && !resetDeltas()) return 0;
+    if ((cl_ulong) size != oldSize) resetConvergence(convergence);
+    if ((cl_ulong) size != oldSize && !resetHorizons()) return 0;
+    if ((cl_ulong) size != oldSize && !resetWindow()) return 0;
+    if ((cl_ulong) size != oldSize && !resetLazy()) return 0;
+    if ((cl_ulong) size != oldSize && !resetCounts()) return 0;
+
+    return sizeW();
+}
+
+extern "C" JNIEXPORT jint JNICALL
+Java_com_example_jonny_updateweights_MainActivity_checkpoint(JNIEnv *env, jobject instance, jstring path) {
+    std::unique_lock<std::mutex> lock = waitForEngine();
+
+    cl_int err;
+    cl_ulong size = sizeW();
+    bool inState = tiled && !tiledW.ownsHost;
+
+    // W alone cannot restart a window or a mean kept per element; its ring or totals would have to be stored too
+    if (averagingMode == MODE_WINDOW) {
+        LOGE("A sliding window cannot be checkpointed\n");
+        return 0;
+    }
+    if (averagingMode == MODE_PER_ELEMENT) {
+        LOGE("A mean kept per element cannot be checkpointed\n");
+        return 0;
+    }
+
+    const char *fileName = env->GetStringUTFChars(path, 0);
+    std::string requested(fileName);
+    env->ReleaseStringUTFChars(path, fileName);
+
+    // Only tiles modified since the last checkpoint to the same file are written
+    bool incremental = stateCurrent && requested == statePath && state.header != NULL;
+    if (requested != statePath || state.header == NULL) {
+        if (inState) {
+            LOGE("W is mapped from %s and can only be checkpointed there\n", statePath.c_str());
+            return 0;
+        }
+        closeStateFile(state);
+        statePath = requested;
+        if (!createStateFile(state, statePath.c_str(), size)) return 0;
+    }
+    if (!resizeStateFile(state, size)) return 0;
+    if (!settleW(0, size)) return 0;
+    if (!collectDirty()) return 0;
+    if (!incremental) markDirty(0, size);
+    stateCurrent = false;
+    if (!beginCheckpoint(state)) return 0;
+
+    // Bring dirty tiles of W into the mapping. Tiled W mapped from the file is already there.
+    const float *source = gpuTesting ? (tiled ? tiledW.host : NULL) : wCpu;
+    size_t written = 0;
+    for (size_t tile = 0; tile < dirtyTiles.size(); ++tile) {
+        if (!dirtyTiles[tile]) continue;
+
+        // Extend to a run of consecutive dirty tiles
+        size_t last = tile;
+        while (last + 1 < dirtyTiles.size() && dirtyTiles[last + 1]) ++last;
+        cl_ulong begin = (cl_ulong) tile << DIRTY_TILE_SHIFT;
+        cl_ulong end = std::min((cl_ulong) (last + 1) << DIRTY_TILE_SHIFT, size);
+        written += last - tile + 1;
+        tile = last;
+
+        if (source == NULL && halfW()) {
+            // Widened on the host; the state file always holds floats
+            if (!readW(begin, end - begin, state.data + begin)) return 0;
+        } else if (source == NULL) {
+            err = clEnqueueReadBuffer
+                    (
+                            cl.queue, // command_queue
+                            wGpu.buffer, // buffer
+                            false, // blocking_read
+                            begin * sizeof(float), // offset
+                            (end - begin) * sizeof(float), // cb
+                            state.data + begin, // *ptr
+                            0, // num_events_in_wait_list
+                            NULL, // *event_wait_list
+                            NULL // *event
+                    );
+            SAMPLE_CHECK_ERRORS(err);
+        } else if (source != state.data) {
+            std::copy(source + begin, source + end, state.data + begin);
+        }
+    }
+    if (source == NULL) {
+        err = clFinish(cl.queue);
+        SAMPLE_CHECK_ERRORS(err);
+    }
+    LOGD("Checkpoint wrote %lu of %lu tiles", (unsigned long) written, (unsigned long) dirtyTiles.size());
+
+    state.header->mode = averagingMode;
+    state.header->elementType = ELEMENT_FLOAT32;
+    if (!commitCheckpoint(state, t, totalWeight, size)) return 0;
+
+    std::fill(dirtyTiles.begin(), dirtyTiles.end(), 0);
+    stateCurrent = true;
+    return 1;
+}
+
+extern "C" JNIEXPORT jlong JNICALL
+Java_com_example_jonny_updateweights_MainActivity_restore(JNIEnv *env, jobject instance, jstring path) {
+    std::unique_lock<std::mutex> lock = waitForEngine();
+    std::lock_guard<std::mutex> step(stepMutex);
+
+    releaseW();
+    closeStateFile(state);
+
+    const char *fileName = env->GetStringUTFChars(path, 0);
+    statePath = fileName;
+    env->ReleaseStringUTFChars(path, fileName);
+    if (!openStateFile(state, statePath.c_str())) return 0;
+
+    // The smoothing factors are not stored; setAveragingMode has to match the file first
+    if (state.header->mode != (cl_uint) averagingMode) {
+        LOGE("%s was averaged in mode %u, not mode %u\n", statePath.c_str(), state.header->mode,
+             (unsigned) averagingMode);
+        return 0;
+    }
+    cl_ulong size = state.header->size;
+    t = (unsigned int) state.header->count;
+    totalWeight = stateWeight(state);
+
+    if (fitsDevice(size)) {
+        if (!growBuffer(wGpu, size, wFlags(), bytesPerElement(storageW))) return 0;
+        if (!growBuffer(inputVector, size, inputFlags(), bytesPerElement(storageW))) return 0;
+
+        // Upload straight from the mapped file, narrowed first for half W
+        if (!writeElements(wGpu.buffer, 0, size, state.data, storageW.enabled)) return 0;
+    } else {
+        // W keeps living in the file and is streamed from there
+        if (!initTiledW(tiledW, size, state.data)) return 0;
+        tiled = true;
+    }
+
+    if (!growHost(wCpu, size, 0)) return 0;
+    if (!growHost(inputCpu, size, 0)) return 0;
+    if (cpuTesting) std::copy(state.data, state.data + size, wCpu);
+    if (!randomizeInput(0, size)) return 0;
+
+    // W matches the file exactly, so the next checkpoint only writes what changes
+    dirtyTiles.clear();
+    if (!resizeDirty(0, size)) return 0;
+    stateCurrent = true;
+    if (!resampleShadow()) return 0;
+    if (!resetDeltas()) return 0;
+    resetConvergence(convergence);
+    if (!resetHorizons()) return 0;
+    if (!resetWindow()) return 0;
+    if (!resetLazy()) return 0;
+    if (!resetCounts()) return 0;
+
+    LOGD("Restored %llu elements after %u steps", (unsigned long long) size, t);
+    return sizeW();
+}
+
+extern "C" JNIEXPORT jlong JNICALL
+Java_com_example_jonny_updateweights_MainActivity_openDataset(JNIEnv *env, jobject instance,
+                                                                 jstring path, jint elementType,
+                                                                 jlong vectorSize) {
+    std::unique_lock<std::mutex> lock = waitForEngine();
+
+    closeDataset(dataset);
+
+    const char *fileName = env->GetStringUTFChars(path, 0);
+    int opened = openDataset(dataset, fileName, (cl_uint) elementType, (cl_ulong) vectorSize);
+    env->ReleaseStringUTFChars(path, fileName);
+    if (!opened) return 0;
+
+    // Vectors are averaged into W element by element
+    if (dataset.vectorSize != sizeW()) {
+        LOGE("Dataset vectors have %llu elements, W has %llu\n",
+             (unsigned long long) dataset.vectorSize, (unsigned long long) sizeW());
+        closeDataset(dataset);
+        return 0;
+    }
+    if (dataset.elementType != ELEMENT_FLOAT32) datasetVector.resize((size_t) dataset.vectorSize);
+    return dataset.count;
+}
+
+extern "C" JNIEXPORT void JNICALL
+Java_com_example_jonny_updateweights_MainActivity_closeDataset(JNIEnv *env, jobject instance) {
+    std::unique_lock<std::mutex> lock = waitForEngine();
+    closeDataset(dataset);
+}
+
+extern "C" JNIEXPORT int
+Java_com_example_jonny_updateweights_MainActivity_updateWeights(JNIEnv *env, jobject instance,
+                                                                   jint time)
+{
+    std::unique_lock<std::mutex> lock = waitForEngine();
+    //env->ReleaseFloatArrayElements(input, temp, JNI_ABORT);
+    return runSteps(time, Progress());
+
+}
+
+extern "C" JNIEXPORT jlong JNICALL
+Java_com_example_jonny_updateweights_MainActivity_updateWeightsAsync(JNIEnv *env, jobject instance,
+                                                                        jint time)
+{
+    return submitFromJava([time](const Progress &progress) { return runSteps(time, progress); });
+}
+
+extern "C" JNIEXPORT jint JNICALL
+Java_com_example_jonny_updateweights_MainActivity_updateWeightsDirect(JNIEnv *env, jobject instance,
+                                                                         jobject input)
+{
+    std::unique_lock<std::mutex> lock = waitForEngine();
+    cl_ulong size = sizeW();
+
+    // The buffer is read in place; the caller may not touch it until this returns
+    const float *elements = (const float *) env->GetDirectBufferAddress(input);
+    if (elements == NULL || (uintptr_t) elements % sizeof(float) != 0
+        || (cl_ulong) env->GetDirectBufferCapacity(input) < size * sizeof(float)) {
+        LOGE("Input has to be a direct buffer of %llu floats\n", (unsigned long long) size);
+        return 0;
+    }
+
+    cl_mem inputBuffer;
+    if (!stageInput(elements, inputBuffer)) return 0;
+    return applyInput(elements, inputBuffer, 1.0f);
+}
+
+extern "C" JNIEXPORT jint JNICALL
+Java_com_example_jonny_updateweights_MainActivity_updateWeightsArray(JNIEnv *env, jobject instance,
+                                                                        jfloatArray input)
+{
+    std::unique_lock<std::mutex> lock = waitForEngine();
+    cl_ulong size = sizeW();
+
+    if ((cl_ulong) env->GetArrayLength(input) < size) {
+        LOGE("Input has to hold %llu floats\n", (unsigned long long) size);
+        return 0;
+    }
+
+    // Pinned rather than copied where the VM allows. No JNI calls until released,
+    // and the garbage collector may be held off for the duration of the step.
+    const float *elements = (const float *) env->GetPrimitiveArrayCritical(input, NULL);
+    if (elements == NULL) return 0;
+
+    cl_mem inputBuffer;
+    int applied = stageInput(elements, inputBuffer) && applyInput(elements, inputBuffer, 1.0f);
+    env->ReleasePrimitiveArrayCritical(input, (void *) elements, JNI_ABORT);
+    return applied;
+}
+
+extern "C" JNIEXPORT jint JNICALL
+Java_com_example_jonny_updateweights_MainActivity_updateWeightsQuantized(JNIEnv *env, jobject instance,
+                                                                            jobject input, jint type,
+                                                                            jfloatArray scales, jfloatArray offsets)
+{
+    std::unique_lock<std::mutex> lock = waitForEngine();
+    cl_ulong size = sizeW();
+
+    jsize channels = env->GetArrayLength(scales);
+    if (type < QUANT_UINT8 || type > QUANT_FLOAT16 || channels < 1 || channels > QUANT_MAX_CHANNELS
+            || env->GetArrayLength(offsets) != channels) {
+        LOGE("Invalid quantized input: type %d, %d scales, %d offsets\n", (int) type, (int) channels,
+             (int) env->GetArrayLength(offsets));
+        return 0;
+    }
+
+    // The fused update blends W alone, without the passes other features add to a step
+    if ((averagingMode != MODE_CUMULATIVE && averagingMode != MODE_EMA) || horizons.extra > 0 || deltas.active
+            || verifySamples > 0 || convergence.active) {
+        LOGE("Quantized inputs need a single average without deltas, sampled verification or convergence\n");
+        return 0;
+    }
+
+    // The buffer is read in place; the caller may not touch it until this returns
+    QuantizedInput quantized;
+    quantized.type = (QuantizedType) type;
+    quantized.data = env->GetDirectBufferAddress(input);
+    size_t bytes = quantizedBytes(quantized.type);
+    if (quantized.data == NULL || (uintptr_t) quantized.data % bytes != 0
+        || (cl_ulong) env->GetDirectBufferCapacity(input) < size * bytes) {
+        LOGE("Input has to be a direct buffer of %llu elements of %zu bytes\n", (unsigned long long) size, bytes);
+        return 0;
+    }
+    quantized.scales.resize((size_t) channels);
+    quantized.offsets.resize((size_t) channels);
+    env->GetFloatArrayRegion(scales, 0, channels, quantized.scales.data());
+    env->GetFloatArrayRegion(offsets, 0, channels, quantized.offsets.data());
+
+    // Averages stay within the range of the inputs, so an input that fits a half keeps W finite
+    if (halfW() && !(quantizedRange(quantized) <= HALF_STORAGE_MAX)) {
+        LOGE("Quantized inputs reach %f, beyond the range of W stored as halves\n", quantizedRange(quantized));
+        return 0;
+    }
+    return applyQuantized(quantized, 1.0f);
+}
+
+extern "C" JNIEXPORT jint JNICALL
+Java_com_example_jonny_updateweights_MainActivity_updateWeightsSparse(JNIEnv *env, jobject instance,
+                                                                         jlongArray indices, jfloatArray values)
+{
+    std::unique_lock<std::mutex> lock = waitForEngine();
+
+    if (!sparseMode()) {
+        LOGE("Sparse inputs need a lazily decayed average or a mean kept per element\n");
+        return 0;
+    }
+    jsize count = env->GetArrayLength(indices);
+    if (env->GetArrayLength(values) != count) {
+        LOGE("%d indices do not match %d values\n", (int) count, (int) env->GetArrayLength(values));
+        return 0;
+    }
+
+    std::vector<jlong> given((size_t) count);
+    std::vector<float> givenValues((size_t) count);
+    env->GetLongArrayRegion(indices, 0, count, given.data());
+    env->GetFloatArrayRegion(values, 0, count, givenValues.data());
+
+    std::vector<uint64_t> sorted;
+    std::vector<float> sortedValues;
+    if (!sortSparse(given.data(), givenValues.data(), (size_t) count, sorted, sortedValues)) return 0;
+    return applySparse(sorted, sortedValues);
+}
+
+extern "C" JNIEXPORT jint JNICALL
+Java_com_example_jonny_updateweights_MainActivity_updateWeightsSparseRows(JNIEnv *env, jobject instance,
+                                                                             jlongArray rowOffsets,
+                                                                             jlongArray indices, jfloatArray values)
+{
+    std::unique_lock<std::mutex> lock = waitForEngine();
+
+    if (!sparseMode()) {
+        LOGE("Sparse inputs need a lazily decayed average or a mean kept per element\n");
+        return 0;
+    }
+    jsize rows = env->GetArrayLength(rowOffsets) - 1;
+    jsize count = env->GetArrayLength(indices);
+    if (rows < 0 || env->GetArrayLength(values) != count) {
+        LOGE("Invalid sparse rows: %d offsets, %d indices, %d values\n", (int) (rows + 1), (int) count,
+             (int) env->GetArrayLength(values));
+        return 0;
+    }
+
+    std::vector<jlong> offsets((size_t) rows + 1);
+    std::vector<jlong> given((size_t) count);
+    std::vector<float> givenValues((size_t) count);
+    env->GetLongArrayRegion(rowOffsets, 0, rows + 1, offsets.data());
+    env->GetLongArrayRegion(indices, 0, count, given.data());
+    env->GetFloatArrayRegion(values, 0, count, givenValues.data());
+    for (jsize r = 0; r < rows; ++r) {
+        if (offsets[r] < 0 || offsets[r] > offsets[r + 1] || offsets[r + 1] > count) {
+            LOGE("Row %d spans [%lld, %lld) of %d entries\n", (int) r, (long long) offsets[r],
+                 (long long) offsets[r + 1], (int) count);
+            return 0;
+        }
+    }
+
+    // Every row is checked before any is applied, so an invalid row leaves W as it was
+    std::vector<std::vector<uint64_t>> sorted((size_t) rows);
+    std::vector<std::vector<float>> sortedValues((size_t) rows);
+    for (jsize r = 0; r < rows; ++r) {
+        size_t begin = (size_t) offsets[r];
+        size_t length = (size_t) (offsets[r + 1] - offsets[r]);
+        if (!sortSparse(given.data() + begin, givenValues.data() + begin, length, sorted[r], sortedValues[r])) {
+            LOGE("Row %d is invalid; no rows were applied\n", (int) r);
+            return 0;
+        }
+    }
+
+    // Each row is one step, in order
+    for (jsize r = 0; r < rows; ++r) {
+        if (!applySparse(sorted[r], sortedValues[r])) return 0;
+    }
+    return 1;
+}
+
+extern "C" JNIEXPORT jint JNICALL
+Java_com_example_jonny_updateweights_MainActivity_updateWeightsMasked(JNIEnv *env, jobject instance,
+                                                                         jfloatArray input, jbyteArray mask)
+{
+    std::unique_lock<std::mutex> lock = waitForEngine();
+    cl_ulong size = sizeW();
+
+    if (!sparseMode()) {
+        LOGE("Masked inputs need a lazily decayed average or a mean kept per element\n");
+        return 0;
+    }
+    if ((cl_ulong) env->GetArrayLength(input) < size || (cl_ulong) env->GetArrayLength(mask) < size) {
+        LOGE("Input and mask have to hold %llu elements\n", (unsigned long long) size);
+        return 0;
+    }
+
+    // Only the valid elements are passed on, already in order
+    std::vector<uint64_t> valid;
+    std::vector<float> validValues;
+    {
+        const float *elements = (const float *) env->GetPrimitiveArrayCritical(input, NULL);
+        if (elements == NULL) return 0;
+        const jbyte *flags = (const jbyte *) env->GetPrimitiveArrayCritical(mask, NULL);
+        if (flags == NULL) {
+            env->ReleasePrimitiveArrayCritical(input, (void *) elements, JNI_ABORT);
+            return 0;
+        }
+        for (cl_ulong i = 0; i < size; ++i) {
+            if (flags[i] == 0) continue;
+            valid.push_back(i);
+            validValues.push_back(elements[i]);
+        }
+        env->ReleasePrimitiveArrayCritical(mask, (void *) flags, JNI_ABORT);
+        env->ReleasePrimitiveArrayCritical(input, (void *) elements, JNI_ABORT);
+    }
+    return applySparse(valid, validValues);
+}
+
+extern "C" JNIEXPORT jlong JNICALL
+Java_com_example_jonny_updateweights_MainActivity_submitBatch(JNIEnv *env, jobject instance,
+                                                                 jobject vectors, jint count,
+                                                                 jlongArray timestamps,
+                                                                 jfloatArray weights)
+{
+    cl_ulong size = sizeW();
+
+    // Vectors are read in place; timestamps and weights are small enough to copy
+    Batch batch = Batch();
+    batch.vectors = (const float *) env->GetDirectBufferAddress(vectors);
+    batch.count = count > 0 ? (cl_ulong) count : 0;
+    batch.vectorSize = size;
+    if (size == 0 || batch.vectors == NULL || (uintptr_t) batch.vectors % sizeof(float) != 0
+        || (cl_ulong) env->GetDirectBufferCapacity(vectors) / sizeof(float) / size < batch.count) {
+        LOGE("Vectors have to be a direct buffer of %d x %llu floats\n",
+             count, (unsigned long long) size);
+        return 0;
+    }
+
+    std::vector<jlong> batchTimestamps;
+    if (timestamps != NULL) {
+        if (env->GetArrayLength(timestamps) < count) {
+            LOGE("Batch of %d vectors has fewer timestamps\n", count);
+            return 0;
+        }
+        batchTimestamps.resize(batch.count);
+        env->GetLongArrayRegion(timestamps, 0, count, batchTimestamps.data());
+    }
+
+    std::vector<float> batchWeights;
+    if (weights != NULL) {
+        if (env->GetArrayLength(weights) < count) {
+            LOGE("Batch of %d vectors has fewer weights\n", count);
+            return 0;
+        }
+        batchWeights.resize(batch.count);
+        env->GetFloatArrayRegion(weights, 0, count, batchWeights.data());
+        for (size_t i = 0; i < batchWeights.size(); ++i) {
+            if (!(batchWeights[i] >= 0 && batchWeights[i] <= FLT_MAX)) {
+                LOGE("Weight %f of vector %lu is not a finite non-negative number\n",
+                     batchWeights[i], (unsigned long) i);
+                return 0;
+            }
+        }
+    }
+
+    // The buffer is kept from being collected until the batch has been averaged
+    jobject buffer = env->NewGlobalRef(vectors);
+    return submitFromJava([batch, buffer, batchTimestamps, batchWeights](const Progress &progress) {
+        Batch queued = batch;
+        if (!batchTimestamps.empty()) queued.timestamps = (const cl_long *) batchTimestamps.data();
+        if (!batchWeights.empty()) queued.weights = batchWeights.data();
+
+        int result = applyBatch(queued, progress);
+        if (workerEnv != NULL) workerEnv->DeleteGlobalRef(buffer);
+        return result;
+    });
+}
+
+extern "C" JNIEXPORT jboolean JNICALL
+Java_com_example_jonny_updateweights_MainActivity_batchDone(JNIEnv *env, jobject instance,
+                                                               jlong token)
+{
+    return token > 0 && token <= completedToken;
+}
+
+extern "C" JNIEXPORT void JNICALL
+Java_com_example_jonny_updateweights_MainActivity_setEngineListener(JNIEnv *env, jobject instance,
+                                                                       jobject listener)
+{
+    std::unique_lock<std::mutex> lock = waitForEngine();
+
+    if (engineListener != NULL) env->DeleteGlobalRef(engineListener);
+    engineListener = NULL;
+    if (listener == NULL) return;
+
+    jclass listenerClass = env->GetObjectClass(listener);
+    onProgressMethod = env->GetMethodID(listenerClass, "onProgress", "(JJJ)V");
+    onCompleteMethod = env->GetMethodID(listenerClass, "onComplete", "(JI)V");
+    env->DeleteLocalRef(listenerClass);
+    if (onProgressMethod == NULL || onCompleteMethod == NULL) return;
+
+    engineListener = env->NewGlobalRef(listener);
+}
+
+extern "C" JNIEXPORT jint JNICALL
+Java_com_example_jonny_updateweights_MainActivity_setSampledVerification(JNIEnv *env, jobject instance,
+                                                                         jlong samples, jboolean stratified) {
+    std::unique_lock<std::mutex> lock = waitForEngine();
+
+    if (samples < 0) {
+        LOGE("Invalid sample count %lld\n", (long long) samples);
+        return 0;
+    }
+    if (samples > 0 && averagingMode == MODE_WINDOW) {
+        LOGE("Sampled verification cannot follow a sliding window\n");
+        return 0;
+    }
+    if (samples > 0 && sparseMode()) {
+        LOGE("Sampled verification cannot follow an average taking sparse inputs\n");
+        return 0;
+    }
 
-    err = clBuildProgram
-            (
-                    cl.program, // cl_program program
-                    0, // cl_uint num_devices
-                    NULL, // cl_device_id *device_list; if NULL, builds for all devices in program
-                    options, // char *options
-                    0,
-                    0
-            );
-    SAMPLE_CHECK_ERRORS(err);
-    if(err == CL_BUILD_PROGRAM_FAILURE) {
-        size_t log_length = 0;
-        err = clGetProgramBuildInfo
-                (
-                        cl.program,
-                        cl.device,
-                        CL_PROGRAM_BUILD_LOG,
-                        0,
-                        0,
-                        &log_length
-                );
-        SAMPLE_CHECK_ERRORS(err);
+    cl_ulong size = sizeW();
+    if (samples == 0 && verifySamples > 0 && size > 0) {
+        // The full CPU W restarts from the current W, as the shadow did
+        if (!readW(0, size, wCpu)) return 0;
+    }
 
-        std::vector<char> log(log_length);
+    // The shadow takes the place of the full CPU W
+    verifySamples = (cl_ulong) samples;
+    cpuTesting = verifySamples == 0;
+    shadow.stratified = stratified;
+    if (size > 0 && !resampleShadow()) return 0;
+    return 1;
+}
 
-        err = clGetProgramBuildInfo
-                (
-                        cl.program,
-                        cl.device,
-                        CL_PROGRAM_BUILD_LOG,
-                        log_length,
-                        &log[0],
-                        0
-                );
-        SAMPLE_CHECK_ERRORS(err);
+extern "C" JNIEXPORT void JNICALL
+Java_com_example_jonny_updateweights_MainActivity_getGpuW(JNIEnv *env, jobject instance, jfloatArray gpuW) {
+    std::unique_lock<std::mutex> lock = waitForEngine();
+
+    // Only as much of W as the array holds is read
+    cl_ulong count = std::min<cl_ulong>((cl_ulong) env->GetArrayLength(gpuW), sizeW());
+    float *values = (float *) env->GetPrimitiveArrayCritical(gpuW, NULL);
+    if (values == NULL) return;
+    readW(0, count, values);
+    env->ReleasePrimitiveArrayCritical(gpuW, values, 0);
+}
 
-        LOGE
-        (
-                "Error happened during the build of OpenCL program.\nBuild log:%s",
-                &log[0]
-        );
+extern "C" JNIEXPORT jint JNICALL
+Java_com_example_jonny_updateweights_MainActivity_readRangeW(JNIEnv *env, jobject instance,
+                                                             jlong begin, jfloatArray values) {
+    std::unique_lock<std::mutex> lock = waitForEngine();
+
+    cl_ulong count = (cl_ulong) env->GetArrayLength(values);
+    if (begin < 0 || (cl_ulong) begin + count > sizeW()) {
+        LOGE("Range of %llu elements at %lld is outside of W\n", (unsigned long long) count, (long long) begin);
         return 0;
     }
 
-    /* -----------------------------------------------------------------------
-     * Step 6: Extract kernel from the built program.
-     * An OpenCL program consists of kernels. Each kernel can be called (enqueued) from
-     * the host part of an application.
-     * First create a kernel to call it from the existing program.
-     * Creating a kernel via clCreateKernel is similar to obtaining an entry point of a specific function
-     * in an OpenCL program.
-     */
-    cl.updateWeights = clCreateKernel
-            (
-                    cl.program,
-                    "UpdateWeights",
-                    &err
-            );
-    SAMPLE_CHECK_ERRORS(err);
+    float *out = (float *) env->GetPrimitiveArrayCritical(values, NULL);
+    if (out == NULL) return 0;
+    int result = readW((cl_ulong) begin, count, out);
+    env->ReleasePrimitiveArrayCritical(values, out, 0);
+    return result;
+}
 
-    /* -----------------------------------------------------------------------
-     * Step 7: Create command queue.
-     * OpenCL kernels are enqueued for execution to a particular device through
-     * special objects called command queues. Command queue provides ordering
-     * of calls and other OpenCL commands.
-     * This sample uses a simple in-order OpenCL command queue that doesn't
-     * enable execution of two kernels in parallel on a target device.
-     */
-    cl.queue = clCreateCommandQueue
-            (
-                    cl.context,
-                    cl.device,
-                    CL_QUEUE_PROFILING_ENABLE,
-                    &err
-            );
-    SAMPLE_CHECK_ERRORS(err);
+extern "C" JNIEXPORT jint JNICALL
+Java_com_example_jonny_updateweights_MainActivity_readStridedW(JNIEnv *env, jobject instance,
+                                                               jlong begin, jint width, jlong stride,
+                                                               jfloatArray values) {
+    std::unique_lock<std::mutex> lock = waitForEngine();
 
-    if (gpu.unifiedMem == 1) return 2;
+    if (begin < 0 || width <= 0 || stride < width) {
+        LOGE("Invalid strided read of %d elements every %lld\n", (int) width, (long long) stride);
+        return 0;
+    }
+    cl_ulong count = (cl_ulong) env->GetArrayLength(values) / width;
+    if (count > 0 && (cl_ulong) begin + (count - 1) * stride + width > sizeW()) {
+        LOGE("Strided read of %llu blocks at %lld is outside of W\n", (unsigned long long) count, (long long) begin);
+        return 0;
+    }
 
-    return 1;
+    float *out = (float *) env->GetPrimitiveArrayCritical(values, NULL);
+    if (out == NULL) return 0;
+    int result = readWStrided((cl_ulong) begin, (cl_ulong) width, (cl_ulong) stride, count, out);
+    env->ReleasePrimitiveArrayCritical(values, out, 0);
+    return result;
 }
 
 extern "C" JNIEXPORT jint JNICALL
-Java_com_example_jonny_updateweights_MainActivity_initW(JNIEnv *env, jobject instance) {
+Java_com_example_jonny_updateweights_MainActivity_readGatherW(JNIEnv *env, jobject instance,
+                                                              jlongArray indices, jfloatArray values) {
+    std::unique_lock<std::mutex> lock = waitForEngine();
 
-    cl_int err;
+    jsize count = env->GetArrayLength(indices);
+    if (env->GetArrayLength(values) < count) {
+        LOGE("Array of %d values cannot hold %d elements\n", (int) env->GetArrayLength(values), (int) count);
+        return 0;
+    }
 
-    wGpu.size = gpu.globalMem / 3 / sizeof(float) / 2;
-    if (wGpu.size > gpu.maxAllocSize) wGpu.size = gpu.maxAllocSize / sizeof(float) / 2;
+    std::vector<jlong> requested((size_t) count);
+    env->GetLongArrayRegion(indices, 0, count, requested.data());
+    std::vector<uint64_t> gathered((size_t) count);
+    cl_ulong size = sizeW();
+    for (jsize j = 0; j < count; ++j) {
+        if (requested[j] < 0 || (cl_ulong) requested[j] >= size) {
+            LOGE("Index %lld is outside of W\n", (long long) requested[j]);
+            return 0;
+        }
+        gathered[j] = (uint64_t) requested[j];
+    }
 
-    // Check to ensure that input size is not larger than constant buffer max
-    u_long maxBufferSize;
-    err = clGetDeviceInfo
-            (
-                    cl.device,
-                    CL_DEVICE_MAX_MEM_ALLOC_SIZE,
-                    sizeof(gpu.maxAllocSize),
-                    &maxBufferSize,
-                    NULL
-            );
-    SAMPLE_CHECK_ERRORS(err);
+    float *out = (float *) env->GetPrimitiveArrayCritical(values, NULL);
+    if (out == NULL) return 0;
+    int result = gatherW(gathered, out);
+    env->ReleasePrimitiveArrayCritical(values, out, 0);
+    return result;
+}
 
-    //if (wGpu.size > maxBufferSize / sizeof(float)) wGpu.size = maxBufferSize / sizeof (float);
+extern "C" JNIEXPORT jint JNICALL
+Java_com_example_jonny_updateweights_MainActivity_topK(JNIEnv *env, jobject instance, jint k,
+                                                       jboolean smallest, jlongArray indices,
+                                                       jfloatArray values) {
+    std::unique_lock<std::mutex> lock = waitForEngine();
+
+    if (k < 0 || env->GetArrayLength(indices) < k || env->GetArrayLength(values) < k) {
+        LOGE("Invalid top %d selection\n", (int) k);
+        return -1;
+    }
 
-    // If unified memory, allocate memory on host. Otherwise allocate on GPU memory.
-    if (gpu.unifiedMem) {
+    // Selected where W lives; a k beyond what the kernel keeps per work-item, or W beyond
+    // its 32-bit indices, reads W back instead
+    std::vector<IndexedValue> top;
+    cl_ulong size = sizeW();
+    if (!settleW(0, size)) return -1;
+    if (tiled) {
+        hostTopK(tiledW.host, size, (size_t) k, smallest, top);
+    } else if (k <= TOPK_MAX_K && !halfW() && size < CL_UINT_MAX) {
+        if (!deviceTopK(wGpu.buffer, size, (cl_uint) k, smallest, top)) return -1;
+    } else {
+        std::vector<float> host(size);
+        if (!readW(0, size, host.data())) return -1;
+        hostTopK(host.data(), size, (size_t) k, smallest, top);
+    }
 
-        // Create OpenCL memory buffer for vector w in host memory
-        wGpu.buffer = clCreateBuffer
-                (
-                        cl.context,
-                        CL_MEM_READ_WRITE | CL_MEM_ALLOC_HOST_PTR,
-                        wGpu.size * sizeof(float),
-                        NULL,
-                        &err
-                );
-        SAMPLE_CHECK_ERRORS(err);
+    jsize found = (jsize) top.size();
+    std::vector<jlong> topIndices(found);
+    std::vector<float> topValues(found);
+    for (jsize r = 0; r < found; ++r) {
+        topIndices[r] = (jlong) top[r].index;
+        topValues[r] = top[r].value;
+    }
+    env->SetLongArrayRegion(indices, 0, found, topIndices.data());
+    env->SetFloatArrayRegion(values, 0, found, topValues.data());
+    return found;
+}
 
-        // Create OpenCL memory buffer for input vector in host memory
-        inputVector.size = wGpu.size;
-        inputVector.buffer = clCreateBuffer
-                (
-                        cl.context,
-                        CL_MEM_READ_ONLY | CL_MEM_ALLOC_HOST_PTR,
-                        inputVector.size * sizeof(float),
-                        NULL,
-                        &err
-                );
-        SAMPLE_CHECK_ERRORS(err);
+extern "C" JNIEXPORT jint JNICALL
+Java_com_example_jonny_updateweights_MainActivity_subscribeDeltas(JNIEnv *env, jobject instance,
+                                                                  jfloat epsilon, jint capacity) {
+    if (epsilon < 0 || capacity <= 0) {
+        LOGE("Invalid delta subscription: epsilon %f, capacity %d\n", epsilon, (int) capacity);
+        return 0;
+    }
+    if (sparseMode()) {
+        LOGE("Deltas cannot follow an average taking sparse inputs\n");
+        return 0;
+    }
+    if (storageW.enabled) {
+        LOGE("Deltas cannot follow W stored as halves\n");
+        return 0;
     }
 
-    else
-    {
-        // Create OpenCL memory buffer for input vector in GPU memory
-        wGpu.buffer = clCreateBuffer
-                (
-                        cl.context,
-                        CL_MEM_READ_WRITE,
-                        wGpu.size * sizeof(float),
-                        NULL,
-                        &err
-                );
-        SAMPLE_CHECK_ERRORS(err);
+    // Takes effect from the next step on; W itself is published as it is now
+    std::lock_guard<std::mutex> step(stepMutex);
+    bool onHost = tiled || !gpuTesting;
+    return openDeltaStream(deltas, onHost ? NULL : wGpu.buffer, gpuTesting ? tiledW.host : wCpu, sizeW(),
+                           t > 0, epsilon, (cl_uint) capacity);
+}
 
-        // Create OpenCL memory buffer for input vector in GPU memory
-        inputVector.size = wGpu.size;
-        inputVector.buffer = clCreateBuffer
-                (
-                        cl.context,
-                        CL_MEM_READ_ONLY,
-                        inputVector.size * sizeof(float),
-                        NULL,
-                        &err
-                );
+extern "C" JNIEXPORT jint JNICALL
+Java_com_example_jonny_updateweights_MainActivity_pollDeltas(JNIEnv *env, jobject instance,
+                                                             jlongArray indices, jfloatArray values,
+                                                             jbooleanArray overflowed) {
+    std::vector<IndexedValue> polled;
+    bool missed = false;
+    {
+        std::lock_guard<std::mutex> step(stepMutex);
+        if (env->GetArrayLength(indices) < (jsize) deltas.capacity ||
+                env->GetArrayLength(values) < (jsize) deltas.capacity) {
+            LOGE("Arrays cannot hold the %u entries of a poll\n", deltas.capacity);
+            return -1;
+        }
+        if (!pollDeltas(deltas, polled, missed)) return -1;
+    }
+    if (overflowed != NULL && env->GetArrayLength(overflowed) > 0) {
+        jboolean flag = missed ? JNI_TRUE : JNI_FALSE;
+        env->SetBooleanArrayRegion(overflowed, 0, 1, &flag);
     }
 
-    // Create cpu array
-    wCpu = new float[wGpu.size];
-    std::fill( wCpu, wCpu + wGpu.size, 0 );
+    jsize count = (jsize) polled.size();
+    std::vector<jlong> polledIndices(count);
+    std::vector<float> polledValues(count);
+    for (jsize j = 0; j < count; ++j) {
+        polledIndices[j] = (jlong) polled[j].index;
+        polledValues[j] = polled[j].value;
+    }
+    env->SetLongArrayRegion(indices, 0, count, polledIndices.data());
+    env->SetFloatArrayRegion(values, 0, count, polledValues.data());
+    return count;
+}
 
-    // Fill arrays with zeros in parallel
-    cl_kernel fillZero = clCreateKernel(cl.program, "fillZero", &err);
-    SAMPLE_CHECK_ERRORS(err);
+extern "C" JNIEXPORT void JNICALL
+Java_com_example_jonny_updateweights_MainActivity_unsubscribeDeltas(JNIEnv *env, jobject instance) {
+    // Steps already queued may still write to the stream's buffers
+    std::lock_guard<std::mutex> step(stepMutex);
+    clFinish(cl.queue);
+    closeDeltaStream(deltas);
+}
 
-    size_t globalDimensions[3] = {wGpu.size, 1, 1};
+extern "C" JNIEXPORT jint JNICALL
+Java_com_example_jonny_updateweights_MainActivity_setAveragingMode(JNIEnv *env, jobject instance, jint mode,
+                                                                   jfloatArray alphas) {
+    std::unique_lock<std::mutex> lock = waitForEngine();
+    std::lock_guard<std::mutex> step(stepMutex);
+
+    std::vector<float> factors;
+    float lazyAlpha = lazy.alpha;
+    if (mode == MODE_EMA) {
+        jsize count = alphas != NULL ? env->GetArrayLength(alphas) : 0;
+        if (count < 1 || count > EMA_MAX_HORIZONS) {
+            LOGE("An exponential moving average takes 1 to %d smoothing factors, not %d\n",
+                 EMA_MAX_HORIZONS, (int) count);
+            return 0;
+        }
+        factors.resize(count);
+        env->GetFloatArrayRegion(alphas, 0, count, factors.data());
+        for (float alpha : factors) {
+            if (!(alpha > 0 && alpha <= 1)) {
+                LOGE("Invalid smoothing factor %f\n", alpha);
+                return 0;
+            }
+        }
+    } else if (mode == MODE_LAZY_EMA) {
+        jsize count = alphas != NULL ? env->GetArrayLength(alphas) : 0;
+        if (count == 1) env->GetFloatArrayRegion(alphas, 0, 1, &lazyAlpha);
+        if (count != 1 || !(lazyAlpha > 0 && lazyAlpha < 1)) {
+            LOGE("A lazily decayed average takes a single smoothing factor in (0, 1)\n");
+            return 0;
+        }
+    } else if (mode != MODE_CUMULATIVE && mode != MODE_PER_ELEMENT) {
+        LOGE("Unknown averaging mode %d\n", (int) mode);
+        return 0;
+    }
 
-    err = clSetKernelArg
-            (
-                    fillZero, // kernel
-                    0, // arg_index
-                    sizeof(wGpu.buffer), // arg_size
-                    &wGpu.buffer // *arg_value
-            );
-    SAMPLE_CHECK_ERRORS(err);
+    if (storageW.enabled && (factors.size() > 1 || (mode != MODE_CUMULATIVE && mode != MODE_EMA))) {
+        LOGE("W stored as halves takes the cumulative mean or a single exponential moving average\n");
+        return 0;
+    }
+    if ((mode == MODE_LAZY_EMA || mode == MODE_PER_ELEMENT) && (verifySamples > 0 || deltas.active)) {
+        LOGE("An average taking sparse inputs cannot be verified by samples or stream deltas\n");
+        return 0;
+    }
 
-    err = clEnqueueNDRangeKernel
-            (
-                    cl.queue, // command_queue
-                    fillZero, // kernel
-                    3, // work_dim
-                    NULL, // *global_work_offset
-                    globalDimensions, // *globa_work_size
-                    NULL, // *local_work_size
-                    0, // num_events_in_wait_list
-                    NULL, // *event_wait_list
-                    NULL // *event
-            );
-    SAMPLE_CHECK_ERRORS(err);
+    // W is brought up to date before leaving a lazily decayed average
+    if (!settleW(0, sizeW())) return 0;
 
-    // Randomize input vector
-    inputVector.pointer = (float *) clEnqueueMapBuffer
-            (
-                    cl.queue, // command_queue
-                    inputVector.buffer, // buffer
-                    true, // blocking_map
-                    CL_MAP_WRITE, // maps_flags
-                    0, // offset
-                    inputVector.size * sizeof(float), // cb
-                    0, // num_events_in_wait_list
-                    NULL, // *event_wait_list
-                    NULL, // *event
-                    &err // *errcode_ret
-            );
+    // W carries on under the new mode; the extra horizons start out from it
+    averagingMode = (AveragingMode) mode;
+    horizons.alphas = factors;
+    lazy.alpha = lazyAlpha;
+    return resetHorizons() && resetWindow() && resetLazy() && resetCounts();
+}
 
-    for (int i = 0; i < inputVector.size; ++i) {
-        inputVector.pointer[i] = static_cast <float> (rand()) / static_cast <float> (RAND_MAX);
+extern "C" JNIEXPORT jint JNICALL
+Java_com_example_jonny_updateweights_MainActivity_setSlidingWindow(JNIEnv *env, jobject instance, jint length,
+                                                                   jint elementType, jfloat low, jfloat high,
+                                                                   jint resumInterval) {
+    std::unique_lock<std::mutex> lock = waitForEngine();
+    std::lock_guard<std::mutex> step(stepMutex);
+
+    if (length < 1 || resumInterval < 0 || elementType < ELEMENT_FLOAT32 || elementType > ELEMENT_UINT8 ||
+            (elementType == ELEMENT_UINT8 && !(high > low))) {
+        LOGE("Invalid sliding window: length %d, element type %d, range [%f, %f], resummation every %d\n",
+             (int) length, (int) elementType, low, high, (int) resumInterval);
+        return 0;
+    }
+    if (verifySamples > 0) {
+        LOGE("Sampled verification cannot follow a sliding window\n");
+        return 0;
+    }
+    if (storageW.enabled) {
+        LOGE("A sliding window cannot average into W stored as halves\n");
+        return 0;
     }
 
-    clEnqueueUnmapMemObject(cl.queue,inputVector.buffer, inputVector.pointer, 0, NULL, NULL);
+    // The window starts out empty, so W becomes the mean of the inputs from here on
+    window.length = (cl_uint) length;
+    window.elementType = (cl_uint) elementType;
+    window.low = low;
+    window.high = high;
+    window.resumInterval = (cl_uint) resumInterval;
+    if (!settleW(0, sizeW())) return 0;
+    averagingMode = MODE_WINDOW;
+    horizons.alphas.clear();
+    return resetHorizons() && resetWindow() && resetLazy() && resetCounts();
+}
+
+extern "C" JNIEXPORT jint JNICALL
+Java_com_example_jonny_updateweights_MainActivity_readHorizons(JNIEnv *env, jobject instance,
+                                                               jlong begin, jfloatArray values) {
+    std::unique_lock<std::mutex> lock = waitForEngine();
+
+    cl_ulong count = std::max<size_t>(horizons.alphas.size(), 1);
+    cl_ulong rows = (cl_ulong) env->GetArrayLength(values) / count;
+    if (begin < 0 || (cl_ulong) begin + rows > sizeW()) {
+        LOGE("Rows [%lld, %llu) are outside of W\n", (long long) begin,
+             (unsigned long long) (begin + rows));
+        return 0;
+    }
 
-    return (int) wGpu.size;
+    // W holds the first horizon, the rest are kept interleaved next to it
+    std::vector<float> first((size_t) rows), extra((size_t) (rows * horizons.extra));
+    if (!readW((cl_ulong) begin, rows, first.data())) return 0;
+    if (horizons.extra > 0 && !readHorizons(horizons, (cl_ulong) begin, rows, extra.data())) return 0;
 
+    std::vector<float> interleaved((size_t) (rows * count));
+    for (cl_ulong i = 0; i < rows; ++i) {
+        interleaved[i * count] = first[i];
+        const float *row = extra.data() + i * horizons.extra;
+        std::copy(row, row + horizons.extra, interleaved.data() + i * count + 1);
+    }
+    env->SetFloatArrayRegion(values, 0, (jsize) interleaved.size(), interleaved.data());
+    return 1;
 }
 
-extern "C" JNIEXPORT int
-Java_com_example_jonny_updateweights_MainActivity_updateWeights(JNIEnv *env, jobject instance,
-                                                                   jint time)
-{
-    cl_int err;
+extern "C" JNIEXPORT jint JNICALL
+Java_com_example_jonny_updateweights_MainActivity_setStorage(JNIEnv *env, jobject instance, jint elementType,
+                                                             jint rounding) {
+    std::unique_lock<std::mutex> lock = waitForEngine();
+    std::lock_guard<std::mutex> step(stepMutex);
+
+    if ((elementType != ELEMENT_FLOAT32 && elementType != ELEMENT_FLOAT16)
+            || (rounding != ROUND_NEAREST && rounding != ROUND_STOCHASTIC)) {
+        LOGE("Invalid storage of W: element type %d, rounding %d\n", (int) elementType, (int) rounding);
+        return 0;
+    }
 
-    if (gpuTesting)
-    {
-        // Set kernel arguments
-        err = clSetKernelArg
-                (
-                        cl.updateWeights,
-                        0,
-                        sizeof(wGpu.buffer),
-                        &wGpu.buffer
-                );
-        err |= clSetKernelArg
-                (
-                        cl.updateWeights,
-                        1,
-                        sizeof(inputVector.buffer),
-                        &inputVector.buffer
-                );
-        SAMPLE_CHECK_ERRORS(err);
+    // Everything else reading resident W on the device expects floats
+    bool half = elementType == ELEMENT_FLOAT16;
+    if (half && ((averagingMode != MODE_CUMULATIVE && averagingMode != MODE_EMA) || horizons.alphas.size() > 1
+            || deltas.active || convergence.active)) {
+        LOGE("W stored as halves takes a single average without deltas or convergence monitoring\n");
+        return 0;
     }
 
-    // Set time values
-    std::chrono::system_clock::time_point gpuStart, gpuEnd, cpuStart, cpuEnd;
-    for (int t = 1; t <= time; ++t) {
-
-        if (cpuTesting)
-        {
-            if (timer) cpuStart = std::chrono::system_clock::now();
-            for (int i = 0; i < wGpu.size; ++i) {
-                wCpu[i] =
-                        ((float) (t - 1) / t * wCpu[i]) + ((float) 1 / t * inputVector.pointer[i]);
-            }
-            if (timer) cpuEnd = std::chrono::system_clock::now();
-            if (timer)
-                cpuTime += std::chrono::duration_cast<std::chrono::milliseconds>(
-                        cpuEnd - cpuStart).count();
-        }
+    storageW.rounding = (HalfRounding) rounding;
+    // Drawn apart from rand(), which generates the inputs, so runs with and without halves see the same inputs
+    storageW.seed = (cl_uint) std::random_device()();
+    return repackW(half);
+}
 
-        if (gpuTesting)
-        {
-            if (timer) gpuStart = std::chrono::system_clock::now();
-            err = clSetKernelArg
-                    (
-                            cl.updateWeights,
-                            2,
-                            sizeof(int),
-                            &t
-                    );
+extern "C" JNIEXPORT jint JNICALL
+Java_com_example_jonny_updateweights_MainActivity_setConvergenceMonitor(JNIEnv *env, jobject instance,
+                                                                        jboolean enabled, jfloat tolerance,
+                                                                        jint patience) {
+    std::unique_lock<std::mutex> lock = waitForEngine();
 
-            // Run kernel
-            size_t globalDimensions[3] = {wGpu.size, 1, 1};
-            err = clEnqueueNDRangeKernel
-                    (
-                            cl.queue, // command_queue
-                            cl.updateWeights, // kernel
-                            3, // work_dim
-                            NULL, // *global_work_offset
-                            globalDimensions, // *global_work_size
-                            NULL, // *local_work_size
-                            0, // num_events_in_wait_list
-                            NULL, // *event_wait_list
-                            NULL // *event
-                    );
-            clFinish(cl.queue);
-            if (timer) gpuEnd = std::chrono::system_clock::now();
-            if (timer)
-                gpuTime += std::chrono::duration_cast<std::chrono::milliseconds>(
-                        gpuEnd - gpuStart).count();
-        }
+    if (tolerance < 0 || patience < 0) {
+        LOGE("Invalid convergence policy: tolerance %f, patience %d\n", tolerance, (int) patience);
+        return 0;
     }
-    //SAMPLE_CHECK_ERRORS(err);
-    err = clReleaseMemObject(inputVector.buffer);
-    //SAMPLE_CHECK_ERRORS(err);
-    //env->ReleaseFloatArrayElements(input, temp, JNI_ABORT);
+    if (enabled && storageW.enabled) {
+        LOGE("Convergence cannot be monitored with W stored as halves\n");
+        return 0;
+    }
+
+    // Measured from the next step on
+    convergence.active = enabled;
+    convergence.tolerance = tolerance;
+    convergence.patience = patience;
+    resetConvergence(convergence);
     return 1;
+}
 
+extern "C" JNIEXPORT jboolean JNICALL
+Java_com_example_jonny_updateweights_MainActivity_getConvergence(JNIEnv *env, jobject instance,
+                                                                 jdoubleArray change) {
+    std::unique_lock<std::mutex> lock = waitForEngine();
+
+    if (env->GetArrayLength(change) < 3) {
+        LOGE("Convergence needs an array of 3\n");
+        return false;
+    }
+    jdouble values[3] = { (jdouble) convergence.step, convergence.maxChange, convergence.normChange };
+    env->SetDoubleArrayRegion(change, 0, 3, values);
+    return convergence.converged;
 }
 
-extern "C" JNIEXPORT void JNICALL
-Java_com_example_jonny_updateweights_MainActivity_getGpuW(JNIEnv *env, jobject instance) {
+extern "C" JNIEXPORT jlong JNICALL
+Java_com_example_jonny_updateweights_MainActivity_snapshotW(JNIEnv *env, jobject instance) {
+    // Does not wait for the engine: the copy is queued between two of its steps
+    std::shared_ptr<Snapshot> snapshot(new Snapshot(), [](Snapshot *s) {
+        releaseSnapshot(*s);
+        delete s;
+    });
+    {
+        std::lock_guard<std::mutex> step(stepMutex);
+        snapshot->step = t;
+        snapshot->weight = totalWeight;
+        if (!settleDevice(0, sizeW())) return 0;
+        if (!takeSnapshot(*snapshot, tiled ? NULL : wGpu.buffer, tiledW.host, sizeW(), halfW())) return 0;
+    }
 
-    cl_int err;
-    wGpu.pointer = (float*)clEnqueueMapBuffer
-            (
-                    cl.queue, // command_queue
-                    wGpu.buffer, // buffer
-                    true, // blocking_map
-                    CL_MAP_READ, // maps_flags
-                    0, // offset
-                    wGpu.size * sizeof(float), // cb
-                    0, // num_events_in_wait_list
-                    NULL, // *event_wait_list
-                    NULL, // *event
-                    &err // *errcode_ret
-            );
+    std::lock_guard<std::mutex> lock(snapshotMutex);
+    jlong handle = ++lastSnapshot;
+    snapshots[handle] = snapshot;
+    return handle;
+}
+
+extern "C" JNIEXPORT jlong JNICALL
+Java_com_example_jonny_updateweights_MainActivity_snapshotStep(JNIEnv *env, jobject instance,
+                                                               jlong handle) {
+    std::shared_ptr<Snapshot> snapshot = findSnapshot(handle);
+    return snapshot ? (jlong) snapshot->step : -1;
+}
 
-    //env->ReleaseFloatArrayElements(result,wGpu.pointer, JNI_COMMIT);
+extern "C" JNIEXPORT jboolean JNICALL
+Java_com_example_jonny_updateweights_MainActivity_snapshotReady(JNIEnv *env, jobject instance,
+                                                                jlong handle) {
+    std::shared_ptr<Snapshot> snapshot = findSnapshot(handle);
+    return (jboolean) (snapshot && snapshotReady(*snapshot));
+}
 
-    err = clReleaseMemObject(wGpu.buffer);
+extern "C" JNIEXPORT jint JNICALL
+Java_com_example_jonny_updateweights_MainActivity_readSnapshot(JNIEnv *env, jobject instance,
+                                                               jlong handle, jlong begin,
+                                                               jfloatArray values) {
+    std::shared_ptr<Snapshot> snapshot = findSnapshot(handle);
+    if (!snapshot || begin < 0) return 0;
+
+    // Read into a copy: the wait for the snapshot must not happen inside a critical section
+    cl_ulong count = (cl_ulong) env->GetArrayLength(values);
+    std::vector<float> out(count);
+    if (!readSnapshot(*snapshot, (cl_ulong) begin, count, out.data())) return 0;
+    env->SetFloatArrayRegion(values, 0, (jsize) count, out.data());
+    return 1;
+}
 
+extern "C" JNIEXPORT void JNICALL
+Java_com_example_jonny_updateweights_MainActivity_releaseSnapshot(JNIEnv *env, jobject instance,
+                                                                  jlong handle) {
+    // The copy goes once the last reader using it is done, outside of the lock
+    std::shared_ptr<Snapshot> snapshot;
+    {
+        std::lock_guard<std::mutex> lock(snapshotMutex);
+        std::map<jlong, std::shared_ptr<Snapshot>>::iterator found = snapshots.find(handle);
+        if (found == snapshots.end()) return;
+        snapshot = found->second;
+        snapshots.erase(found);
+    }
 }
 
 extern "C" JNIEXPORT jstring JNICALL
 Java_com_example_jonny_updateweights_MainActivity_getResults(JNIEnv *env, jobject instance) {
+    std::unique_lock<std::mutex> lock = waitForEngine();
 
     cl_int err;
-    wGpu.pointer = (float*)clEnqueueMapBuffer
-            (
-                    cl.queue, // command_queue
-                    wGpu.buffer, // buffer
-                    true, // blocking_map
-                    CL_MAP_READ, // maps_flags
-                    0, // offset
-                    wGpu.size * sizeof(float), // cb
-                    0, // num_events_in_wait_list
-                    NULL, // *event_wait_list
-                    NULL, // *event
-                    &err // *errcode_ret
-            );
-    SAMPLE_CHECK_ERRORS(err);
+    cl_ulong size = sizeW();
+
+    if (verifySamples > 0) {
+        // Only the sampled elements have a CPU reference to compare against
+        std::vector<float> gpuValues(shadow.indices.size());
+        if (!gatherW(shadow.indices, gpuValues.data())) return NULL;
+        SampleEstimate estimate = estimateError(shadow, gpuValues.data());
+
+        std::string result;
+        result += "Results:\n";
+        result += std::to_string(size) + " elements, " + std::to_string(estimate.samples) +
+                  (shadow.stratified ? " stratified" : " random") + " samples";
+        result += "\nGPU Runtime: " + std::to_string((double)gpuTime/1000.0) + " s\n";
+        result += "\nGPU relative error to CPU: " + std::to_string(estimate.relativeError*100) + "%";
+        result += " (95% bound " + std::to_string(estimate.relativeErrorBound*100) + "%)";
+        result += "\nGPU max absolute error to CPU in sample: " + std::to_string(estimate.maxDifference);
+        result += "\nElements beyond tolerance: " + std::to_string(estimate.exceeding) + " sampled";
+        result += " (95% bound " + std::to_string(estimate.exceedingBound*100) + "% of W)";
+
+        return env->NewStringUTF(result.c_str());
+    }
+
+    // First elements of the GPU W, for display
+    float gpuHead[10] = { 0 };
+    cl_ulong headCount = std::min<cl_ulong>(10, size);
 
     double cpuNorm = 0.0;
     double differenceNorm = 0.0;
+    double maxDifference = 0.0;
+
+    if (!settleW(0, size)) return NULL;
+    if (!readW(0, headCount, gpuHead)) return NULL;
+
+    // Half W is widened on the host to be compared there, like tiled W
+    std::vector<float> widened;
+    const float *hostW = tiledW.host;
+    if (halfW()) {
+        widened.resize((size_t) size);
+        if (!readW(0, size, widened.data())) return NULL;
+        hostW = widened.data();
+    }
+
+    if (tiled || halfW()) {
+        ArrayStats stats;
+        hostStats(wCpu, hostW, size, stats);
+        cpuNorm = stats.sumSquares;
+        differenceNorm = stats.differenceSquares;
+        maxDifference = stats.maxDifference;
+
+        uint64_t histogram[ULP_BUCKETS];
+        ulpHistogram(hostW, wCpu, size, histogram);
+        for (int bucket = 0; bucket < ULP_BUCKETS; ++bucket){
+            if (histogram[bucket] == 0) continue;
+            LOGD("ULP distance < 2^%d: %llu elements", bucket, (unsigned long long) histogram[bucket]);
+        }
+    } else {
+        // Compare on the device against the CPU W, so only a few scalars come back
+        cl_mem reference = wrapInput(wCpu);
+        if (reference == NULL) {
+            reference = bufferPool.allocate(size * sizeof(float), CL_MEM_READ_ONLY, &err);
+            SAMPLE_CHECK_ERRORS(err);
+            err = clEnqueueWriteBuffer
+                    (
+                            cl.queue, // command_queue
+                            reference, // buffer
+                            false, // blocking_write
+                            0, // offset
+                            size * sizeof(float), // cb
+                            wCpu, // *ptr
+                            0, // num_events_in_wait_list
+                            NULL, // *event_wait_list
+                            NULL // *event
+                    );
+            if (err != CL_SUCCESS) bufferPool.release(reference);
+            SAMPLE_CHECK_ERRORS(err);
+        }
+
+        ArrayStats stats;
+        int reduced = deviceStats(reference, wGpu.buffer, size, stats);
+        bufferPool.release(reference);
+        if (!reduced) return NULL;
 
-    for (int i = 0; i < 10; ++i){
-        LOGD("CPU: %f GPU: %f", wCpu[i], wGpu.pointer[i]);
+        cpuNorm = stats.sumSquares;
+        differenceNorm = stats.differenceSquares;
+        maxDifference = stats.maxDifference;
     }
 
-    for (int i = 0; i < wGpu.size; ++i){
-        differenceNorm += pow(abs(wCpu[i] - wGpu.pointer[i]),2);
-        cpuNorm += pow(wCpu[i], 2);
+    for (cl_ulong i = 0; i < headCount; ++i){
+        LOGD("CPU: %f GPU: %f", wCpu[i], gpuHead[i]);
     }
     cpuNorm = sqrt(cpuNorm);
     differenceNorm = sqrt(differenceNorm);
@@ -782,15 +3030,16 @@ Java_com_example_jonny_updateweights_MainActivity_getResults(JNIEnv *env, jobjec
 
     std::string result;
     result += "Results:\n";
-    result += std::to_string(wGpu.size) + " elements";
+    result += std::to_string(size) + " elements";
     result += "\nCPU Runtime: " + std::to_string((double)cpuTime/1000.0) + " s";
     result += "\nGPU Runtime: " + std::to_string((double)gpuTime/1000.0) + " s";
     result += "\nGPU " + std::to_string((double)((double)cpuTime/(double)gpuTime)) + "x faster than CPU\n";
     result += "\nGPU relative error to CPU: " +  std::to_string(relativeError*100) + "%";
+    result += "\nGPU max absolute error to CPU: " + std::to_string(maxDifference);
     result += "\nwCpu[0]: " + std::to_string(wCpu[0]);
-    result += "\nwGpu[0]: " + std::to_string(wGpu.pointer[0]);
+    result += "\nwGpu[0]: " + std::to_string(gpuHead[0]);
     result += "\nwCpu[1]: " + std::to_string(wCpu[1]);
-    result += "\nwGpu[1]: " + std::to_string(wGpu.pointer[1]);
+    result += "\nwGpu[1]: " + std::to_string(gpuHead[1]);
 
     return env->NewStringUTF(result.c_str());
 }
\ No newline at end of file
@@ -0,0 +1,186 @@
+/**
+ * quantized-input.cpp
+ * @author Jonathan Dowdall
+ * @since 10-18-2026
+ */
+
+#include <algorithm>
+#include <cmath>
+
+#include <opencv2/core/hal/intrin.hpp>
+
+#include "quantized-input.h"
+#include "buffer-pool.h"
+#include "half-float.h"
+
+using namespace cv;
+
+/** Minimum elements per chunk of the host update */
+#define QUANT_GRAIN (1 << 16)
+
+size_t quantizedBytes(QuantizedType type)
+{
+    return type == QUANT_UINT8 ? 1 : 2;
+}
+
+float dequantize(const QuantizedInput &input, size_t i)
+{
+    float q;
+    if (input.type == QUANT_UINT8) q = ((const uint8_t *) input.data)[i];
+    else if (input.type == QUANT_UINT16) q = ((const uint16_t *) input.data)[i];
+    else if (input.type == QUANT_INT16) q = ((const int16_t *) input.data)[i];
+    else q = halfToFloat(((const uint16_t *) input.data)[i]);
+
+    size_t c = i % input.scales.size();
+    return input.scales[c] * q + input.offsets[c];
+}
+
+float quantizedRange(const QuantizedInput &input)
+{
+    float low = input.type == QUANT_INT16 ? -32768.0f : input.type == QUANT_FLOAT16 ? -65504.0f : 0.0f;
+    float high = input.type == QUANT_UINT8 ? 255.0f : input.type == QUANT_UINT16 ? 65535.0f
+               : input.type == QUANT_INT16 ? 32767.0f : 65504.0f;
+
+    // Dequantizing is affine, so the extremes of each channel are at the extremes of q
+    float range = 0;
+    for (size_t c = 0; c < input.scales.size(); ++c) {
+        range = std::max(range, std::fabs(input.scales[c] * low + input.offsets[c]));
+        range = std::max(range, std::fabs(input.scales[c] * high + input.offsets[c]));
+    }
+    return range;
+}
+
+cl_mem uploadQuantizedParams(const QuantizedInput &input)
+{
+    cl_int err;
+    size_t channels = input.scales.size();
+
+    // Interleaved: scale then offset of each channel
+    std::vector<float> params(channels * 2);
+    for (size_t c = 0; c < channels; ++c) {
+        params[c * 2] = input.scales[c];
+        params[c * 2 + 1] = input.offsets[c];
+    }
+
+    cl_mem buffer = bufferPool.allocate(params.size() * sizeof(float), CL_MEM_READ_ONLY, &err);
+    if (err != CL_SUCCESS) return NULL;
+    err = clEnqueueWriteBuffer
+            (
+                    cl.queue, // command_queue
+                    buffer, // buffer
+                    true, // blocking_write
+                    0, // offset
+                    params.size() * sizeof(float), // cb
+                    params.data(), // *ptr
+                    0, // num_events_in_wait_list
+                    NULL, // *event_wait_list
+                    NULL // *event
+            );
+    if (err != CL_SUCCESS) {
+        bufferPool.release(buffer);
+        return NULL;
+    }
+    return buffer;
+}
+
+cl_int enqueueQuantizedUpdate(const QuantizedInput &input, cl_mem w, cl_mem raw, cl_mem params, float alpha,
+                              cl_mem dirty, const HalfStorage &storage, unsigned int step, cl_ulong size)
+{
+    cl_int type = input.type;
+    cl_uint channels = (cl_uint) input.scales.size();
+    cl_int halfW = storage.enabled;
+    cl_int stochastic = storage.rounding == ROUND_STOCHASTIC;
+    cl_uint seed = stepSeed(storage, step);
+
+    cl_int err = clSetKernelArg(cl.updateWeightsQuantized, 0, sizeof(cl_mem), &w);
+    err |= clSetKernelArg(cl.updateWeightsQuantized, 1, sizeof(cl_mem), &raw);
+    err |= clSetKernelArg(cl.updateWeightsQuantized, 2, sizeof(float), &alpha);
+    err |= clSetKernelArg(cl.updateWeightsQuantized, 3, sizeof(cl_mem), dirty != NULL ? &dirty : NULL);
+    err |= clSetKernelArg(cl.updateWeightsQuantized, 4, sizeof(cl_int), &type);
+    err |= clSetKernelArg(cl.updateWeightsQuantized, 5, sizeof(cl_mem), &params);
+    err |= clSetKernelArg(cl.updateWeightsQuantized, 6, sizeof(cl_uint), &channels);
+    err |= clSetKernelArg(cl.updateWeightsQuantized, 7, sizeof(cl_int), &halfW);
+    err |= clSetKernelArg(cl.updateWeightsQuantized, 8, sizeof(cl_int), &stochastic);
+    err |= clSetKernelArg(cl.updateWeightsQuantized, 9, sizeof(cl_uint), &seed);
+
+    size_t globalDimensions[3] = {(size_t) size, 1, 1};
+    if (err == CL_SUCCESS) err = clEnqueueNDRangeKernel
+            (
+                    cl.queue, // command_queue
+                    cl.updateWeightsQuantized, // kernel
+                    3, // work_dim
+                    NULL, // *global_work_offset
+                    globalDimensions, // *global_work_size
+                    NULL, // *local_work_size
+                    0, // num_events_in_wait_list
+                    NULL, // *event_wait_list
+                    NULL // *event
+            );
+    return err;
+}
+
+/*
+ * Four elements at i, widened to floats.
+ */
+static inline v_float32x4 loadWidened(const QuantizedInput &input, size_t i)
+{
+    if (input.type == QUANT_FLOAT16) {
+        float lanes[4];
+        halvesToFloats((const uint16_t *) input.data + i, lanes, 4);
+        return v_load(lanes);
+    }
+    if (input.type == QUANT_UINT8) {
+        return v_cvt_f32(v_reinterpret_as_s32(v_load_expand_q((const uchar *) input.data + i)));
+    }
+    if (input.type == QUANT_UINT16) {
+        return v_cvt_f32(v_reinterpret_as_s32(v_load_expand((const ushort *) input.data + i)));
+    }
+    return v_cvt_f32(v_load_expand((const short *) input.data + i));
+}
+
+/*
+ * Average elements [begin, end) of the input into w.
+ */
+static void updateChunk(const QuantizedInput &input, float *w, float alpha, size_t begin, size_t end)
+{
+    size_t channels = input.scales.size();
+
+    // Least common multiple of channels and 4, after which the scales repeat across lanes
+    size_t span = channels % 4 == 0 ? channels : channels % 2 == 0 ? channels * 2 : channels * 4;
+    float scales[4 * QUANT_MAX_CHANNELS];
+    float offsets[4 * QUANT_MAX_CHANNELS];
+    for (size_t j = 0; j < span; ++j) {
+        scales[j] = input.scales[j % channels];
+        offsets[j] = input.offsets[j % channels];
+    }
+
+    // A first input replaces W, which may not be initialized
+    bool replace = alpha >= 1.0f;
+    auto update = [&](size_t i) {
+        float x = dequantize(input, i);
+        w[i] = replace ? x : ((1 - alpha) * w[i]) + (alpha * x);
+    };
+
+    v_float32x4 a = v_setall_f32(alpha);
+    v_float32x4 keep = v_setall_f32(1.0f - alpha);
+    size_t i = begin;
+    for (; i < end && i % span != 0; ++i) update(i);
+    for (; i + span <= end; i += span) {
+        for (size_t v = 0; v < span; v += 4) {
+            size_t f = i + v;
+            v_float32x4 x = v_muladd(loadWidened(input, f), v_load(scales + v), v_load(offsets + v));
+            v_store(w + f, replace ? x : v_muladd(keep, v_load(w + f), a * x));
+        }
+    }
+    for (; i < end; ++i) update(i);
+}
+
+std::shared_ptr<ThreadPool::Job> updateHostQuantized(const QuantizedInput &input, float *w, float alpha,
+                                                     cl_ulong size)
+{
+    // Copied, as the job may outlive the caller's description of the input
+    QuantizedInput copied = input;
+    return threadPool.parallelFor(0, (size_t) size, QUANT_GRAIN, [=](size_t begin, size_t end) {
+        updateChunk(copied, w, alpha, begin, end);
+    });
+}
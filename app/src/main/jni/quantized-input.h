@@ -0,0 +1,80 @@
+/**
+ * quantized-input.h
+ * @author Jonathan Dowdall
+ * @since 10-18-2026
+ */
+
+#ifndef UPDATEWEIGHTS_QUANTIZED_INPUT_H
+#define UPDATEWEIGHTS_QUANTIZED_INPUT_H
+
+#include <stdint.h>
+#include <memory>
+#include <vector>
+
+#include "common.h"
+#include "half-storage.h"
+#include "thread-pool.h"
+
+/** Most channels with a scale and offset of their own */
+#define QUANT_MAX_CHANNELS 64
+
+/** Type of a quantized input. Values match the QUANT_* defines in UpdateWeights.cl. */
+enum QuantizedType
+{
+    QUANT_UINT8 = 0,
+    QUANT_UINT16 = 1,
+    QUANT_INT16 = 2,
+    QUANT_FLOAT16 = 3,
+};
+
+/** Input of integers, as read from sensors and cameras, or of halves, standing for scale * q + offset.
+ *
+ * Element i belongs to channel i % channels, as with interleaved pixels; a single
+ * channel scales the whole vector alike. Elements go to the device as they are
+ * and are dequantized by the update itself, so no float copy of the input is made.
+ */
+struct QuantizedInput
+{
+    QuantizedType type;
+    const void *data;
+
+    /** Scale and offset of each channel */
+    std::vector<float> scales;
+    std::vector<float> offsets;
+};
+
+/*
+ * Bytes per element of the given type.
+ */
+size_t quantizedBytes(QuantizedType type);
+
+/*
+ * Element i of the input, dequantized.
+ */
+float dequantize(const QuantizedInput &input, size_t i);
+
+/*
+ * Largest magnitude any element of the input can dequantize to, given its type, scales and offsets.
+ */
+float quantizedRange(const QuantizedInput &input);
+
+/*
+ * Queue averaging the input, already in raw on the device, into device W with share alpha.
+ * W is stored as storage has it, rounded with the bits of the given step.
+ */
+cl_int enqueueQuantizedUpdate(const QuantizedInput &input, cl_mem w, cl_mem raw, cl_mem params, float alpha,
+                              cl_mem dirty, const HalfStorage &storage, unsigned int step, cl_ulong size);
+
+/*
+ * Copy the scale and offset of each channel into a new device buffer, as the kernel reads them.
+ * Returns NULL on failure.
+ */
+cl_mem uploadQuantizedParams(const QuantizedInput &input);
+
+/*
+ * Average the input into host W with share alpha on the thread pool.
+ */
+std::shared_ptr<ThreadPool::Job> updateHostQuantized(const QuantizedInput &input, float *w, float alpha,
+                                                     cl_ulong size);
+
+#endif // UPDATEWEIGHTS_QUANTIZED_INPUT_H
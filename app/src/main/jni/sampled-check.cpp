@@ -0,0 +1,106 @@
+/**
+ * sampled-check.cpp
+ * @author Jonathan Dowdall
+ * @since 10-18-2026
+ */
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <random>
+#include <unordered_set>
+
+#include "sampled-check.h"
+
+/** Normal quantile of the one-sided 95% bounds */
+#define CONFIDENCE_Z 1.645
+
+void drawSample(ShadowSample &sample, cl_ulong size, cl_ulong count, bool stratified)
+{
+    std::mt19937_64 random(std::random_device{}());
+    count = std::min(count, size);
+
+    sample.stratified = stratified;
+    sample.indices.clear();
+    sample.indices.reserve((size_t) count);
+    sample.values.assign((size_t) count, 0.0f);
+    if (count == 0) return;
+
+    if (stratified) {
+        // One index drawn from each of count equal strata, so every region of W is covered
+        for (uint64_t s = 0; s < count; ++s) {
+            uint64_t begin = s * size / count;
+            uint64_t end = (s + 1) * size / count;
+            std::uniform_int_distribution<uint64_t> pick(begin, end - 1);
+            sample.indices.push_back(pick(random));
+        }
+        return;
+    }
+
+    // Floyd's algorithm: count distinct indices without touching the other size - count
+    std::unordered_set<uint64_t> chosen;
+    for (uint64_t j = size - count; j < size; ++j) {
+        std::uniform_int_distribution<uint64_t> pick(0, j);
+        uint64_t index = pick(random);
+        if (!chosen.insert(index).second) chosen.insert(j);
+    }
+    sample.indices.assign(chosen.begin(), chosen.end());
+    std::sort(sample.indices.begin(), sample.indices.end());
+}
+
+void updateShadow(ShadowSample &sample, const float *input, float alpha)
+{
+    for (size_t j = 0; j < sample.indices.size(); ++j) {
+        float value = input[sample.indices[j]];
+        sample.values[j] = alpha >= 1.0f ? value : ((1 - alpha) * sample.values[j]) + (alpha * value);
+    }
+}
+
+SampleEstimate estimateError(const ShadowSample &sample, const float *gpuValues)
+{
+    SampleEstimate estimate = SampleEstimate();
+    size_t n = sample.indices.size();
+    estimate.samples = n;
+    if (n == 0) return estimate;
+
+    // Ratio estimator of |W_gpu - W_cpu|^2 / |W_cpu|^2 over the sample
+    double differenceSquares = 0.0, cpuSquares = 0.0;
+    for (size_t j = 0; j < n; ++j) {
+        double cpu = sample.values[j];
+        double difference = (double) gpuValues[j] - cpu;
+        differenceSquares += difference * difference;
+        cpuSquares += cpu * cpu;
+        estimate.maxDifference = std::max(estimate.maxDifference, std::fabs(difference));
+        if (std::fabs(difference) > SAMPLE_TOLERANCE * std::max(std::fabs(cpu), (double) FLT_MIN)) {
+            ++estimate.exceeding;
+        }
+    }
+    if (cpuSquares == 0.0) {
+        estimate.relativeError = estimate.relativeErrorBound = differenceSquares == 0.0 ? 0.0 : DBL_MAX;
+    } else {
+        double ratio = differenceSquares / cpuSquares;
+
+        // Delta-method variance of the ratio. Stratified samples vary less than this,
+        // so the bound is conservative for them.
+        double residualSquares = 0.0;
+        for (size_t j = 0; j < n; ++j) {
+            double cpu = sample.values[j];
+            double difference = (double) gpuValues[j] - cpu;
+            double residual = difference * difference - ratio * cpu * cpu;
+            residualSquares += residual * residual;
+        }
+        double meanCpuSquares = cpuSquares / n;
+        double standardError = n > 1 ? std::sqrt(residualSquares / (n - 1) / n) / meanCpuSquares : ratio;
+
+        estimate.relativeError = std::sqrt(ratio);
+        estimate.relativeErrorBound = std::sqrt(ratio + CONFIDENCE_Z * standardError);
+    }
+
+    // Wilson score upper bound; still meaningful when no sampled element exceeds
+    double z2 = CONFIDENCE_Z * CONFIDENCE_Z;
+    double p = (double) estimate.exceeding / n;
+    double centre = p + z2 / (2 * n);
+    double spread = CONFIDENCE_Z * std::sqrt(p * (1 - p) / n + z2 / (4.0 * n * n));
+    estimate.exceedingBound = std::min(1.0, (centre + spread) / (1 + z2 / n));
+    return estimate;
+}
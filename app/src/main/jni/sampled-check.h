@@ -0,0 +1,67 @@
+/**
+ * sampled-check.h
+ * @author Jonathan Dowdall
+ * @since 10-18-2026
+ */
+
+#ifndef UPDATEWEIGHTS_SAMPLED_CHECK_H
+#define UPDATEWEIGHTS_SAMPLED_CHECK_H
+
+#include <stdint.h>
+#include <vector>
+
+#include "common.h"
+
+/** Relative difference beyond which a sampled element counts as exceeding */
+#define SAMPLE_TOLERANCE 1e-4
+
+/** CPU reference kept only for a sample of the elements of W.
+ *
+ * The shadow is updated with every input, like the full CPU W, and compared
+ * against the GPU W at the sampled indices only.
+ */
+struct ShadowSample
+{
+    /** Sampled indices of W in increasing order, and the CPU average at each */
+    std::vector<uint64_t> indices;
+    std::vector<float> values;
+
+    /** Whether the indices were drawn one per stratum of W rather than uniformly */
+    bool stratified;
+};
+
+/** What a sample says about the error of the whole GPU W */
+struct SampleEstimate
+{
+    cl_ulong samples;
+
+    /** Estimated relative L2 error of W, and its one-sided 95% upper confidence bound */
+    double relativeError;
+    double relativeErrorBound;
+
+    /** Largest absolute difference seen in the sample */
+    double maxDifference;
+
+    /** Sampled elements off by more than SAMPLE_TOLERANCE relative, and a 95% upper
+     *  confidence bound on the fraction of all of W that is */
+    cl_ulong exceeding;
+    double exceedingBound;
+};
+
+/*
+ * Draw count distinct indices out of size, uniformly or one per stratum.
+ * The shadow values are left to the caller to load.
+ */
+void drawSample(ShadowSample &sample, cl_ulong size, cl_ulong count, bool stratified);
+
+/*
+ * Average one input into the shadow, as the update kernel does into W.
+ */
+void updateShadow(ShadowSample &sample, const float *input, float alpha);
+
+/*
+ * Compare the GPU values of W at the sampled indices against the shadow.
+ */
+SampleEstimate estimateError(const ShadowSample &sample, const float *gpuValues);
+
+#endif // UPDATEWEIGHTS_SAMPLED_CHECK_H
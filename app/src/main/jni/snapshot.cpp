@@ -0,0 +1,124 @@
+/**
+ * snapshot.cpp
+ * @author Jonathan Dowdall
+ * @since 10-18-2026
+ */
+
+#include <algorithm>
+
+#include "snapshot.h"
+#include "buffer-pool.h"
+
+int takeSnapshot(Snapshot &snapshot, cl_mem w, const float *host, cl_ulong size, bool half)
+{
+    cl_int err;
+
+    snapshot.buffer = NULL;
+    snapshot.ready = NULL;
+    snapshot.size = size;
+    if (size == 0) return 1;
+
+    // Tiled W is only ever complete on the host
+    if (w == NULL) {
+        snapshot.host.assign(host, host + size);
+        return 1;
+    }
+
+    snapshot.buffer = bufferPool.allocate(size * sizeof(float), CL_MEM_READ_WRITE, &err);
+    SAMPLE_CHECK_ERRORS(err);
+
+    if (half) {
+        err = clSetKernelArg(cl.widenHalfW, 0, sizeof(cl_mem), &w);
+        err |= clSetKernelArg(cl.widenHalfW, 1, sizeof(cl_ulong), &size);
+        err |= clSetKernelArg(cl.widenHalfW, 2, sizeof(cl_mem), &snapshot.buffer);
+
+        size_t globalSize = (size_t) size;
+        if (err == CL_SUCCESS) err = clEnqueueNDRangeKernel
+                (
+                        cl.queue, // command_queue
+                        cl.widenHalfW, // kernel
+                        1, // work_dim
+                        NULL, // *global_work_offset
+                        &globalSize, // *global_work_size
+                        NULL, // *local_work_size
+                        0, // num_events_in_wait_list
+                        NULL, // *event_wait_list
+                        &snapshot.ready // *event
+                );
+    } else {
+        err = clEnqueueCopyBuffer
+                (
+                        cl.queue, // command_queue
+                        w, // src_buffer
+                        snapshot.buffer, // dst_buffer
+                        0, // src_offset
+                        0, // dst_offset
+                        size * sizeof(float), // cb
+                        0, // num_events_in_wait_list
+                        NULL, // *event_wait_list
+                        &snapshot.ready // *event
+                );
+    }
+    if (err != CL_SUCCESS) {
+        bufferPool.release(snapshot.buffer);
+        snapshot.buffer = NULL;
+    }
+    SAMPLE_CHECK_ERRORS(err);
+
+    // Start the copy now rather than with the next step's clFinish
+    clFlush(cl.queue);
+    return 1;
+}
+
+bool snapshotReady(const Snapshot &snapshot)
+{
+    if (snapshot.ready == NULL) return true;
+
+    cl_int status = CL_QUEUED;
+    clGetEventInfo(snapshot.ready, CL_EVENT_COMMAND_EXECUTION_STATUS, sizeof(status), &status, NULL);
+    return status == CL_COMPLETE;
+}
+
+int readSnapshot(const Snapshot &snapshot, cl_ulong begin, cl_ulong count, float *out)
+{
+    if (begin + count > snapshot.size) {
+        LOGE("Range of %llu elements at %llu is outside of the snapshot\n",
+             (unsigned long long) count, (unsigned long long) begin);
+        return 0;
+    }
+    if (count == 0) return 1;
+
+    if (snapshot.buffer == NULL) {
+        std::copy(snapshot.host.begin() + begin, snapshot.host.begin() + begin + count, out);
+        return 1;
+    }
+
+    // On the read queue, ordered after the copy only
+    cl_int err = clEnqueueReadBuffer
+            (
+                    cl.readQueue, // command_queue
+                    snapshot.buffer, // buffer
+                    true, // blocking_read
+                    begin * sizeof(float), // offset
+                    count * sizeof(float), // cb
+                    out, // *ptr
+                    1, // num_events_in_wait_list
+                    &snapshot.ready, // *event_wait_list
+                    NULL // *event
+            );
+    SAMPLE_CHECK_ERRORS(err);
+    return 1;
+}
+
+void releaseSnapshot(Snapshot &snapshot)
+{
+    // The copy may still be running; the buffer must not be handed out before it is done
+    if (snapshot.ready != NULL) {
+        clWaitForEvents(1, &snapshot.ready);
+        clReleaseEvent(snapshot.ready);
+    }
+    bufferPool.release(snapshot.buffer);
+    snapshot.buffer = NULL;
+    snapshot.ready = NULL;
+    snapshot.host.clear();
+}
@@ -0,0 +1,58 @@
+/**
+ * snapshot.h
+ * @author Jonathan Dowdall
+ * @since 10-18-2026
+ */
+
+#ifndef UPDATEWEIGHTS_SNAPSHOT_H
+#define UPDATEWEIGHTS_SNAPSHOT_H
+
+#include <vector>
+
+#include "common.h"
+
+/** Copy of W as it was after a given step, readable while updates go on.
+ *
+ * For resident W the copy is a device buffer filled by a copy queued between
+ * two update steps on the in-order queue, so taking it never waits for the
+ * device. W stored as halves is widened as it is copied, so a snapshot holds
+ * floats whatever W is stored as. Reads go through a queue of their own and only wait for that copy,
+ * never for the updates queued after it.
+ */
+struct Snapshot
+{
+    /** Device copy of resident W, or NULL when W was tiled and copied to host */
+    cl_mem buffer;
+    std::vector<float> host;
+
+    /** Completes once the device copy has been made */
+    cl_event ready;
+
+    /** Elements in the copy, and the step count and total input weight W had at that point */
+    cl_ulong size;
+    cl_ulong step;
+    cl_double weight;
+};
+
+/*
+ * Queue a copy of the size elements of resident W in w, stored as halves if half is set,
+ * or copy tiled W from host. Must be called between two steps.
+ */
+int takeSnapshot(Snapshot &snapshot, cl_mem w, const float *host, cl_ulong size, bool half);
+
+/*
+ * Whether the copy has completed, without waiting for it.
+ */
+bool snapshotReady(const Snapshot &snapshot);
+
+/*
+ * Read count elements of the copy starting at begin, waiting for the copy if needed.
+ */
+int readSnapshot(const Snapshot &snapshot, cl_ulong begin, cl_ulong count, float *out);
+
+/*
+ * Release the copy and its event.
+ */
+void releaseSnapshot(Snapshot &snapshot);
+
+#endif // UPDATEWEIGHTS_SNAPSHOT_H
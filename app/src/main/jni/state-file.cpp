@@ -0,0 +1,197 @@
+/**
+ * state-file.cpp
+ * @author Jonathan Dowdall
+ * @since 10-18-2026
+ */
+
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE // mremap
+#endif
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <stdint.h>
+#include <cstring>
+#include <algorithm>
+
+#include "state-file.h"
+
+/*
+ * Bytes of a state file holding capacity elements, 0 if it cannot be mapped.
+ */
+static size_t fileBytes(cl_ulong capacity)
+{
+    if (capacity > (SIZE_MAX - STATE_HEADER_BYTES) / sizeof(float)) {
+        LOGE("%llu elements exceed the host address space\n", (unsigned long long) capacity);
+        return 0;
+    }
+    return STATE_HEADER_BYTES + capacity * sizeof(float);
+}
+
+/*
+ * Map the header and capacity elements of an open state file.
+ */
+static int mapStateFile(StateFile &state, cl_ulong capacity)
+{
+    size_t bytes = fileBytes(capacity);
+    if (bytes == 0) return 0;
+
+    void *pointer = mmap(NULL, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, state.fd, 0);
+    if (pointer == MAP_FAILED) {
+        LOGE("Cannot map %lu bytes of state file\n", (unsigned long) bytes);
+        return 0;
+    }
+
+    state.header = (StateHeader *) pointer;
+    state.data = (float *) ((char *) pointer + STATE_HEADER_BYTES);
+    state.capacity = capacity;
+    return 1;
+}
+
+int createStateFile(StateFile &state, const char *path, cl_ulong size)
+{
+    state = StateFile();
+    size_t bytes = fileBytes(size);
+    if (bytes == 0) return 0;
+
+    state.fd = open(path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (state.fd < 0) {
+        LOGE("Cannot create state file %s\n", path);
+        return 0;
+    }
+    if (ftruncate(state.fd, bytes) != 0 || !mapStateFile(state, size)) {
+        LOGE("Cannot size state file %s\n", path);
+        close(state.fd);
+        state = StateFile();
+        return 0;
+    }
+
+    // Not clean until the first checkpoint has written the data
+    memcpy(state.header->magic, STATE_FILE_MAGIC, sizeof(state.header->magic));
+    state.header->version = STATE_FILE_VERSION;
+    state.header->elementType = ELEMENT_FLOAT32;
+    state.header->mode = MODE_CUMULATIVE;
+    state.header->clean = 0;
+    state.header->count = 0;
+    state.header->size = size;
+    state.header->weight = 0;
+    msync(state.header, STATE_HEADER_BYTES, MS_SYNC);
+    return 1;
+}
+
+int openStateFile(StateFile &state, const char *path)
+{
+    state = StateFile();
+
+    state.fd = open(path, O_RDWR);
+    if (state.fd < 0) {
+        LOGE("Cannot open state file %s\n", path);
+        return 0;
+    }
+
+    // Validate the header before trusting any of its sizes
+    StateHeader header;
+    struct stat info;
+    const char *problem = NULL;
+    if (pread(state.fd, &header, sizeof(header), 0) != (ssize_t) sizeof(header)
+        || fstat(state.fd, &info) != 0) {
+        problem = "truncated";
+    } else if (memcmp(header.magic, STATE_FILE_MAGIC, sizeof(header.magic)) != 0) {
+        problem = "not a state file";
+    } else if (header.version < 1 || header.version > STATE_FILE_VERSION) {
+        problem = "unsupported version";
+    } else if (header.elementType != ELEMENT_FLOAT32) {
+        problem = "unsupported element type";
+    } else if (!header.clean) {
+        problem = "interrupted checkpoint";
+    } else if ((cl_ulong) info.st_size < STATE_HEADER_BYTES
+               || header.size > ((cl_ulong) info.st_size - STATE_HEADER_BYTES) / sizeof(float)) {
+        problem = "shorter than its header claims";
+    }
+
+    if (problem != NULL || !mapStateFile(state, ((cl_ulong) info.st_size - STATE_HEADER_BYTES) / sizeof(float))) {
+        LOGE("Cannot restore %s: %s\n", path, problem != NULL ? problem : "mapping failed");
+        close(state.fd);
+        state = StateFile();
+        return 0;
+    }
+
+    // Restore uploads the whole of W once
+    madvise(state.data, header.size * sizeof(float), MADV_SEQUENTIAL);
+    return 1;
+}
+
+int resizeStateFile(StateFile &state, cl_ulong size)
+{
+    if (size <= state.capacity) return 1;
+
+    cl_ulong capacity = std::max(state.capacity * 2, size);
+    size_t bytes = fileBytes(capacity);
+    if (bytes == 0) {
+        capacity = size;
+        bytes = fileBytes(capacity);
+    }
+    if (bytes == 0) return 0;
+
+    if (ftruncate(state.fd, bytes) != 0) {
+        LOGE("Cannot grow state file to %lu bytes\n", (unsigned long) bytes);
+        return 0;
+    }
+
+    void *pointer = mremap(state.header, fileBytes(state.capacity), bytes, MREMAP_MAYMOVE);
+    if (pointer == MAP_FAILED) {
+        LOGE("Cannot grow state mapping to %lu bytes\n", (unsigned long) bytes);
+        return 0;
+    }
+
+    state.header = (StateHeader *) pointer;
+    state.data = (float *) ((char *) pointer + STATE_HEADER_BYTES);
+    state.capacity = capacity;
+    return 1;
+}
+
+int beginCheckpoint(StateFile &state)
+{
+    state.header->clean = 0;
+    if (msync(state.header, STATE_HEADER_BYTES, MS_SYNC) != 0) {
+        LOGE("Cannot sync state header\n");
+        return 0;
+    }
+    return 1;
+}
+
+int commitCheckpoint(StateFile &state, cl_ulong count, cl_double weight, cl_ulong size)
+{
+    // Only dirty pages are written; the header page goes last so it never describes unwritten data
+    if (msync(state.header, fileBytes(size), MS_SYNC) != 0) {
+        LOGE("Cannot sync state data\n");
+        return 0;
+    }
+
+    state.header->version = STATE_FILE_VERSION;
+    state.header->count = count;
+    state.header->size = size;
+    state.header->weight = weight;
+    state.header->clean = 1;
+    if (msync(state.header, STATE_HEADER_BYTES, MS_SYNC) != 0) {
+        LOGE("Cannot sync state header\n");
+        return 0;
+    }
+    return 1;
+}
+
+cl_double stateWeight(const StateFile &state)
+{
+    return state.header->version >= 2 ? state.header->weight : (cl_double) state.header->count;
+}
+
+void closeStateFile(StateFile &state)
+{
+    if (state.header == NULL) return;
+
+    munmap(state.header, fileBytes(state.capacity));
+    close(state.fd);
+    state = StateFile();
+}
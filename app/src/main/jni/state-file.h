@@ -0,0 +1,112 @@
+/**
+ * state-file.h
+ * @author Jonathan Dowdall
+ * @since 10-18-2026
+ */
+
+#ifndef UPDATEWEIGHTS_STATE_FILE_H
+#define UPDATEWEIGHTS_STATE_FILE_H
+
+#include "common.h"
+
+/** Identifies an averaging state file */
+#define STATE_FILE_MAGIC "UPDWSTAT"
+
+/** Bumped whenever the layout of StateHeader or the data changes.
+ *  Version 1 had no weight; its inputs all weighed 1. */
+#define STATE_FILE_VERSION 2
+
+/** Bytes before the elements of W; one page so the data can be mapped and synced on its own */
+#define STATE_HEADER_BYTES 4096
+
+/** W is tracked for incremental checkpoints in tiles of 1 << DIRTY_TILE_SHIFT elements */
+#define DIRTY_TILE_SHIFT 16
+#define DIRTY_TILE_SIZE ((cl_ulong) 1 << DIRTY_TILE_SHIFT)
+
+/** Header at the start of a state file.
+ *
+ * The elements of W follow at STATE_HEADER_BYTES. A checkpoint clears clean
+ * before touching the data and sets it again, together with the new count,
+ * only once the data is on disk, so a crash mid-checkpoint is detected on restore.
+ * Tiled W mapped from the file clears it before its first change after a checkpoint.
+ */
+struct StateHeader
+{
+    /** STATE_FILE_MAGIC, not null-terminated */
+    char magic[8];
+
+    /** STATE_FILE_VERSION of the writer */
+    cl_uint version;
+
+    /** ElementType of the stored elements */
+    cl_uint elementType;
+
+    /** AveragingMode the averages were computed with */
+    cl_uint mode;
+
+    /** 1 if data matches count, 0 while a checkpoint is being written */
+    cl_uint clean;
+
+    /** Number of inputs averaged into W (the step counter t) */
+    cl_ulong count;
+
+    /** Number of elements in W */
+    cl_ulong size;
+
+    /** Sum of the weights of the inputs averaged into W */
+    cl_double weight;
+};
+
+/** W and its metadata mapped from a state file */
+struct StateFile
+{
+    /** Open state file, -1 if none */
+    int fd = -1;
+
+    /** Mapped header, followed by the data */
+    StateHeader *header = NULL;
+
+    /** Mapped elements of W */
+    float *data = NULL;
+
+    /** Number of elements the mapping can hold */
+    cl_ulong capacity = 0;
+};
+
+/*
+ * Create, or truncate, a state file at path holding size elements and map it.
+ */
+int createStateFile(StateFile &state, const char *path, cl_ulong size);
+
+/*
+ * Map an existing state file, rejecting unknown versions and interrupted checkpoints.
+ */
+int openStateFile(StateFile &state, const char *path);
+
+/*
+ * Grow the file and its mapping to hold size elements, doubling its capacity.
+ * The mapping may move; data is updated accordingly.
+ */
+int resizeStateFile(StateFile &state, cl_ulong size);
+
+/*
+ * Mark the file as being written. Call before modifying data.
+ */
+int beginCheckpoint(StateFile &state);
+
+/*
+ * Flush the first size elements of data, then record count, weight and size in the header.
+ */
+int commitCheckpoint(StateFile &state, cl_ulong count, cl_double weight, cl_ulong size);
+
+/*
+ * Sum of the input weights recorded in a mapped state file.
+ */
+cl_double stateWeight(const StateFile &state);
+
+/*
+ * Unmap and close the file.
+ */
+void closeStateFile(StateFile &state);
+
+#endif // UPDATEWEIGHTS_STATE_FILE_H
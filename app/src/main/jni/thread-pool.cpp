@@ -0,0 +1,109 @@
+/**
+ * thread-pool.cpp
+ * @author Jonathan Dowdall
+ * @since 10-18-2026
+ */
+
+#include <algorithm>
+
+#include "thread-pool.h"
+
+/** Global pool shared by the host loops of every engine in the process */
+ThreadPool threadPool;
+
+bool ThreadPool::Job::runChunk()
+{
+    size_t index = next.fetch_add(1);
+    if (index >= chunks) return false;
+
+    size_t first = begin + index * chunk;
+    body(first, std::min(first + chunk, end));
+
+    if (remaining.fetch_sub(1) == 1) {
+        std::lock_guard<std::mutex> lock(mutex);
+        finished = std::chrono::steady_clock::now();
+        done.notify_all();
+    }
+    return true;
+}
+
+void ThreadPool::Job::wait()
+{
+    while (runChunk()) {}
+
+    std::unique_lock<std::mutex> lock(mutex);
+    done.wait(lock, [this] { return remaining == 0; });
+}
+
+ThreadPool::ThreadPool()
+    : stopping(false)
+{
+}
+
+ThreadPool::~ThreadPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    queued.notify_all();
+    for (size_t i = 0; i < workers.size(); ++i) workers[i].join();
+}
+
+void ThreadPool::start()
+{
+    // The thread joining a loop works on it as well
+    if (!workers.empty()) return;
+    unsigned count = std::max(std::thread::hardware_concurrency(), 2u) - 1;
+    for (unsigned i = 0; i < count; ++i) workers.push_back(std::thread(&ThreadPool::run, this));
+}
+
+unsigned ThreadPool::concurrency()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    start();
+    return (unsigned) workers.size() + 1;
+}
+
+std::shared_ptr<ThreadPool::Job> ThreadPool::parallelFor(size_t begin, size_t end, size_t grain,
+                                                         std::function<void(size_t, size_t)> body)
+{
+    std::shared_ptr<Job> job = std::make_shared<Job>();
+    job->body = body;
+    job->begin = begin;
+    job->end = std::max(begin, end);
+
+    // A few chunks per thread balance uneven progress without much queueing
+    std::lock_guard<std::mutex> lock(mutex);
+    start();
+    size_t count = job->end - begin;
+    size_t target = (workers.size() + 1) * 4;
+    job->chunk = std::max<size_t>(std::max<size_t>(grain, 1), (count + target - 1) / target);
+    job->chunks = (count + job->chunk - 1) / job->chunk;
+    job->next = 0;
+    job->remaining = job->chunks;
+    job->finished = std::chrono::steady_clock::now();
+
+    if (job->chunks > 0) {
+        queue.push_back(job);
+        queued.notify_all();
+    }
+    return job;
+}
+
+void ThreadPool::run()
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    while (true) {
+        queued.wait(lock, [this] { return stopping || !queue.empty(); });
+        if (stopping) return;
+
+        std::shared_ptr<Job> job = queue.front();
+        lock.unlock();
+        while (job->runChunk()) {}
+        lock.lock();
+
+        // Every chunk is claimed; whoever gets here first retires the job
+        if (!queue.empty() && queue.front() == job) queue.pop_front();
+    }
+}
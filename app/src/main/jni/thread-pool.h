@@ -0,0 +1,89 @@
+/**
+ * thread-pool.h
+ * @author Jonathan Dowdall
+ * @since 10-18-2026
+ */
+
+#ifndef UPDATEWEIGHTS_THREAD_POOL_H
+#define UPDATEWEIGHTS_THREAD_POOL_H
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/** Worker threads running the chunks of parallel loops over host arrays.
+ *
+ * parallelFor returns as soon as the loop is queued, so the caller can go on
+ * with other work, such as waiting for the device, and join the loop later.
+ * Joining helps run the chunks not yet claimed by a worker.
+ */
+class ThreadPool
+{
+public:
+    /** A parallel loop queued on the pool */
+    class Job
+    {
+    public:
+        /*
+         * Run unclaimed chunks on the calling thread, then wait for the others.
+         */
+        void wait();
+
+        /*
+         * When the last chunk finished. Only valid after wait.
+         */
+        std::chrono::steady_clock::time_point finishTime() const { return finished; }
+
+    private:
+        friend class ThreadPool;
+
+        /*
+         * Claim and run one chunk. Returns false once every chunk has been claimed.
+         */
+        bool runChunk();
+
+        std::function<void(size_t, size_t)> body;
+        size_t begin, end, chunk, chunks;
+        std::atomic<size_t> next;
+        std::atomic<size_t> remaining;
+        std::chrono::steady_clock::time_point finished;
+
+        std::mutex mutex;
+        std::condition_variable done;
+    };
+
+    ThreadPool();
+    ~ThreadPool();
+
+    /*
+     * Queue body over [begin, end), split into chunks of at least grain elements.
+     */
+    std::shared_ptr<Job> parallelFor(size_t begin, size_t end, size_t grain,
+                                     std::function<void(size_t, size_t)> body);
+
+    /*
+     * Number of threads loops run on, including the one joining them.
+     */
+    unsigned concurrency();
+
+private:
+    void start();
+    void run();
+
+    std::vector<std::thread> workers;
+    std::mutex mutex;
+    std::condition_variable queued;
+    std::deque<std::shared_ptr<Job>> queue;
+    bool stopping;
+};
+
+/** Global pool shared by the host loops of every engine in the process */
+extern ThreadPool threadPool;
+
+#endif // UPDATEWEIGHTS_THREAD_POOL_H
@@ -0,0 +1,259 @@
+/**
+ * tiled-w.cpp
+ * @author Jonathan Dowdall
+ * @since 10-18-2026
+ */
+
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE // mremap
+#endif
+
+#include <sys/mman.h>
+#include <stdint.h>
+#include <algorithm>
+
+#include "tiled-w.h"
+#include "buffer-pool.h"
+
+/*
+ * Map capacity elements of anonymous host memory.
+ */
+static float *mapHost(cl_ulong capacity)
+{
+    if (capacity > SIZE_MAX / sizeof(float)) {
+        LOGE("%llu elements exceed the host address space\n", (unsigned long long) capacity);
+        return NULL;
+    }
+    size_t bytes = capacity * sizeof(float);
+
+    void *pointer = mmap
+            (
+                    NULL,
+                    bytes,
+                    PROT_READ | PROT_WRITE,
+                    MAP_PRIVATE | MAP_ANONYMOUS,
+                    -1,
+                    0
+            );
+    if (pointer == MAP_FAILED) {
+        LOGE("Cannot map %lu bytes for W\n", (unsigned long) bytes);
+        return NULL;
+    }
+
+    // Tiles are visited in order on every update
+    madvise(pointer, bytes, MADV_SEQUENTIAL);
+    return (float *) pointer;
+}
+
+int initTiledW(TiledW &tiled, cl_ulong size, float *host)
+{
+    cl_int err;
+
+    tiled = TiledW();
+    tiled.ownsHost = host == NULL;
+    tiled.host = host != NULL ? host : mapHost(size);
+    if (tiled.host == NULL) return 0;
+    tiled.size = size;
+    tiled.capacity = size;
+
+    // Slots have to start on the device base address alignment to be sub-buffers
+    cl_ulong align = gpu.memBaseAlign;
+
+    // Every slot holds a tile of W and a tile of the input
+    cl_ulong tileBytes = std::min(gpu.maxAllocSize, gpu.globalMem / 4) / (2 * TILE_RING_SIZE);
+    tileBytes = std::min<cl_ulong>(tileBytes, MAX_TILE_BYTES);
+    tileBytes -= tileBytes % align;
+    tiled.tileSize = tileBytes / sizeof(float);
+
+    tiled.ring = bufferPool.allocate(2 * TILE_RING_SIZE * tileBytes, CL_MEM_READ_WRITE, &err);
+    if (err != CL_SUCCESS) releaseTiledW(tiled);
+    SAMPLE_CHECK_ERRORS(err);
+
+    for (int slot = 0; slot < TILE_RING_SIZE; ++slot) {
+        cl_buffer_region region = { (size_t) (2 * slot * tileBytes), (size_t) tileBytes };
+        tiled.wSlots[slot] = clCreateSubBuffer
+                (
+                        tiled.ring,
+                        CL_MEM_READ_WRITE,
+                        CL_BUFFER_CREATE_TYPE_REGION,
+                        &region,
+                        &err
+                );
+        if (err != CL_SUCCESS) releaseTiledW(tiled);
+        SAMPLE_CHECK_ERRORS(err);
+
+        region.origin += tileBytes;
+        tiled.inputSlots[slot] = clCreateSubBuffer
+                (
+                        tiled.ring,
+                        CL_MEM_READ_ONLY,
+                        CL_BUFFER_CREATE_TYPE_REGION,
+                        &region,
+                        &err
+                );
+        if (err != CL_SUCCESS) releaseTiledW(tiled);
+        SAMPLE_CHECK_ERRORS(err);
+    }
+
+    tiled.uploadQueue = clCreateCommandQueue(cl.context, cl.device, 0, &err);
+    if (err != CL_SUCCESS) releaseTiledW(tiled);
+    SAMPLE_CHECK_ERRORS(err);
+
+    tiled.downloadQueue = clCreateCommandQueue(cl.context, cl.device, 0, &err);
+    if (err != CL_SUCCESS) releaseTiledW(tiled);
+    SAMPLE_CHECK_ERRORS(err);
+
+    LOGD("Tiled W: %llu elements in tiles of %llu",
+         (unsigned long long) tiled.size, (unsigned long long) tiled.tileSize);
+    return 1;
+}
+
+int resizeTiledW(TiledW &tiled, cl_ulong size)
+{
+    if (size <= tiled.capacity) {
+        tiled.size = size;
+        return 1;
+    }
+    if (!tiled.ownsHost) {
+        LOGE("Borrowed W has to be grown by its owner\n");
+        return 0;
+    }
+
+    cl_ulong capacity = std::max(tiled.capacity * 2, size);
+    if (capacity > SIZE_MAX / sizeof(float)) capacity = size;
+    if (size > SIZE_MAX / sizeof(float)) {
+        LOGE("%llu elements exceed the host address space\n", (unsigned long long) size);
+        return 0;
+    }
+
+    size_t bytes = capacity * sizeof(float);
+    void *pointer = mremap(tiled.host, tiled.capacity * sizeof(float), bytes, MREMAP_MAYMOVE);
+    if (pointer == MAP_FAILED) {
+        LOGE("Cannot grow W to %lu bytes\n", (unsigned long) bytes);
+        return 0;
+    }
+    madvise(pointer, bytes, MADV_SEQUENTIAL);
+
+    tiled.host = (float *) pointer;
+    tiled.capacity = capacity;
+    tiled.size = size;
+    return 1;
+}
+
+int updateTiledW(TiledW &tiled, const float *input, float alpha)
+{
+    cl_int err;
+
+    if (alpha >= 1.0f) {
+        // Average of a single input is the input itself; no device round trip needed
+        std::copy(input, input + tiled.size, tiled.host);
+        return 1;
+    }
+
+    // Tiles are marked dirty on the host; every one of them is written
+    err = clSetKernelArg(cl.updateWeights, 2, sizeof(float), &alpha);
+    err |= clSetKernelArg(cl.updateWeights, 3, sizeof(cl_mem), NULL);
+    SAMPLE_CHECK_ERRORS(err);
+
+    cl_event uploaded[TILE_RING_SIZE] = { NULL };
+    cl_event computed[TILE_RING_SIZE] = { NULL };
+    cl_event downloaded[TILE_RING_SIZE] = { NULL };
+
+    cl_ulong tiles = (tiled.size + tiled.tileSize - 1) / tiled.tileSize;
+    for (cl_ulong tile = 0; tile < tiles; ++tile) {
+        int slot = tile % TILE_RING_SIZE;
+        cl_ulong offset = tile * tiled.tileSize;
+        size_t count = (size_t) std::min(tiled.tileSize, tiled.size - offset);
+
+        // A slot is free again once the tile that last used it has been downloaded
+        cl_uint numWait = downloaded[slot] != NULL ? 1 : 0;
+        err = clEnqueueWriteBuffer
+                (
+                        tiled.uploadQueue, // command_queue
+                        tiled.wSlots[slot], // buffer
+                        false, // blocking_write
+                        0, // offset
+                        count * sizeof(float), // cb
+                        tiled.host + offset, // *ptr
+                        numWait, // num_events_in_wait_list
+                        numWait ? &downloaded[slot] : NULL, // *event_wait_list
+                        NULL // *event
+                );
+        err |= clEnqueueWriteBuffer
+                (
+                        tiled.uploadQueue, // command_queue
+                        tiled.inputSlots[slot], // buffer
+                        false, // blocking_write
+                        0, // offset
+                        count * sizeof(float), // cb
+                        input + offset, // *ptr
+                        0, // num_events_in_wait_list
+                        NULL, // *event_wait_list
+                        &uploaded[slot] // *event
+                );
+        SAMPLE_CHECK_ERRORS(err);
+        clFlush(tiled.uploadQueue);
+        if (downloaded[slot] != NULL) clReleaseEvent(downloaded[slot]);
+        downloaded[slot] = NULL;
+
+        err = clSetKernelArg(cl.updateWeights, 0, sizeof(cl_mem), &tiled.wSlots[slot]);
+        err |= clSetKernelArg(cl.updateWeights, 1, sizeof(cl_mem), &tiled.inputSlots[slot]);
+        SAMPLE_CHECK_ERRORS(err);
+
+        size_t globalDimensions[3] = {count, 1, 1};
+        err = clEnqueueNDRangeKernel
+                (
+                        cl.queue, // command_queue
+                        cl.updateWeights, // kernel
+                        3, // work_dim
+                        NULL, // *global_work_offset
+                        globalDimensions, // *global_work_size
+                        NULL, // *local_work_size
+                        1, // num_events_in_wait_list
+                        &uploaded[slot], // *event_wait_list
+                        &computed[slot] // *event
+                );
+        SAMPLE_CHECK_ERRORS(err);
+        clFlush(cl.queue);
+        clReleaseEvent(uploaded[slot]);
+
+        err = clEnqueueReadBuffer
+                (
+                        tiled.downloadQueue, // command_queue
+                        tiled.wSlots[slot], // buffer
+                        false, // blocking_read
+                        0, // offset
+                        count * sizeof(float), // cb
+                        tiled.host + offset, // *ptr
+                        1, // num_events_in_wait_list
+                        &computed[slot], // *event_wait_list
+                        &downloaded[slot] // *event
+                );
+        SAMPLE_CHECK_ERRORS(err);
+        clFlush(tiled.downloadQueue);
+        clReleaseEvent(computed[slot]);
+    }
+
+    err = clFinish(tiled.downloadQueue);
+    for (int slot = 0; slot < TILE_RING_SIZE; ++slot) {
+        if (downloaded[slot] != NULL) clReleaseEvent(downloaded[slot]);
+    }
+    SAMPLE_CHECK_ERRORS(err);
+    return 1;
+}
+
+void releaseTiledW(TiledW &tiled)
+{
+    if (tiled.uploadQueue != NULL) clReleaseCommandQueue(tiled.uploadQueue);
+    if (tiled.downloadQueue != NULL) clReleaseCommandQueue(tiled.downloadQueue);
+
+    for (int slot = 0; slot < TILE_RING_SIZE; ++slot) {
+        if (tiled.wSlots[slot] != NULL) clReleaseMemObject(tiled.wSlots[slot]);
+        if (tiled.inputSlots[slot] != NULL) clReleaseMemObject(tiled.inputSlots[slot]);
+    }
+    bufferPool.release(tiled.ring);
+
+    if (tiled.ownsHost && tiled.host != NULL) munmap(tiled.host, tiled.capacity * sizeof(float));
+
+    tiled = TiledW();
+}
@@ -0,0 +1,76 @@
+/**
+ * tiled-w.h
+ * @author Jonathan Dowdall
+ * @since 10-18-2026
+ */
+
+#ifndef UPDATEWEIGHTS_TILED_W_H
+#define UPDATEWEIGHTS_TILED_W_H
+
+#include "common.h"
+
+/** Number of device slots tiles rotate through: one uploading, one computing, one downloading */
+#define TILE_RING_SIZE 3
+
+/** Upper bound on the bytes of W held by a single slot */
+#define MAX_TILE_BYTES (64 * 1024 * 1024)
+
+/** Array W too large for a single device allocation.
+ *
+ * The logical W lives in host memory, either anonymous or borrowed from a
+ * mapped state file, and every update streams it through a ring of device
+ * sub-buffers one tile at a time. Uploads and downloads run on their own
+ * queues so the transfers of tiles i+1 and i-1 overlap the kernel running
+ * on tile i.
+ */
+struct TiledW
+{
+    /** Logical array W in host memory */
+    float *host;
+
+    /** Number of elements in W */
+    cl_ulong size;
+
+    /** Number of elements the host mapping can hold */
+    cl_ulong capacity;
+
+    /** False if host is borrowed, e.g. from a mapped state file, and must not be unmapped */
+    bool ownsHost;
+
+    /** Number of elements per tile */
+    cl_ulong tileSize;
+
+    /** Pooled buffer holding every slot */
+    cl_mem ring;
+
+    /** Sub-buffers of ring holding one tile of W and of the input each */
+    cl_mem wSlots[TILE_RING_SIZE];
+    cl_mem inputSlots[TILE_RING_SIZE];
+
+    /** Queues for host to device and device to host transfers. Kernels run on cl.queue. */
+    cl_command_queue uploadQueue;
+    cl_command_queue downloadQueue;
+};
+
+/*
+ * Create the device ring for size elements of W kept at host.
+ * If host is NULL, anonymous memory is mapped and owned by tiled.
+ */
+int initTiledW(TiledW &tiled, cl_ulong size, float *host);
+
+/*
+ * Resize owned W, doubling the host mapping when it runs out. Contents are kept.
+ */
+int resizeTiledW(TiledW &tiled, cl_ulong size);
+
+/*
+ * Blend a host input of tiled.size elements into W with share alpha of the result.
+ */
+int updateTiledW(TiledW &tiled, const float *input, float alpha);
+
+/*
+ * Unmap W and return the ring to the pool.
+ */
+void releaseTiledW(TiledW &tiled);
+
+#endif // UPDATEWEIGHTS_TILED_W_H
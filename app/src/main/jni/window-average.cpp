@@ -0,0 +1,261 @@
+/**
+ * window-average.cpp
+ * @author Jonathan Dowdall
+ * @since 10-18-2026
+ */
+
+#include <algorithm>
+#include <cmath>
+
+#include <opencv2/core/hal/intrin.hpp>
+
+#include "window-average.h"
+#include "buffer-pool.h"
+#include "half-float.h"
+
+using namespace cv;
+
+/** Minimum elements per chunk of the host window */
+#define WINDOW_GRAIN (1 << 16)
+
+/** Where a step puts its input and what it makes of the window */
+struct WindowStep
+{
+    cl_ulong slot;
+    bool full;
+    float scale;
+    bool resum;
+    cl_uint count;
+};
+
+/*
+ * Bytes per input element in the ring of the given element type.
+ */
+static size_t ringBytes(cl_uint elementType)
+{
+    return elementType == ELEMENT_FLOAT16 ? 2 : elementType == ELEMENT_UINT8 ? 1 : 4;
+}
+
+/*
+ * Advance the window by one input.
+ */
+static WindowStep advance(SlidingWindow &window)
+{
+    WindowStep step;
+    step.slot = window.next;
+    step.full = window.count == window.length;
+    if (!step.full) ++window.count;
+    step.count = window.count;
+    step.scale = 1.0f / window.count;
+    window.next = (window.next + 1) % window.length;
+
+    cl_uint interval = window.resumInterval > 0 ? window.resumInterval : window.length;
+    step.resum = ++window.sinceResum >= interval;
+    if (step.resum) window.sinceResum = 0;
+    return step;
+}
+
+int openWindow(SlidingWindow &window, cl_ulong size, bool onDevice)
+{
+    cl_int err = CL_SUCCESS;
+
+    closeWindow(window);
+    window.count = 0;
+    window.next = 0;
+    window.sinceResum = 0;
+
+    cl_ulong bytes = window.length * size * ringBytes(window.elementType);
+    if (!onDevice) {
+        window.hostRing.resize((size_t) bytes);
+        window.hostSum.assign((size_t) size, 0.0f);
+        return 1;
+    }
+
+    if (bytes > gpu.maxAllocSize) {
+        LOGE("A ring of %u inputs of %llu elements exceeds the maximum allocation\n", window.length,
+             (unsigned long long) size);
+        return 0;
+    }
+    window.ring = bufferPool.allocate(bytes, CL_MEM_READ_WRITE, &err);
+    if (err == CL_SUCCESS) window.sum = bufferPool.allocate(size * sizeof(float), CL_MEM_READ_WRITE, &err);
+    if (err == CL_SUCCESS) {
+        const float zero = 0.0f;
+        err = clEnqueueFillBuffer
+                (
+                        cl.queue, // command_queue
+                        window.sum, // buffer
+                        &zero, // *pattern
+                        sizeof(zero), // pattern_size
+                        0, // offset
+                        size * sizeof(float), // size
+                        0, // num_events_in_wait_list
+                        NULL, // *event_wait_list
+                        NULL // *event
+                );
+    }
+    if (err != CL_SUCCESS) closeWindow(window);
+    SAMPLE_CHECK_ERRORS(err);
+    return 1;
+}
+
+cl_int enqueueWindowUpdate(SlidingWindow &window, cl_mem w, cl_mem input, cl_mem dirty, cl_ulong size)
+{
+    WindowStep step = advance(window);
+    cl_uint slot = (cl_uint) step.slot;
+    cl_int full = step.full ? 1 : 0;
+    cl_int type = (cl_int) window.elementType;
+    float quantum = (window.high - window.low) / 255.0f;
+    float inverseQuantum = 1.0f / quantum;
+
+    cl_int err = clSetKernelArg(cl.updateWindow, 0, sizeof(cl_mem), &w);
+    err |= clSetKernelArg(cl.updateWindow, 1, sizeof(cl_mem), &input);
+    err |= clSetKernelArg(cl.updateWindow, 2, sizeof(cl_mem), &window.sum);
+    err |= clSetKernelArg(cl.updateWindow, 3, sizeof(cl_mem), &window.ring);
+    err |= clSetKernelArg(cl.updateWindow, 4, sizeof(cl_mem), &dirty);
+    err |= clSetKernelArg(cl.updateWindow, 5, sizeof(cl_uint), &slot);
+    err |= clSetKernelArg(cl.updateWindow, 6, sizeof(cl_int), &full);
+    err |= clSetKernelArg(cl.updateWindow, 7, sizeof(float), &step.scale);
+    err |= clSetKernelArg(cl.updateWindow, 8, sizeof(cl_int), &type);
+    err |= clSetKernelArg(cl.updateWindow, 9, sizeof(float), &window.low);
+    err |= clSetKernelArg(cl.updateWindow, 10, sizeof(float), &quantum);
+    err |= clSetKernelArg(cl.updateWindow, 11, sizeof(float), &inverseQuantum);
+    err |= clSetKernelArg(cl.updateWindow, 12, sizeof(cl_ulong), &size);
+
+    size_t globalDimensions[3] = {(size_t) size, 1, 1};
+    if (err == CL_SUCCESS) err = clEnqueueNDRangeKernel
+            (
+                    cl.queue, // command_queue
+                    cl.updateWindow, // kernel
+                    3, // work_dim
+                    NULL, // *global_work_offset
+                    globalDimensions, // *global_work_size
+                    NULL, // *local_work_size
+                    0, // num_events_in_wait_list
+                    NULL, // *event_wait_list
+                    NULL // *event
+            );
+    if (err != CL_SUCCESS || !step.resum) return err;
+
+    err = clSetKernelArg(cl.resumWindow, 0, sizeof(cl_mem), &w);
+    err |= clSetKernelArg(cl.resumWindow, 1, sizeof(cl_mem), &window.sum);
+    err |= clSetKernelArg(cl.resumWindow, 2, sizeof(cl_mem), &window.ring);
+    err |= clSetKernelArg(cl.resumWindow, 3, sizeof(cl_uint), &step.count);
+    err |= clSetKernelArg(cl.resumWindow, 4, sizeof(float), &step.scale);
+    err |= clSetKernelArg(cl.resumWindow, 5, sizeof(cl_int), &type);
+    err |= clSetKernelArg(cl.resumWindow, 6, sizeof(float), &window.low);
+    err |= clSetKernelArg(cl.resumWindow, 7, sizeof(float), &quantum);
+    err |= clSetKernelArg(cl.resumWindow, 8, sizeof(cl_ulong), &size);
+    if (err == CL_SUCCESS) err = clEnqueueNDRangeKernel
+            (
+                    cl.queue, // command_queue
+                    cl.resumWindow, // kernel
+                    3, // work_dim
+                    NULL, // *global_work_offset
+                    globalDimensions, // *global_work_size
+                    NULL, // *local_work_size
+                    0, // num_events_in_wait_list
+                    NULL, // *event_wait_list
+                    NULL // *event
+            );
+    return err;
+}
+
+/*
+ * Input at index k of a host ring, as loadRing reads it in the kernel.
+ */
+static inline float loadRing(const uint8_t *ring, size_t k, cl_uint type, float low, float quantum)
+{
+    if (type == ELEMENT_FLOAT16) return halfToFloat(((const uint16_t *) ring)[k]);
+    if (type == ELEMENT_UINT8) return low + ring[k] * quantum;
+    return ((const float *) ring)[k];
+}
+
+/*
+ * Store x at index k of a host ring and return the value stored, as storeRing does in the kernel.
+ */
+static inline float storeRing(uint8_t *ring, size_t k, cl_uint type, float low, float quantum,
+                              float inverseQuantum, float x)
+{
+    if (type == ELEMENT_FLOAT16) {
+        uint16_t half = floatToHalf(x);
+        ((uint16_t *) ring)[k] = half;
+        return halfToFloat(half);
+    }
+    if (type == ELEMENT_UINT8) {
+        float q = std::min(std::max(std::nearbyint((x - low) * inverseQuantum), 0.0f), 255.0f);
+        ring[k] = (uint8_t) q;
+        return low + q * quantum;
+    }
+    ((float *) ring)[k] = x;
+    return x;
+}
+
+std::shared_ptr<ThreadPool::Job> updateHostWindow(SlidingWindow &window, const float *input, float *w,
+                                                  cl_ulong size)
+{
+    WindowStep step = advance(window);
+    uint8_t *ring = window.hostRing.data();
+    float *sum = window.hostSum.data();
+    cl_uint type = window.elementType;
+    float low = window.low;
+    float quantum = (window.high - window.low) / 255.0f;
+    float inverseQuantum = 1.0f / quantum;
+    size_t n = (size_t) size;
+
+    // Elements are independent, so each chunk updates and, if due, recomputes its own sums
+    return threadPool.parallelFor(0, n, WINDOW_GRAIN, [=](size_t begin, size_t end) {
+        size_t slotStart = (size_t) step.slot * n;
+        size_t i = begin;
+        if (type == ELEMENT_FLOAT32) {
+            float *slot = (float *) ring + slotStart;
+            v_float32x4 scale = v_setall_f32(step.scale);
+            for (; i + 4 <= end; i += 4) {
+                v_float32x4 s = v_load(sum + i);
+                if (step.full) s -= v_load(slot + i);
+                v_float32x4 x = v_load(input + i);
+                v_store(slot + i, x);
+                s += x;
+                v_store(sum + i, s);
+                v_store(w + i, s * scale);
+            }
+        }
+        for (; i < end; ++i) {
+            float s = sum[i];
+            if (step.full) s -= loadRing(ring, slotStart + i, type, low, quantum);
+            s += storeRing(ring, slotStart + i, type, low, quantum, inverseQuantum, input[i]);
+            sum[i] = s;
+            w[i] = s * step.scale;
+        }
+        if (!step.resum) return;
+
+        i = begin;
+        if (type == ELEMENT_FLOAT32) {
+            const float *values = (const float *) ring;
+            v_float32x4 scale = v_setall_f32(step.scale);
+            for (; i + 4 <= end; i += 4) {
+                v_float32x4 s = v_setzero_f32();
+                for (cl_uint k = 0; k < step.count; ++k) s += v_load(values + k * n + i);
+                v_store(sum + i, s);
+                v_store(w + i, s * scale);
+            }
+        }
+        for (; i < end; ++i) {
+            float s = 0;
+            for (cl_uint k = 0; k < step.count; ++k) s += loadRing(ring, k * n + i, type, low, quantum);
+            sum[i] = s;
+            w[i] = s * step.scale;
+        }
+    });
+}
+
+void closeWindow(SlidingWindow &window)
+{
+    bufferPool.release(window.ring);
+    bufferPool.release(window.sum);
+    window.ring = NULL;
+    window.sum = NULL;
+    window.hostRing.clear();
+    window.hostRing.shrink_to_fit();
+    window.hostSum.clear();
+    window.hostSum.shrink_to_fit();
+}
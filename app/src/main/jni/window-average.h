@@ -0,0 +1,68 @@
+/**
+ * window-average.h
+ * @author Jonathan Dowdall
+ * @since 10-18-2026
+ */
+
+#ifndef UPDATEWEIGHTS_WINDOW_AVERAGE_H
+#define UPDATEWEIGHTS_WINDOW_AVERAGE_H
+
+#include <stdint.h>
+#include <memory>
+#include <vector>
+
+#include "common.h"
+#include "thread-pool.h"
+
+/** Exact average of the last length inputs.
+ *
+ * A ring keeps the inputs slot-major, ring[slot * size + i], as ElementType float32,
+ * float16, or bytes mapping evenly to [low, high]; compressed inputs are averaged as
+ * stored. Next to it is their running sum, so a step adds the new input and takes out
+ * the one it evicts: constant work per element whatever the length. The sum is
+ * recomputed from the ring every resumInterval steps, bounding the rounding error
+ * the additions and subtractions gather in it.
+ */
+struct SlidingWindow
+{
+    cl_uint length;
+    cl_uint elementType;
+    float low;
+    float high;
+    cl_uint resumInterval;
+
+    /** Inputs held, up to length, the slot of the next one, and steps since the sum was recomputed */
+    cl_uint count;
+    cl_uint next;
+    cl_uint sinceResum;
+
+    /** Ring and running sum, on the device or on the host */
+    cl_mem ring;
+    cl_mem sum;
+    std::vector<uint8_t> hostRing;
+    std::vector<float> hostSum;
+};
+
+/*
+ * Allocate an empty window over size elements, on the device or on the host, keeping its settings.
+ */
+int openWindow(SlidingWindow &window, cl_ulong size, bool onDevice);
+
+/*
+ * Queue a step taking input into the device window and setting the size elements of w to its average.
+ */
+cl_int enqueueWindowUpdate(SlidingWindow &window, cl_mem w, cl_mem input, cl_mem dirty, cl_ulong size);
+
+/*
+ * Take host input into the host window and set the size elements of w to its average,
+ * on the thread pool. Join the returned job before input goes away.
+ */
+std::shared_ptr<ThreadPool::Job> updateHostWindow(SlidingWindow &window, const float *input, float *w,
+                                                  cl_ulong size);
+
+/*
+ * Release the ring and the sum, keeping the settings.
+ */
+void closeWindow(SlidingWindow &window);
+
+#endif // UPDATEWEIGHTS_WINDOW_AVERAGE_H
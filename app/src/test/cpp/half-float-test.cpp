@@ -0,0 +1,97 @@
+/**
+ * half-float-test.cpp
+ * @author Jonathan Dowdall
+ * @since 10-18-2026
+ *
+ * halfToFloat and floatToHalf against the IEEE 754 binary16 format: every half
+ * round-trips, rounding is to nearest with ties to even down into the subnormals,
+ * and the array conversions agree with the scalar ones.
+ */
+
+#include <cfloat>
+#include <cmath>
+#include <cstring>
+#include <vector>
+
+#include "half-float.h"
+#include "test-check.h"
+
+static uint32_t toBits(float value)
+{
+    uint32_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    return bits;
+}
+
+int main()
+{
+    // Values that are exact in both formats
+    CHECK(halfToFloat(0x0000) == 0.0f && !std::signbit(halfToFloat(0x0000)));
+    CHECK(halfToFloat(0x8000) == 0.0f && std::signbit(halfToFloat(0x8000)));
+    CHECK(halfToFloat(0x3c00) == 1.0f);
+    CHECK(halfToFloat(0xc000) == -2.0f);
+    CHECK(halfToFloat(0x7bff) == 65504.0f);
+    CHECK(halfToFloat(0x0400) == std::ldexp(1.0f, -14));
+    CHECK(halfToFloat(0x0001) == std::ldexp(1.0f, -24));
+    CHECK(halfToFloat(0x03ff) == std::ldexp(1023.0f, -24));
+    CHECK(halfToFloat(0x7c00) == INFINITY && halfToFloat(0xfc00) == -INFINITY);
+    CHECK(std::isnan(halfToFloat(0x7e00)));
+
+    // Every half but NaN comes back as itself; NaN stays NaN
+    bool roundTrips = true;
+    for (uint32_t h = 0; h <= 0xffff; ++h) {
+        float value = halfToFloat((uint16_t) h);
+        if (std::isnan(value)) roundTrips = roundTrips && (floatToHalf(value) & 0x7fff) > 0x7c00;
+        else roundTrips = roundTrips && floatToHalf(value) == h;
+    }
+    CHECK(roundTrips);
+
+    // Between two neighbouring halves, either sign: the nearer one, and the even one at the midpoint.
+    // Covers the subnormals, the step into the normals and the carry into the next exponent.
+    bool nearest = true;
+    for (uint32_t h = 0; h < 0x7bff; ++h) {
+        for (uint32_t sign = 0; sign <= 0x8000; sign += 0x8000) {
+            float low = halfToFloat((uint16_t) (sign | h));
+            float high = halfToFloat((uint16_t) (sign | (h + 1)));
+            float middle = (low + high) / 2;
+            uint16_t even = (uint16_t) (sign | (h % 2 == 0 ? h : h + 1));
+            nearest = nearest && floatToHalf(middle) == even;
+            nearest = nearest && floatToHalf(std::nextafter(middle, low)) == (sign | h);
+            nearest = nearest && floatToHalf(std::nextafter(middle, high)) == (sign | (h + 1));
+        }
+    }
+    CHECK(nearest);
+
+    // Half of the smallest subnormal is a tie to zero; anything above it is not
+    CHECK(floatToHalf(std::ldexp(1.0f, -25)) == 0x0000);
+    CHECK(floatToHalf(std::nextafter(std::ldexp(1.0f, -25), 1.0f)) == 0x0001);
+    CHECK(floatToHalf(-std::ldexp(1.0f, -26)) == 0x8000);
+    CHECK(floatToHalf(FLT_MIN) == 0x0000);
+
+    // Past the largest half, from the midpoint to the next power of two on
+    CHECK(floatToHalf(std::nextafter(65520.0f, 0.0f)) == 0x7bff);
+    CHECK(floatToHalf(65520.0f) == 0x7c00);
+    CHECK(floatToHalf(-1.0e9f) == 0xfc00);
+    CHECK(floatToHalf(INFINITY) == 0x7c00);
+    CHECK((floatToHalf(NAN) & 0x7fff) > 0x7c00);
+
+    // Array conversions, vectorized where the target allows, match the scalar ones
+    std::vector<float> floats;
+    for (uint32_t h = 0; h < 0x7c00; h += 37) {
+        floats.push_back(halfToFloat((uint16_t) h) * 1.0003f);
+        floats.push_back(-halfToFloat((uint16_t) h));
+    }
+    floats.push_back(1.0e-30f);
+    std::vector<uint16_t> halves(floats.size());
+    std::vector<float> widened(floats.size());
+    floatsToHalves(floats.data(), halves.data(), floats.size());
+    halvesToFloats(halves.data(), widened.data(), halves.size());
+    bool arraysMatch = true;
+    for (size_t i = 0; i < floats.size(); ++i) {
+        arraysMatch = arraysMatch && halves[i] == floatToHalf(floats[i]);
+        arraysMatch = arraysMatch && toBits(widened[i]) == toBits(halfToFloat(halves[i]));
+    }
+    CHECK(arraysMatch);
+
+    return TEST_RESULT();
+}
@@ -0,0 +1,69 @@
+/**
+ * host-support.cpp
+ * @author Jonathan Dowdall
+ * @since 10-18-2026
+ *
+ * What the native modules take from native-lib.cpp and the NDK, for running them on the host.
+ */
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "common.h"
+
+OpenCLObjects cl;
+GpuProperties gpu;
+
+int __android_log_print(int prio, const char *tag, const char *fmt, ...)
+{
+    va_list args;
+    va_start(args, fmt);
+    fprintf(stderr, "%s: ", tag);
+    int written = vfprintf(stderr, fmt, args);
+    va_end(args);
+
+    // LogCat ends every message on its own line, with or without a newline
+    size_t length = strlen(fmt);
+    if (length == 0 || fmt[length - 1] != '\n') fputc('\n', stderr);
+    return written;
+}
+
+const char* opencl_error_to_str (cl_int error)
+{
+    return "OpenCL is not available on the host";
+}
+
+/*
+ * OpenCL entry points the host modules link against. There is no device on the host,
+ * so every call fails, as it would without an OpenCL driver.
+ */
+cl_mem clCreateBuffer(cl_context context, cl_mem_flags flags, size_t size, void *hostPtr, cl_int *err)
+{
+    if (err != NULL) *err = CL_INVALID_CONTEXT;
+    return NULL;
+}
+
+cl_int clReleaseMemObject(cl_mem buffer)
+{
+    return CL_INVALID_MEM_OBJECT;
+}
+
+cl_int clSetKernelArg(cl_kernel kernel, cl_uint index, size_t size, const void *value)
+{
+    return CL_INVALID_KERNEL;
+}
+
+cl_int clEnqueueNDRangeKernel(cl_command_queue queue, cl_kernel kernel, cl_uint dimensions,
+                              const size_t *offset, const size_t *globalSize, const size_t *localSize,
+                              cl_uint waitCount, const cl_event *waitList, cl_event *event)
+{
+    return CL_INVALID_COMMAND_QUEUE;
+}
+
+cl_int clEnqueueFillBuffer(cl_command_queue queue, cl_mem buffer, const void *pattern, size_t patternSize,
+                           size_t offset, size_t size, cl_uint waitCount, const cl_event *waitList,
+                           cl_event *event)
+{
+    return CL_INVALID_COMMAND_QUEUE;
+}
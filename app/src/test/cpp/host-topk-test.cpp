@@ -0,0 +1,79 @@
+/**
+ * host-topk-test.cpp
+ * @author Jonathan Dowdall
+ * @since 10-18-2026
+ *
+ * hostTopK selects what a stable sort would: best first, ties to the lower index,
+ * whichever block or lane the tied elements fall in.
+ */
+
+#include <algorithm>
+#include <random>
+#include <vector>
+
+#include "host-reduce.h"
+#include "test-check.h"
+
+/*
+ * The k best of x by sorting every element, the order hostTopK promises.
+ */
+static std::vector<IndexedValue> sortedTopK(const std::vector<float> &x, size_t k, bool smallest)
+{
+    std::vector<IndexedValue> all(x.size());
+    for (size_t i = 0; i < x.size(); ++i) {
+        all[i].index = i;
+        all[i].value = x[i];
+    }
+    std::stable_sort(all.begin(), all.end(), [smallest](const IndexedValue &a, const IndexedValue &b) {
+        return smallest ? a.value < b.value : a.value > b.value;
+    });
+    all.resize(std::min(k, x.size()));
+    return all;
+}
+
+static bool sameTopK(const std::vector<float> &x, size_t k, bool smallest)
+{
+    std::vector<IndexedValue> top;
+    hostTopK(x.data(), x.size(), k, smallest, top);
+    std::vector<IndexedValue> expected = sortedTopK(x, k, smallest);
+    if (top.size() != expected.size()) return false;
+    for (size_t r = 0; r < top.size(); ++r) {
+        if (top[r].index != expected[r].index || top[r].value != expected[r].value) return false;
+    }
+    return true;
+}
+
+int main()
+{
+    // All equal: the first k indices, in order
+    std::vector<float> equal(37, 2.0f);
+    for (size_t k : { 1, 4, 5, 36, 37, 40 }) {
+        CHECK(sameTopK(equal, k, false));
+        CHECK(sameTopK(equal, k, true));
+    }
+
+    // Ties straddling the k-th place, within the vector lanes and the scalar tail
+    std::vector<float> straddling = { 1, 5, 3, 5, 5, 0, 3, 5, 3, 1, 5 };
+    for (size_t k = 1; k <= straddling.size(); ++k) {
+        CHECK(sameTopK(straddling, k, false));
+        CHECK(sameTopK(straddling, k, true));
+    }
+
+    // Few distinct values over several blocks, so most candidates tie
+    std::mt19937 random(42);
+    std::vector<float> blocks(3 * (1 << 16) + 5);
+    for (float &value : blocks) value = (float) (random() % 8);
+    for (size_t k : { 1, 7, 32, 100 }) {
+        CHECK(sameTopK(blocks, k, false));
+        CHECK(sameTopK(blocks, k, true));
+    }
+
+    // Nothing to select
+    std::vector<IndexedValue> top(3);
+    hostTopK(blocks.data(), 0, 5, false, top);
+    CHECK(top.empty());
+    hostTopK(blocks.data(), blocks.size(), 0, false, top);
+    CHECK(top.empty());
+
+    return TEST_RESULT();
+}
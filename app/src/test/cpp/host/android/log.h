@@ -0,0 +1,22 @@
+/**
+ * log.h
+ * @author Jonathan Dowdall
+ * @since 10-18-2026
+ *
+ * Host stand-in for the NDK logging header, printing to stderr.
+ */
+
+#ifndef UPDATEWEIGHTS_HOST_ANDROID_LOG_H
+#define UPDATEWEIGHTS_HOST_ANDROID_LOG_H
+
+enum android_LogPriority
+{
+    ANDROID_LOG_DEBUG = 3,
+    ANDROID_LOG_INFO,
+    ANDROID_LOG_WARN,
+    ANDROID_LOG_ERROR
+};
+
+int __android_log_print(int prio, const char *tag, const char *fmt, ...);
+
+#endif // UPDATEWEIGHTS_HOST_ANDROID_LOG_H
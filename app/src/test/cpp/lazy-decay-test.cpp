@@ -0,0 +1,97 @@
+/**
+ * lazy-decay-test.cpp
+ * @author Jonathan Dowdall
+ * @since 10-18-2026
+ *
+ * A lazily decayed W, once settled, matches an exponential moving average that
+ * decays every element at every step, elements without an input counting as 0.
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <random>
+#include <vector>
+
+#include "lazy-decay.h"
+#include "test-check.h"
+
+static bool approximately(float value, double expected)
+{
+    return std::fabs(value - expected) <= 1e-4 * std::max(1.0, std::fabs(expected));
+}
+
+int main()
+{
+    LazyDecay lazy = LazyDecay();
+    lazy.alpha = 0.1f;
+
+    // Decay over the steps between, the step counter wrapping included
+    CHECK(lazyFactor(lazy, 7, 7) == 1.0f);
+    CHECK(approximately(lazyFactor(lazy, 10, 7), std::pow(0.9, 3)));
+    CHECK(approximately(lazyFactor(lazy, 2, 0xffffffffu), std::pow(0.9, 3)));
+    CHECK(std::fabs(lazyFactor(lazy, 200, 0) / std::pow(0.9, 200) - 1) < 1e-4);
+
+    // More than one chunk of the thread pool
+    size_t n = 3 * (1 << 16) + 5;
+    std::vector<float> w(n, 1.0f);
+    std::vector<double> eager(w.begin(), w.end());
+    CHECK(openLazyDecay(lazy, NULL, w.data(), n, 0, false));
+
+    std::mt19937 random(47);
+    for (unsigned int step = 1; step <= 40; ++step) {
+        // A few sorted, distinct elements get an input; the rest see a 0
+        std::vector<uint64_t> indices;
+        for (size_t i = random() % 97; i < n; i += 1 + random() % 5000) indices.push_back(i);
+        std::vector<float> values(indices.size());
+        for (float &value : values) value = (float) (random() % 1000) / 100.0f;
+
+        updateHostLazy(lazy, w.data(), indices.data(), values.data(), indices.size(), step)->wait();
+        for (double &element : eager) element *= 1.0 - lazy.alpha;
+        for (size_t j = 0; j < indices.size(); ++j) eager[indices[j]] += lazy.alpha * values[j];
+
+        for (uint64_t i : indices) CHECK(lazy.hostLastStep[i] == step);
+    }
+
+    // Settling a range brings it up to date and leaves the rest as it was
+    size_t begin = 1000, count = n / 2;
+    std::vector<float> before(w);
+    settleHost(lazy, w.data(), begin, count, 40);
+    bool settled = true, untouched = true;
+    for (size_t i = 0; i < n; ++i) {
+        if (i >= begin && i < begin + count) {
+            settled = settled && approximately(w[i], eager[i]) && lazy.hostLastStep[i] == 40;
+        } else {
+            untouched = untouched && w[i] == before[i];
+        }
+    }
+    CHECK(settled);
+    CHECK(untouched);
+
+    // Settling all of it, then again at the same step, which changes nothing
+    settleHost(lazy, w.data(), 0, n, 40);
+    std::vector<float> once(w);
+    settleHost(lazy, w.data(), 0, n, 40);
+    CHECK(once == w);
+    bool matches = true;
+    for (size_t i = 0; i < n; ++i) matches = matches && approximately(w[i], eager[i]);
+    CHECK(matches);
+
+    // Settling later decays by the steps since, as a step without inputs would
+    settleHost(lazy, w.data(), 0, n, 45);
+    matches = true;
+    for (size_t i = 0; i < n; ++i) matches = matches && approximately(w[i], eager[i] * std::pow(0.9, 5));
+    CHECK(matches);
+
+    // A dense input brings every element up to date itself
+    std::vector<float> dense(n, 2.0f);
+    updateHostLazy(lazy, w.data(), NULL, dense.data(), n, 46)->wait();
+    matches = true;
+    for (size_t i = 0; i < n; ++i) {
+        matches = matches && lazy.hostLastStep[i] == 46 && approximately(w[i], eager[i] * std::pow(0.9, 6) + 0.2);
+    }
+    CHECK(matches);
+
+    closeLazyDecay(lazy);
+    CHECK(lazy.hostLastStep.empty() && lazy.alpha == 0.1f);
+    return TEST_RESULT();
+}
@@ -0,0 +1,135 @@
+/**
+ * npy-header-test.cpp
+ * @author Jonathan Dowdall
+ * @since 10-18-2026
+ *
+ * openDataset reads the element type and shape of .npy files of either header
+ * version, and refuses the ones it cannot map as they are.
+ */
+
+#include <unistd.h>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include "dataset-reader.h"
+#include "half-float.h"
+#include "test-check.h"
+
+static std::string npyPath()
+{
+    const char *dir = getenv("TMPDIR");
+    return std::string(dir != NULL ? dir : "/tmp") + "/npy-header-test-" + std::to_string(getpid()) + ".npy";
+}
+
+/*
+ * Write a .npy file with the given header dictionary, padded as numpy pads it, followed by data.
+ */
+static void writeNpy(const std::string &path, int version, const std::string &dictionary,
+                     const void *data, size_t bytes)
+{
+    size_t prefix = version == 1 ? 10 : 12;
+    std::string header = dictionary;
+    while ((prefix + header.size() + 1) % 64 != 0) header += ' ';
+    header += '\n';
+
+    std::ofstream out(path.c_str(), std::ios::binary | std::ios::trunc);
+    out.write("\x93NUMPY", 6);
+    out.put((char) version);
+    out.put(0);
+    for (size_t i = 0; i < prefix - 8; ++i) out.put((char) ((header.size() >> (8 * i)) & 0xff));
+    out << header;
+    out.write((const char *) data, bytes);
+}
+
+static bool opens(const std::string &path)
+{
+    Dataset dataset;
+    int opened = openDataset(dataset, path.c_str(), ELEMENT_FLOAT32, 0);
+    if (opened) closeDataset(dataset);
+    return opened != 0;
+}
+
+int main()
+{
+    std::string path = npyPath();
+    Dataset dataset;
+
+    // Version 1, float32 vectors of the trailing axis
+    float floats[12];
+    for (int i = 0; i < 12; ++i) floats[i] = i * 0.5f;
+    writeNpy(path, 1, "{'descr': '<f4', 'fortran_order': False, 'shape': (3, 4), }", floats, sizeof(floats));
+    CHECK(openDataset(dataset, path.c_str(), ELEMENT_UINT8, 0));
+    if (dataset.map != NULL) {
+        CHECK(dataset.elementType == ELEMENT_FLOAT32);
+        CHECK(dataset.count == 3 && dataset.vectorSize == 4);
+        std::vector<float> scratch(4);
+        const float *vector = NULL;
+        for (int v = 0; v < 3; ++v) vector = nextDatasetVector(dataset, scratch.data());
+        CHECK(vector != NULL && vector[0] == 4.0f && vector[3] == 5.5f);
+        CHECK(nextDatasetVector(dataset, scratch.data()) == NULL);
+        closeDataset(dataset);
+    }
+
+    // Version 2 has a 32-bit header length; every axis after the first makes up a vector
+    uint16_t halves[12];
+    for (int i = 0; i < 12; ++i) halves[i] = floatToHalf(i * -0.25f);
+    writeNpy(path, 2, "{'descr': '<f2', 'fortran_order': False, 'shape': (2, 2, 3), }", halves, sizeof(halves));
+    CHECK(openDataset(dataset, path.c_str(), ELEMENT_FLOAT32, 0));
+    if (dataset.map != NULL) {
+        CHECK(dataset.elementType == ELEMENT_FLOAT16);
+        CHECK(dataset.count == 2 && dataset.vectorSize == 6);
+        std::vector<float> scratch(6);
+        nextDatasetVector(dataset, scratch.data());
+        const float *vector = nextDatasetVector(dataset, scratch.data());
+        CHECK(vector == scratch.data() && vector[5] == -2.75f);
+        closeDataset(dataset);
+    }
+
+    // A one-dimensional array is a single vector; bytes are scaled to [0, 1]
+    uint8_t bytes[5] = { 0, 51, 102, 204, 255 };
+    writeNpy(path, 1, "{'descr': '|u1', 'fortran_order': False, 'shape': (5,), }", bytes, sizeof(bytes));
+    CHECK(openDataset(dataset, path.c_str(), ELEMENT_FLOAT32, 0));
+    if (dataset.map != NULL) {
+        CHECK(dataset.elementType == ELEMENT_UINT8);
+        CHECK(dataset.count == 1 && dataset.vectorSize == 5);
+        std::vector<float> scratch(5);
+        const float *vector = nextDatasetVector(dataset, scratch.data());
+        CHECK(vector != NULL && vector[0] == 0.0f && vector[4] == 1.0f);
+        closeDataset(dataset);
+    }
+
+    // Refused headers
+    writeNpy(path, 1, "{'descr': '>f4', 'fortran_order': False, 'shape': (3, 4), }", floats, sizeof(floats));
+    CHECK(!opens(path));
+    writeNpy(path, 1, "{'descr': '<f8', 'fortran_order': False, 'shape': (3, 2), }", floats, sizeof(floats));
+    CHECK(!opens(path));
+    writeNpy(path, 1, "{'descr': '<f4', 'fortran_order': True, 'shape': (3, 4), }", floats, sizeof(floats));
+    CHECK(!opens(path));
+    writeNpy(path, 1, "{'descr': '<f4', 'fortran_order': False, 'shape': (), }", floats, sizeof(floats));
+    CHECK(!opens(path));
+    writeNpy(path, 1, "{'descr': '<f4', 'shape': (3, 4), }", floats, sizeof(floats));
+    CHECK(!opens(path));
+
+    // Less data than the shape
+    writeNpy(path, 1, "{'descr': '<f4', 'fortran_order': False, 'shape': (4, 4), }", floats, sizeof(floats));
+    CHECK(!opens(path));
+
+    // A header longer than the file
+    writeNpy(path, 1, "{'descr': '<f4', 'fortran_order': False, 'shape': (3, 4), }", NULL, 0);
+    CHECK(truncate(path.c_str(), 40) == 0);
+    CHECK(!opens(path));
+
+    // Not a .npy file at all
+    writeNpy(path, 1, "{'descr': '<f4', 'fortran_order': False, 'shape': (3, 4), }", floats, sizeof(floats));
+    {
+        std::fstream file(path.c_str(), std::ios::binary | std::ios::in | std::ios::out);
+        file.put('N');
+    }
+    CHECK(!opens(path));
+
+    unlink(path.c_str());
+    return TEST_RESULT();
+}
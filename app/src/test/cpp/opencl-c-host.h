@@ -0,0 +1,136 @@
+/**
+ * opencl-c-host.h
+ * @author Jonathan Dowdall
+ * @since 10-18-2026
+ *
+ * Just enough of OpenCL C to compile UpdateWeights.cl as C++ and call its
+ * functions on the host. Work-items run one after another, so kernels that
+ * synchronize through barriers or local memory cannot be run this way.
+ */
+
+#ifndef UPDATEWEIGHTS_OPENCL_C_HOST_H
+#define UPDATEWEIGHTS_OPENCL_C_HOST_H
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <cfloat>
+#include <cmath>
+#include <cstring>
+#include <algorithm>
+
+#include "half-float.h"
+
+typedef unsigned char uchar;
+typedef unsigned short ushort;
+typedef unsigned int uint;
+typedef unsigned long ulong;
+typedef uint16_t half;
+
+#define kernel
+#define __kernel
+#define __global
+#define __local
+#define __private
+#define __constant const
+
+#define CLK_LOCAL_MEM_FENCE 1
+#define CLK_GLOBAL_MEM_FENCE 2
+
+/** Work-item being run by runKernel, and the range it belongs to */
+static size_t hostGlobalId, hostLocalSize = 1, hostGlobalSize;
+
+static inline size_t get_global_id(uint) { return hostGlobalId; }
+static inline size_t get_global_size(uint) { return hostGlobalSize; }
+static inline size_t get_local_id(uint) { return hostGlobalId % hostLocalSize; }
+static inline size_t get_local_size(uint) { return hostLocalSize; }
+static inline size_t get_group_id(uint) { return hostGlobalId / hostLocalSize; }
+static inline size_t get_num_groups(uint) { return (hostGlobalSize + hostLocalSize - 1) / hostLocalSize; }
+
+/* Work-items never run side by side here, so no barrier could be honoured. */
+static inline void barrier(int) { abort(); }
+
+/*
+ * Run body once per work-item of globalSize, in groups of localSize.
+ */
+template <typename Body>
+static void runKernel(size_t globalSize, size_t localSize, Body body)
+{
+    hostGlobalSize = globalSize;
+    hostLocalSize = localSize;
+    for (hostGlobalId = 0; hostGlobalId < globalSize; ++hostGlobalId) body();
+}
+
+using std::copysign;
+using std::exp2;
+using std::fabs;
+using std::fmax;
+using std::fmin;
+using std::ldexp;
+using std::log2;
+using std::rint;
+
+static inline float mad(float a, float b, float c) { return a * b + c; }
+static inline float clamp(float x, float low, float high) { return std::min(std::max(x, low), high); }
+
+static inline float as_float(uint bits)
+{
+    float value;
+    memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+static inline uint as_uint(float value)
+{
+    uint bits;
+    memcpy(&bits, &value, sizeof(bits));
+    return bits;
+}
+
+static inline uint atomic_cmpxchg(volatile __global uint *p, uint compare, uint value)
+{
+    uint old = *p;
+    if (old == compare) *p = value;
+    return old;
+}
+
+struct float8
+{
+    float s[8];
+};
+
+static inline void vstore8(float8 value, size_t offset, float *p)
+{
+    std::copy(value.s, value.s + 8, p + offset * 8);
+}
+
+static inline float vload_half(size_t offset, const half *p) { return halfToFloat(p[offset]); }
+static inline void vstore_half(float value, size_t offset, half *p) { p[offset] = floatToHalf(value); }
+
+/*
+ * Store value as a half rounded toward zero: beyond the largest half it stays the largest half.
+ */
+static inline void vstore_half_rtz(float value, size_t offset, half *p)
+{
+    uint bits = as_uint(value);
+    uint sign = (bits >> 16) & 0x8000;
+    uint magnitude = bits & 0x7fffffff;
+    uint truncated;
+
+    if (magnitude > 0x7f800000) {
+        truncated = 0x7e00;
+    } else if (magnitude == 0x7f800000) {
+        truncated = 0x7c00;
+    } else if (magnitude >= 0x47800000) {
+        truncated = 0x7bff;
+    } else if (magnitude >= 0x38800000) {
+        truncated = (magnitude >> 13) - (112 << 10);
+    } else if (magnitude >= 0x33800000) {
+        // Subnormal half, in units of 2^-24
+        truncated = ((magnitude & 0x7fffff) | 0x800000) >> (126 - (magnitude >> 23));
+    } else {
+        truncated = 0;
+    }
+    p[offset] = (half) (sign | truncated);
+}
+
+#endif // UPDATEWEIGHTS_OPENCL_C_HOST_H
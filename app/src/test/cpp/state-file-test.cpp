@@ -0,0 +1,111 @@
+/**
+ * state-file-test.cpp
+ * @author Jonathan Dowdall
+ * @since 10-18-2026
+ *
+ * openStateFile accepts what createStateFile and commitCheckpoint wrote, and
+ * rejects headers it cannot trust.
+ */
+
+#include <unistd.h>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+
+#include "state-file.h"
+#include "test-check.h"
+
+static std::string statePath()
+{
+    const char *dir = getenv("TMPDIR");
+    return std::string(dir != NULL ? dir : "/tmp") + "/state-file-test-" + std::to_string(getpid());
+}
+
+/*
+ * Write a checkpoint of size elements, then let edit change the header before it is closed.
+ */
+template <typename Edit>
+static void writeState(const std::string &path, cl_ulong size, Edit edit)
+{
+    StateFile state;
+    CHECK(createStateFile(state, path.c_str(), size));
+    for (cl_ulong i = 0; i < size; ++i) state.data[i] = (float) i;
+    CHECK(commitCheckpoint(state, 7, 7.0, size));
+    edit(*state.header);
+    closeStateFile(state);
+}
+
+static bool opens(const std::string &path)
+{
+    StateFile state;
+    int opened = openStateFile(state, path.c_str());
+    if (!opened) {
+        CHECK(state.fd == -1 && state.header == NULL);
+        return false;
+    }
+    closeStateFile(state);
+    return true;
+}
+
+int main()
+{
+    std::string path = statePath();
+
+    StateFile closed;
+    CHECK(closed.fd == -1 && closed.header == NULL && closed.data == NULL && closed.capacity == 0);
+
+    // A committed checkpoint reads back as written
+    writeState(path, 1000, [](StateHeader &) {});
+    StateFile state;
+    CHECK(openStateFile(state, path.c_str()));
+    if (state.header != NULL) {
+        CHECK(state.header->count == 7 && state.header->size == 1000 && state.header->clean);
+        CHECK(state.data[999] == 999.0f);
+        closeStateFile(state);
+    }
+    CHECK(state.fd == -1);
+
+    // Version 2 records the weight of the inputs; version 1 inputs all weighed 1
+    writeState(path, 10, [](StateHeader &header) { header.weight = 2.5; });
+    CHECK(openStateFile(state, path.c_str()));
+    if (state.header != NULL) {
+        CHECK(stateWeight(state) == 2.5);
+        closeStateFile(state);
+    }
+    writeState(path, 10, [](StateHeader &header) {
+        header.version = 1;
+        header.weight = 2.5;
+    });
+    CHECK(openStateFile(state, path.c_str()));
+    if (state.header != NULL) {
+        CHECK(stateWeight(state) == 7.0);
+        closeStateFile(state);
+    }
+
+    writeState(path, 10, [](StateHeader &header) { header.magic[0] = 'X'; });
+    CHECK(!opens(path));
+
+    writeState(path, 10, [](StateHeader &header) { header.version = 0; });
+    CHECK(!opens(path));
+
+    writeState(path, 10, [](StateHeader &header) { header.version = STATE_FILE_VERSION + 1; });
+    CHECK(!opens(path));
+
+    writeState(path, 10, [](StateHeader &header) { header.elementType = ELEMENT_FLOAT16; });
+    CHECK(!opens(path));
+
+    // A crash between beginCheckpoint and commitCheckpoint
+    writeState(path, 10, [](StateHeader &header) { header.clean = 0; });
+    CHECK(!opens(path));
+
+    // More elements than the file holds
+    writeState(path, 10, [](StateHeader &header) { header.size = 11; });
+    CHECK(!opens(path));
+
+    // Shorter than a header
+    CHECK(truncate(path.c_str(), sizeof(StateHeader) - 1) == 0);
+    CHECK(!opens(path));
+
+    unlink(path.c_str());
+    return TEST_RESULT();
+}
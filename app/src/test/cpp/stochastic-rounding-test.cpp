@@ -0,0 +1,92 @@
+/**
+ * stochastic-rounding-test.cpp
+ * @author Jonathan Dowdall
+ * @since 10-18-2026
+ *
+ * storeW of UpdateWeights.cl, run on the host: stochastic rounding to halves only
+ * ever picks one of the two neighbouring halves and is unbiased on average, in the
+ * normal and the subnormal range alike, so a small-share average keeps moving
+ * where rounding to nearest stalls.
+ */
+
+#include <vector>
+
+#include "opencl-c-host.h"
+#include "UpdateWeights.cl"
+#include "test-check.h"
+
+/*
+ * Mean of x stored with stochastic rounding under count seeds, checking every
+ * stored half is one of the two around x.
+ */
+static double stochasticMean(float x, unsigned int count, bool &neighbours)
+{
+    // The half toward zero from x, and the next one away from zero
+    half toward;
+    vstore_half_rtz(x, 0, &toward);
+    half away = (half) (toward + 1);
+
+    double sum = 0;
+    std::vector<half> w(1);
+    for (unsigned int seed = 0; seed < count; ++seed) {
+        storeW((uchar *) w.data(), 0, 1, x, 1, seed * 0x9e3779b9u + 17);
+        neighbours = neighbours && (w[0] == toward || w[0] == away);
+        sum += halfToFloat(w[0]);
+    }
+    return sum / count;
+}
+
+int main()
+{
+    // Normal, subnormal, below the smallest subnormal, negative, just under the smallest normal
+    const float values[] = { 1.0f + 0.3f / 1024, 1000.3f, 1.0e-6f, 3.0e-8f, -2.5e-7f, -1.7f, 6.0e-5f };
+    const unsigned int seeds = 40000;
+    for (float x : values) {
+        bool neighbours = true;
+        double mean = stochasticMean(x, seeds, neighbours);
+        CHECK(neighbours);
+
+        // Within a few standard deviations of the mean of a rounding of at most one half-ulp apart
+        double ulp = std::fabs(x) < 6.103515625e-5f ? std::ldexp(1.0, -24)
+                     : std::ldexp(1.0, std::ilogb(x) - 10);
+        if (std::fabs(mean - x) > 0.02 * ulp) {
+            fprintf(stderr, "x %g: stochastic mean %.9g is %.3f ulp off\n", x, mean, (mean - x) / ulp);
+        }
+        CHECK(std::fabs(mean - x) <= 0.02 * ulp);
+    }
+
+    // Exact halves stay as they are
+    bool exact = true;
+    std::vector<half> w(1);
+    for (unsigned int seed = 0; seed < 1000; ++seed) {
+        for (float x : { 1.0f, -0.5f, 65504.0f, 5.9604644775390625e-8f, 0.0f }) {
+            storeW((uchar *) w.data(), 0, 1, x, 1, seed);
+            exact = exact && halfToFloat(w[0]) == x;
+        }
+    }
+    CHECK(exact);
+
+    // A small-share average of halves: rounding to nearest never leaves the start,
+    // stochastic rounding follows the float average
+    const size_t n = 1024;
+    const float alpha = 0.001f;
+    std::vector<half> input(n, floatToHalf(1.1f));
+    for (int stochastic = 0; stochastic <= 1; ++stochastic) {
+        std::vector<half> average(n, floatToHalf(1.0f));
+        double reference = 1.0;
+        for (unsigned int step = 1; step <= 2000; ++step) {
+            runKernel(n, 64, [&] {
+                UpdateWeightsHalf((uchar *) average.data(), input.data(), alpha, NULL, stochastic,
+                                  step * 0x9e3779b9u);
+            });
+            reference = (1 - alpha) * reference + alpha * halfToFloat(input[0]);
+        }
+        double mean = 0;
+        for (half h : average) mean += halfToFloat(h);
+        mean /= n;
+        if (stochastic) CHECK(std::fabs(mean - reference) < 0.002);
+        else CHECK(mean == 1.0);
+    }
+
+    return TEST_RESULT();
+}
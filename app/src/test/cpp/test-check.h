@@ -0,0 +1,27 @@
+/**
+ * test-check.h
+ * @author Jonathan Dowdall
+ * @since 10-18-2026
+ *
+ * Minimal checks for the host tests: a failed CHECK is reported and counted,
+ * and TEST_RESULT turns the count into the exit status ctest looks at.
+ */
+
+#ifndef UPDATEWEIGHTS_TEST_CHECK_H
+#define UPDATEWEIGHTS_TEST_CHECK_H
+
+#include <stdio.h>
+
+static int testFailures = 0;
+
+#define CHECK(COND)                                                                   \
+    do {                                                                              \
+        if (!(COND)) {                                                                \
+            fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #COND);  \
+            ++testFailures;                                                           \
+        }                                                                             \
+    } while (0)
+
+#define TEST_RESULT() (testFailures == 0 ? 0 : 1)
+
+#endif // UPDATEWEIGHTS_TEST_CHECK_H
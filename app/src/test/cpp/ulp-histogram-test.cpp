@@ -0,0 +1,77 @@
+/**
+ * ulp-histogram-test.cpp
+ * @author Jonathan Dowdall
+ * @since 10-18-2026
+ *
+ * ulpHistogram counts each element in the bucket of its distance to the reference,
+ * in the vectorized lanes, the scalar tail and across blocks alike.
+ */
+
+#include <cfloat>
+#include <cstring>
+#include <random>
+#include <vector>
+
+#include "host-reduce.h"
+#include "test-check.h"
+
+static float fromBits(uint32_t bits)
+{
+    float value;
+    memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+static int bucketOf(uint32_t distance)
+{
+    int bucket = 0;
+    while (distance != 0) {
+        ++bucket;
+        distance >>= 1;
+    }
+    return bucket;
+}
+
+int main()
+{
+    uint64_t histogram[ULP_BUCKETS];
+
+    // Edge cases, one per element: distances 0 and 1, across zero, and the widest there is
+    const float x[] = { 1.0f, -0.0f, fromBits(0x3f800001), fromBits(0x00000001), FLT_MAX, fromBits(0x3f800004) };
+    const float ref[] = { 1.0f, 0.0f, 1.0f, fromBits(0x80000001), -FLT_MAX, 1.0f };
+    ulpHistogram(x, ref, 6, histogram);
+    CHECK(histogram[0] == 2);
+    CHECK(histogram[1] == 1);
+    CHECK(histogram[2] == 1);
+    CHECK(histogram[3] == 1);
+    CHECK(histogram[32] == 1);
+
+    // Buckets hold distances in [2^(b-1), 2^b)
+    const float powers[] = { fromBits(0x3f800003), fromBits(0x3f800007), fromBits(0x3f800008) };
+    const float ones[] = { 1.0f, 1.0f, 1.0f };
+    ulpHistogram(powers, ones, 3, histogram);
+    CHECK(histogram[2] == 1 && histogram[3] == 1 && histogram[4] == 1);
+
+    // Random distances over several blocks and an odd tail, against a scalar count
+    size_t n = 3 * (1 << 16) + 7;
+    std::mt19937 random(38);
+    std::vector<float> values(n), reference(n);
+    uint64_t expected[ULP_BUCKETS] = { 0 };
+    for (size_t i = 0; i < n; ++i) {
+        uint32_t base = 0x3f000000 + (random() & 0xffff);
+        uint32_t distance = random() >> (random() % 32);
+        if (i % 5 == 0) distance = 0;
+        distance &= 0x3fffffff;
+        reference[i] = fromBits(base);
+        values[i] = fromBits(base + distance);
+        if (i % 2 == 1) std::swap(values[i], reference[i]);
+        ++expected[bucketOf(distance)];
+    }
+    ulpHistogram(values.data(), reference.data(), n, histogram);
+    for (int b = 0; b < ULP_BUCKETS; ++b) CHECK(histogram[b] == expected[b]);
+
+    ulpHistogram(values.data(), reference.data(), 0, histogram);
+    for (int b = 0; b < ULP_BUCKETS; ++b) CHECK(histogram[b] == 0);
+
+    return TEST_RESULT();
+}
@@ -0,0 +1,100 @@
+/**
+ * window-resum-test.cpp
+ * @author Jonathan Dowdall
+ * @since 10-18-2026
+ *
+ * The host sliding window recomputes its running sum from the ring every
+ * resumInterval steps, or every length steps by default, dropping the rounding
+ * error the additions and subtractions gathered in between.
+ */
+
+#include <vector>
+
+#include "window-average.h"
+#include "half-float.h"
+#include "test-check.h"
+
+/*
+ * Input of element i at a step: one large input, whose eviction the running sum does
+ * not recover from exactly, among small ones. Within the range of a half.
+ */
+static float inputAt(int step, size_t i)
+{
+    if (step == 0) return 3.0e4f + (float) (i % 5) * 0.5f;
+    return 1.0f + (float) ((step * 7 + i) % 13) * 0.125f;
+}
+
+/*
+ * Value the ring keeps of an input.
+ */
+static float stored(cl_uint elementType, float x)
+{
+    return elementType == ELEMENT_FLOAT16 ? halfToFloat(floatToHalf(x)) : x;
+}
+
+/*
+ * Run steps inputs through a window over n elements, checking w against the sum of the
+ * ring in slot order after every step that recomputes it.
+ */
+static void runWindow(cl_uint elementType, cl_uint length, cl_uint resumInterval, size_t n, int steps)
+{
+    SlidingWindow window = SlidingWindow();
+    window.length = length;
+    window.elementType = elementType;
+    window.resumInterval = resumInterval;
+    CHECK(openWindow(window, n, false));
+
+    cl_uint interval = resumInterval > 0 ? resumInterval : length;
+    std::vector<float> input(n), w(n);
+    for (int step = 0; step < steps; ++step) {
+        for (size_t i = 0; i < n; ++i) input[i] = inputAt(step, i);
+        updateHostWindow(window, input.data(), w.data(), n)->wait();
+        if ((step + 1) % interval != 0) continue;
+
+        // Slot k holds the latest input of the steps congruent to k modulo length
+        cl_uint count = step + 1 < (int) length ? step + 1 : length;
+        bool exact = true;
+        for (size_t i = 0; i < n; ++i) {
+            float sum = 0;
+            for (cl_uint k = 0; k < count; ++k) {
+                int latest = step - (int) ((step - k + length) % length);
+                sum += stored(elementType, inputAt(latest, i));
+            }
+            exact = exact && w[i] == sum * (1.0f / count) && window.hostSum[i] == sum;
+        }
+        CHECK(exact);
+    }
+    CHECK(window.count == length);
+    closeWindow(window);
+    CHECK(window.hostRing.empty() && window.hostSum.empty());
+}
+
+int main()
+{
+    // Vector lanes, a scalar tail and more than one chunk of the thread pool
+    size_t n = 3 * (1 << 16) + 3;
+
+    runWindow(ELEMENT_FLOAT32, 4, 3, n, 13);
+    runWindow(ELEMENT_FLOAT32, 5, 0, n, 16);
+    runWindow(ELEMENT_FLOAT16, 4, 2, 7, 11);
+
+    // Without a recompute the huge input leaves its rounding error behind once evicted
+    SlidingWindow window = SlidingWindow();
+    window.length = 2;
+    window.elementType = ELEMENT_FLOAT32;
+    window.resumInterval = 1000;
+    CHECK(openWindow(window, 1, false));
+    float w = 0;
+    float inputs[] = { 1.0e8f, 1.0f, 1.0f, 1.0f };
+    for (float x : inputs) updateHostWindow(window, &x, &w, 1)->wait();
+    CHECK(w != 1.0f);
+
+    // Its next recompute is exact again
+    window.resumInterval = window.sinceResum + 1;
+    float x = 1.0f;
+    updateHostWindow(window, &x, &w, 1)->wait();
+    CHECK(w == 1.0f);
+    closeWindow(window);
+
+    return TEST_RESULT();
+}